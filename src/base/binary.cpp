@@ -0,0 +1,86 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "binary.h"
+
+const std::string& BinaryWriter::data() const {
+  return data_;
+}
+
+void BinaryWriter::clear() {
+  data_.clear();
+}
+
+void BinaryWriter::WriteBytes(const void* data, size_t size) {
+  data_.append(static_cast<const char*>(data), size);
+}
+
+void BinaryWriter::WriteString(const std::string& str) {
+  Write(static_cast<uint32_t>(str.size()));
+  data_.append(str);
+}
+
+void BinaryWriter::WriteString(const std::wstring& str) {
+  Write(static_cast<uint32_t>(str.size()));
+  data_.append(reinterpret_cast<const char*>(str.data()),
+               str.size() * sizeof(wchar_t));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BinaryReader::BinaryReader(const char* data, size_t size)
+    : data_(data), size_(size), position_(0) {
+}
+
+BinaryReader::BinaryReader(const std::string& data)
+    : BinaryReader(data.data(), data.size()) {
+}
+
+bool BinaryReader::eof() const {
+  return position_ >= size_;
+}
+
+size_t BinaryReader::position() const {
+  return position_;
+}
+
+void BinaryReader::seek(size_t position) {
+  position_ = position < size_ ? position : size_;
+}
+
+bool BinaryReader::ReadString(std::string& str) {
+  uint32_t length = 0;
+  if (!Read(length) || size_ - position_ < length)
+    return false;
+
+  str.assign(data_ + position_, length);
+  position_ += length;
+  return true;
+}
+
+bool BinaryReader::ReadString(std::wstring& str) {
+  uint32_t length = 0;
+  if (!Read(length) || (size_ - position_) / sizeof(wchar_t) < length)
+    return false;
+
+  str.resize(length);
+  if (length)
+    std::memcpy(&str[0], data_ + position_, length * sizeof(wchar_t));
+  position_ += length * sizeof(wchar_t);
+  return true;
+}
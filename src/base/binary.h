@@ -0,0 +1,77 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+// Simple helpers for reading and writing binary files. Values are stored in
+// native byte order, as the files are meant to be read back on the same
+// machine (e.g. caches and snapshots under the data folder).
+
+class BinaryWriter {
+public:
+  const std::string& data() const;
+  void clear();
+
+  template <typename T>
+  void Write(const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Type must be trivially copyable");
+    data_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  void WriteBytes(const void* data, size_t size);
+  void WriteString(const std::string& str);
+  void WriteString(const std::wstring& str);
+
+private:
+  std::string data_;
+};
+
+class BinaryReader {
+public:
+  BinaryReader(const char* data, size_t size);
+  explicit BinaryReader(const std::string& data);
+
+  bool eof() const;
+  size_t position() const;
+  void seek(size_t position);
+
+  template <typename T>
+  bool Read(T& value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Type must be trivially copyable");
+    if (size_ - position_ < sizeof(T))
+      return false;
+    std::memcpy(&value, data_ + position_, sizeof(T));
+    position_ += sizeof(T);
+    return true;
+  }
+
+  bool ReadString(std::string& str);
+  bool ReadString(std::wstring& str);
+
+private:
+  const char* data_;
+  size_t size_;
+  size_t position_;
+};
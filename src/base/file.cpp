@@ -424,6 +424,66 @@ bool SaveToFile(const std::string& data, const std::wstring& path,
 
 ////////////////////////////////////////////////////////////////////////////////
 
+MappedFile::~MappedFile() {
+  Close();
+}
+
+bool MappedFile::Open(const std::wstring& path) {
+  Close();
+
+  file_handle_ = OpenFileForGenericRead(path);
+  if (file_handle_ == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER file_size{};
+  if (::GetFileSizeEx(file_handle_, &file_size) == FALSE ||
+      file_size.QuadPart == 0) {
+    Close();
+    return false;
+  }
+
+  mapping_handle_ = ::CreateFileMapping(file_handle_, nullptr, PAGE_READONLY,
+                                        0, 0, nullptr);
+  if (!mapping_handle_) {
+    Close();
+    return false;
+  }
+
+  data_ = static_cast<const char*>(
+      ::MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+  if (!data_) {
+    Close();
+    return false;
+  }
+
+  size_ = static_cast<size_t>(file_size.QuadPart);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_)
+    ::UnmapViewOfFile(data_);
+  if (mapping_handle_)
+    ::CloseHandle(mapping_handle_);
+  if (file_handle_ != INVALID_HANDLE_VALUE)
+    ::CloseHandle(file_handle_);
+
+  file_handle_ = INVALID_HANDLE_VALUE;
+  mapping_handle_ = nullptr;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+const char* MappedFile::data() const {
+  return data_;
+}
+
+size_t MappedFile::size() const {
+  return size_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 std::wstring ToSizeString(QWORD qwSize) {
   std::wstring size, unit;
 
@@ -64,6 +64,29 @@ bool SaveToFile(const std::string& data, const std::wstring& path, bool take_bac
 
 std::wstring ToSizeString(QWORD qwSize);
 
+// Read-only view of a file that is mapped into memory. The file can't be
+// replaced or deleted while it is open.
+class MappedFile {
+public:
+  MappedFile() {}
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool Open(const std::wstring& path);
+  void Close();
+
+  const char* data() const;
+  size_t size() const;
+
+private:
+  HANDLE file_handle_ = INVALID_HANDLE_VALUE;
+  HANDLE mapping_handle_ = nullptr;
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
 class FileSearchHelper {
 public:
   typedef std::function<bool(const std::wstring& root, const std::wstring& name, const WIN32_FIND_DATA& data)> callback_function_t;
@@ -17,6 +17,7 @@
 */
 
 #include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <iomanip>
 #include <locale>
@@ -251,29 +252,216 @@ bool SearchRegex(const wstring& str, const wstring& pattern) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-size_t LongestCommonSubsequenceLength(const wstring& str1,
-                                      const wstring& str2) {
-  if (str1.empty() || str2.empty())
-    return 0;
+// Bit-parallel algorithms below treat the shorter string as the pattern, and
+// keep one bit per pattern position. Patterns of up to 64 code units fit in a
+// single machine word; longer ones are split into blocks of 64.
 
-  const size_t len1 = str1.length();
-  const size_t len2 = str2.length();
+namespace {
 
-  vector<vector<size_t>> table(len1 + 1);
-  for (auto it = table.begin(); it != table.end(); ++it)
-    it->resize(len2 + 1);
+class PatternMatchVector {
+public:
+  explicit PatternMatchVector(const wstring& pattern);
 
-  for (size_t i = 0; i < len1; i++) {
-    for (size_t j = 0; j < len2; j++) {
-      if (str1[i] == str2[j]) {
-        table[i + 1][j + 1] = table[i][j] + 1;
-      } else {
-        table[i + 1][j + 1] = std::max(table[i + 1][j], table[i][j + 1]);
+  PatternMatchVector(const PatternMatchVector&) = delete;
+  PatternMatchVector& operator=(const PatternMatchVector&) = delete;
+
+  size_t block_count() const { return block_count_; }
+  uint64_t get(wchar_t c, size_t block) const;
+
+private:
+  static const uint32_t kEmptyKey = 0xFFFFFFFF;
+  static const size_t kInlineCapacity = 128;
+
+  size_t find(wchar_t c) const;
+
+  size_t block_count_;
+  size_t capacity_;
+  uint32_t* keys_;
+  uint64_t* masks_;
+
+  // Single-block patterns don't need any heap allocation
+  uint32_t inline_keys_[kInlineCapacity];
+  uint64_t inline_masks_[kInlineCapacity];
+  vector<uint32_t> heap_keys_;
+  vector<uint64_t> heap_masks_;
+};
+
+PatternMatchVector::PatternMatchVector(const wstring& pattern)
+    : block_count_((pattern.size() + 63) / 64),
+      capacity_(kInlineCapacity) {
+  // Keep the load factor at or below 0.5
+  while (capacity_ < pattern.size() * 2)
+    capacity_ *= 2;
+
+  if (block_count_ <= 1 && capacity_ == kInlineCapacity) {
+    keys_ = inline_keys_;
+    masks_ = inline_masks_;
+  } else {
+    heap_keys_.resize(capacity_);
+    heap_masks_.resize(capacity_ * block_count_);
+    keys_ = heap_keys_.data();
+    masks_ = heap_masks_.data();
+  }
+
+  std::fill_n(keys_, capacity_, kEmptyKey);
+  std::fill_n(masks_, capacity_ * block_count_, 0);
+
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    const auto key = static_cast<uint32_t>(pattern[i]);
+    size_t slot = key & (capacity_ - 1);
+    while (keys_[slot] != kEmptyKey && keys_[slot] != key)
+      slot = (slot + 1) & (capacity_ - 1);
+    keys_[slot] = key;
+    masks_[slot * block_count_ + i / 64] |= 1ULL << (i % 64);
+  }
+}
+
+size_t PatternMatchVector::find(wchar_t c) const {
+  const auto key = static_cast<uint32_t>(c);
+  size_t slot = key & (capacity_ - 1);
+  while (keys_[slot] != kEmptyKey) {
+    if (keys_[slot] == key)
+      return slot;
+    slot = (slot + 1) & (capacity_ - 1);
+  }
+  return capacity_;
+}
+
+uint64_t PatternMatchVector::get(wchar_t c, size_t block) const {
+  const size_t slot = find(c);
+  return slot < capacity_ ? masks_[slot * block_count_ + block] : 0;
+}
+
+inline size_t PopCount(uint64_t x) {
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return static_cast<size_t>((x * 0x0101010101010101ULL) >> 56);
+}
+
+inline uint64_t LowBitMask(size_t bit_count) {
+  return bit_count >= 64 ? ~0ULL : (1ULL << bit_count) - 1;
+}
+
+// Based on Hyyrö's bit-parallel LCS length computation (which is itself a
+// variant of the algorithm by Allison and Dix)
+size_t LongestCommonSubsequenceLength(const PatternMatchVector& pm,
+                                      size_t pattern_length,
+                                      const wstring& text) {
+  const size_t block_count = pm.block_count();
+
+  if (block_count == 1) {
+    uint64_t v = ~0ULL;
+    for (const auto c : text) {
+      const uint64_t u = v & pm.get(c, 0);
+      v = (v + u) | (v - u);
+    }
+    return PopCount(~v & LowBitMask(pattern_length));
+  }
+
+  vector<uint64_t> v(block_count, ~0ULL);
+
+  for (const auto c : text) {
+    uint64_t carry = 0;
+    for (size_t k = 0; k < block_count; ++k) {
+      const uint64_t u = v[k] & pm.get(c, k);
+      // v[k] + u + carry, where the carry may propagate across blocks
+      const uint64_t x = v[k] + carry;
+      const uint64_t sum = x + u;
+      carry = (x < carry) | (sum < u);
+      v[k] = sum | (v[k] - u);
+    }
+  }
+
+  size_t length = 0;
+  for (size_t k = 0; k < block_count; ++k) {
+    const size_t bits = std::min<size_t>(64, pattern_length - k * 64);
+    length += PopCount(~v[k] & LowBitMask(bits));
+  }
+  return length;
+}
+
+// Based on Myers' bit-vector algorithm for approximate string matching, as
+// adapted by Hyyrö for computing edit distance between whole strings
+size_t EditDistance(const PatternMatchVector& pm, size_t pattern_length,
+                    const wstring& text) {
+  const size_t block_count = pm.block_count();
+  const uint64_t last_bit = 1ULL << ((pattern_length - 1) % 64);
+
+  size_t distance = pattern_length;
+
+  if (block_count == 1) {
+    uint64_t pv = ~0ULL;
+    uint64_t mv = 0;
+    for (const auto c : text) {
+      const uint64_t eq = pm.get(c, 0);
+      const uint64_t xv = eq | mv;
+      const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+      uint64_t ph = mv | ~(xh | pv);
+      uint64_t mh = pv & xh;
+      if (ph & last_bit) {
+        ++distance;
+      } else if (mh & last_bit) {
+        --distance;
       }
+      ph = (ph << 1) | 1;
+      mh <<= 1;
+      pv = mh | ~(xv | ph);
+      mv = ph & xv;
     }
+    return distance;
   }
 
-  return table.back().back();
+  vector<uint64_t> pv(block_count, ~0ULL);
+  vector<uint64_t> mv(block_count, 0);
+
+  for (const auto c : text) {
+    // Horizontal delta entering the block from above; it is always +1 for the
+    // first row, since the distance from an empty pattern grows by one
+    int h = 1;
+    for (size_t k = 0; k < block_count; ++k) {
+      const uint64_t high_bit = k + 1 < block_count ? 1ULL << 63 : last_bit;
+      uint64_t eq = pm.get(c, k);
+      const uint64_t xv = eq | mv[k];
+      if (h < 0)
+        eq |= 1;
+      const uint64_t xh = (((eq & pv[k]) + pv[k]) ^ pv[k]) | eq;
+      uint64_t ph = mv[k] | ~(xh | pv[k]);
+      uint64_t mh = pv[k] & xh;
+      const int h_out = (ph & high_bit) ? 1 : (mh & high_bit) ? -1 : 0;
+      ph <<= 1;
+      mh <<= 1;
+      if (h < 0) {
+        mh |= 1;
+      } else if (h > 0) {
+        ph |= 1;
+      }
+      pv[k] = mh | ~(xv | ph);
+      mv[k] = ph & xv;
+      h = h_out;
+    }
+    if (h > 0) {
+      ++distance;
+    } else if (h < 0) {
+      --distance;
+    }
+  }
+
+  return distance;
+}
+
+}  // namespace
+
+size_t LongestCommonSubsequenceLength(const wstring& str1,
+                                      const wstring& str2) {
+  if (str1.empty() || str2.empty())
+    return 0;
+
+  const auto& pattern = str1.size() <= str2.size() ? str1 : str2;
+  const auto& text = str1.size() <= str2.size() ? str2 : str1;
+
+  PatternMatchVector pm(pattern);
+  return LongestCommonSubsequenceLength(pm, pattern.size(), text);
 }
 
 size_t LongestCommonSubstringLength(const wstring& str1, const wstring& str2) {
@@ -283,25 +471,19 @@ size_t LongestCommonSubstringLength(const wstring& str1, const wstring& str2) {
   const size_t len1 = str1.length();
   const size_t len2 = str2.length();
 
-  vector<vector<size_t>> table(len1);
-  for (auto it = table.begin(); it != table.end(); ++it)
-    it->resize(len2);
+  // Only the previous row of the table is needed. Iterating the columns in
+  // reverse lets us overwrite it in place.
+  vector<size_t> row(len2 + 1);
 
   size_t longest_length = 0;
 
   for (size_t i = 0; i < len1; i++) {
-    for (size_t j = 0; j < len2; j++) {
-      if (str1[i] == str2[j]) {
-        if (i == 0 || j == 0) {
-          table[i][j] = 1;
-        } else {
-          table[i][j] = table[i - 1][j - 1] + 1;
-        }
-        if (table[i][j] > longest_length) {
-          longest_length = table[i][j];
-        }
+    for (size_t j = len2; j > 0; j--) {
+      if (str1[i] == str2[j - 1]) {
+        row[j] = row[j - 1] + 1;
+        longest_length = std::max(longest_length, row[j]);
       } else {
-        table[i][j] = 0;
+        row[j] = 0;
       }
     }
   }
@@ -374,63 +556,74 @@ double JaroWinklerDistance(const wstring& str1, const wstring& str2) {
 }
 
 double LevenshteinDistance(const wstring& str1, const wstring& str2) {
-  const size_t len1 = str1.size();
-  const size_t len2 = str2.size();
-
-  vector<size_t> prev_col(len2 + 1);
-  for (size_t i = 0; i < prev_col.size(); i++)
-    prev_col[i] = i;
-
-  vector<size_t> col(len2 + 1);
-
-  for (size_t i = 0; i < len1; i++) {
-    col[0] = i + 1;
+  const auto& pattern = str1.size() <= str2.size() ? str1 : str2;
+  const auto& text = str1.size() <= str2.size() ? str2 : str1;
 
-    for (size_t j = 0; j < len2; j++)
-      col[j + 1] = std::min(std::min(1 + col[j], 1 + prev_col[1 + j]),
-                            prev_col[j] + (str1[i] == str2[j] ? 0 : 1));
-
-    col.swap(prev_col);
+  size_t distance = text.size();
+  if (!pattern.empty()) {
+    PatternMatchVector pm(pattern);
+    distance = EditDistance(pm, pattern.size(), text);
   }
 
   const double len = static_cast<double>(std::max(str1.size(), str2.size()));
-  return 1.0 - (prev_col[len2] / len);
+  return 1.0 - (distance / len);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
+trigram_t PackTrigram(wchar_t c1, wchar_t c2, wchar_t c3) {
+  const trigram_t mask = 0x1FFFFF;
+  return ((static_cast<trigram_t>(c1) & mask) << 42) |
+         ((static_cast<trigram_t>(c2) & mask) << 21) |
+         (static_cast<trigram_t>(c3) & mask);
+}
+
 void GetTrigrams(const wstring& str, trigram_container_t& output) {
   const size_t n = 3;
 
-  if (n < 1)
-    return;
-
   output.clear();
 
   if (n >= str.size()) {
-    trigram_t buffer = {'\0'};
-    std::copy(str.begin(), str.end(), buffer.begin());
-    output.push_back(buffer);
+    wchar_t buffer[n] = {'\0'};
+    std::copy(str.begin(), str.end(), buffer);
+    output.push_back(PackTrigram(buffer[0], buffer[1], buffer[2]));
     return;
   }
 
-  for (size_t i = 0; i <= str.size() - n; ++i) {
-    trigram_t buffer = {'\0'};
-    std::copy(str.begin() + i, str.begin() + (i + n), buffer.begin());
-    output.push_back(buffer);
-  }
+  output.reserve(str.size() - n + 1);
+
+  for (size_t i = 0; i <= str.size() - n; ++i)
+    output.push_back(PackTrigram(str[i], str[i + 1], str[i + 2]));
 
   std::sort(output.begin(), output.end());
 }
 
-double CompareTrigrams(const trigram_container_t& t1,
-                       const trigram_container_t& t2) {
-  trigram_container_t intersection;
+size_t CountCommonTrigrams(const trigram_container_t& t1,
+                           const trigram_container_t& t2) {
+  // Same result as the size of std::set_intersection, without building the
+  // intersection. The loop is written without branches on the comparison
+  // results, so that mispredictions don't dominate on short inputs.
+  const trigram_t* p1 = t1.data();
+  const trigram_t* p2 = t2.data();
+  const trigram_t* const end1 = p1 + t1.size();
+  const trigram_t* const end2 = p2 + t2.size();
+
+  size_t count = 0;
+
+  while (p1 != end1 && p2 != end2) {
+    const trigram_t a = *p1;
+    const trigram_t b = *p2;
+    count += a == b;
+    p1 += a <= b;
+    p2 += b <= a;
+  }
 
-  std::set_intersection(t1.begin(), t1.end(), t2.begin(), t2.end(),
-                        std::back_inserter(intersection));
+  return count;
+}
 
-  return static_cast<double>(intersection.size()) /
+double CompareTrigrams(const trigram_container_t& t1,
+                       const trigram_container_t& t2) {
+  return static_cast<double>(CountCommonTrigrams(t1, t2)) /
          static_cast<double>(std::max(t1.size(), t2.size()));
 }
 
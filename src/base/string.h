@@ -18,7 +18,6 @@
 
 #pragma once
 
-#include <array>
 #include <string>
 #include <vector>
 #include <windows.h>
@@ -62,9 +61,13 @@ size_t LongestCommonSubstringLength(const std::wstring& str1, const std::wstring
 double JaroWinklerDistance(const std::wstring& str1, const std::wstring& str2);
 double LevenshteinDistance(const std::wstring& str1, const std::wstring& str2);
 
-typedef std::array<wchar_t, 3> trigram_t;
+// Three code units packed into a single integer, 21 bits each. Packed values
+// sort in the same order as the characters they represent.
+typedef unsigned long long trigram_t;
 typedef std::vector<trigram_t> trigram_container_t;
+trigram_t PackTrigram(wchar_t c1, wchar_t c2, wchar_t c3);
 void GetTrigrams(const std::wstring& str, trigram_container_t& output);
+size_t CountCommonTrigrams(const trigram_container_t& t1, const trigram_container_t& t2);
 double CompareTrigrams(const trigram_container_t& t1, const trigram_container_t& t2);
 
 void ReplaceChar(std::wstring& str, const wchar_t c, const wchar_t replace_with);
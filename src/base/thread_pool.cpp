@@ -0,0 +1,114 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "thread_pool.h"
+
+ThreadPool::~ThreadPool() {
+  Shutdown();
+}
+
+void ThreadPool::ParallelFor(size_t count, const function_t& function) {
+  if (!count)
+    return;
+
+  const size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+  if (count == 1 || thread_count == 1) {
+    for (size_t i = 0; i < count; ++i)
+      function(i);
+    return;
+  }
+
+  Job job;
+  job.function = &function;
+  job.count = count;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  // The calling thread takes part as well, so one thread less is needed
+  if (threads_.empty()) {
+    stopping_ = false;
+    for (size_t i = 1; i < thread_count; ++i)
+      threads_.emplace_back(&ThreadPool::WorkerProc, this);
+  }
+
+  jobs_.push_back(&job);
+  work_condition_.notify_all();
+
+  job.done_count += RunJob(job, lock);
+
+  // The job is on this thread's stack, so workers must be done with it
+  done_condition_.wait(lock, [&job]() {
+    return job.done_count == job.count && job.worker_count == 0;
+  });
+}
+
+void ThreadPool::Shutdown() {
+  std::vector<std::thread> threads;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    threads.swap(threads_);
+  }
+  work_condition_.notify_all();
+
+  for (auto& thread : threads)
+    thread.join();
+}
+
+void ThreadPool::WorkerProc() {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (true) {
+    work_condition_.wait(lock, [this]() {
+      return stopping_ || !jobs_.empty();
+    });
+    if (stopping_)
+      break;
+
+    auto& job = *jobs_.front();
+    ++job.worker_count;
+    job.done_count += RunJob(job, lock);
+    --job.worker_count;
+
+    if (job.done_count == job.count && job.worker_count == 0)
+      done_condition_.notify_all();
+  }
+}
+
+// Takes indexes until there are none left, and returns how many were run. The
+// lock is held on entry and on return, but not while the function is called.
+size_t ThreadPool::RunJob(Job& job, std::unique_lock<std::mutex>& lock) {
+  size_t run_count = 0;
+
+  while (job.next_index < job.count) {
+    const size_t index = job.next_index++;
+    if (job.next_index == job.count)
+      jobs_.erase(std::find(jobs_.begin(), jobs_.end(), &job));
+
+    lock.unlock();
+    (*job.function)(index);
+    lock.lock();
+
+    ++run_count;
+  }
+
+  return run_count;
+}
@@ -0,0 +1,67 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Keeps worker threads around between calls, so that callers that hand out
+// many small batches don't have to create new threads for each one.
+//
+// Threads are started the first time they're needed. Several callers can use
+// the pool at the same time, in which case their work is interleaved.
+class ThreadPool {
+public:
+  typedef std::function<void(size_t)> function_t;
+
+  ~ThreadPool();
+
+  // Calls the function for each index in [0, count), on the pool and on the
+  // calling thread, and returns once every call has returned. Each index is
+  // taken by the next thread that is free, so that a few slow calls don't hold
+  // up the rest.
+  void ParallelFor(size_t count, const function_t& function);
+
+  // Stops and joins the worker threads
+  void Shutdown();
+
+private:
+  struct Job {
+    const function_t* function = nullptr;
+    size_t count = 0;
+    size_t next_index = 0;    // Guarded by mutex_
+    size_t done_count = 0;    // Guarded by mutex_
+    size_t worker_count = 0;  // Guarded by mutex_
+  };
+
+  void WorkerProc();
+  size_t RunJob(Job& job, std::unique_lock<std::mutex>& lock);
+
+  std::deque<Job*> jobs_;  // Jobs that have indexes left to be taken
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable work_condition_;
+  std::condition_variable done_condition_;
+  bool stopping_ = false;
+};
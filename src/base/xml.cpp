@@ -79,4 +79,15 @@ bool XmlWriteDocumentToFile(const pugi::xml_document& document,
   const pugi::char_t* indent = L"\x09";  // horizontal tab
   unsigned int flags = pugi::format_default | pugi::format_write_bom;
   return document.save_file(path.c_str(), indent, flags);
+}
+
+std::string XmlWriteDocumentToString(const pugi::xml_document& document) {
+  xml_string_writer writer;
+
+  // Same output as XmlWriteDocumentToFile
+  const pugi::char_t* indent = L"\x09";  // horizontal tab
+  unsigned int flags = pugi::format_default | pugi::format_write_bom;
+  document.save(writer, indent, flags, pugi::encoding_utf8);
+
+  return writer.result;
 }
\ No newline at end of file
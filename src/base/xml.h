@@ -51,3 +51,4 @@ void XmlWriteStrValue(pugi::xml_node& node, const wchar_t* name,
 
 bool XmlWriteDocumentToFile(const pugi::xml_document& document,
                             const std::wstring& path);
+std::string XmlWriteDocumentToString(const pugi::xml_document& document);
@@ -75,6 +75,13 @@ void Database::HandleCompatibility(const std::wstring& meta_version) {
       }
     }
   }
+
+  const auto snapshot_path =
+      taiga::GetPath(taiga::Path::DatabaseAnimeSnapshot);
+  if (!FileExists(snapshot_path)) {
+    LOGW(L"Converting anime database to snapshot");
+    SaveDatabase();
+  }
 }
 
 void Database::ReadDatabaseInCompatibilityMode(xml_document& document) {
@@ -85,6 +92,7 @@ void Database::ReadDatabaseInCompatibilityMode(xml_document& document) {
     Item& item = items[ToInt(id)];  // Creates the item if it doesn't exist
     item.SetId(id, sync::kTaiga);
     item.SetId(id, sync::kMyAnimeList);
+    IndexServiceIds(item);
     item.SetTitle(XmlReadStrValue(node, L"series_title"));
     item.SetEnglishTitle(XmlReadStrValue(node, L"series_english"));
     item.SetSynonyms(XmlReadStrValue(node, L"series_synonyms"));
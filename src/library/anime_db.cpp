@@ -24,6 +24,9 @@
 #include "base/xml.h"
 #include "library/anime.h"
 #include "library/anime_db.h"
+#include "library/anime_db_journal.h"
+#include "library/anime_db_snapshot.h"
+#include "library/anime_text_index.h"
 #include "library/anime_util.h"
 #include "library/discover.h"
 #include "library/history.h"
@@ -31,7 +34,9 @@
 #include "sync/service.h"
 #include "taiga/http.h"
 #include "taiga/path.h"
+#include "taiga/persistence.h"
 #include "taiga/settings.h"
+#include "taiga/stats.h"
 #include "taiga/taiga.h"
 #include "track/recognition.h"
 #include "ui/dlg/dlg_anime_list.h"
@@ -41,9 +46,31 @@ anime::Database AnimeDatabase;
 
 namespace anime {
 
+// The journal is compacted into the list file every time it grows by this many
+// records
+static const size_t kJournalCompactionThreshold = 500;
+
+Database::Database()
+    : journal_(std::make_unique<Journal>()) {
+}
+
+Database::~Database() {
+}
+
 bool Database::LoadDatabase() {
+  std::wstring meta_version;
+
+  if (LoadSnapshot(taiga::GetPath(taiga::Path::DatabaseAnimeSnapshot),
+                   meta_version)) {
+    HandleCompatibility(meta_version);
+    return true;
+  }
+
+  return ImportDatabase(taiga::GetPath(taiga::Path::DatabaseAnime));
+}
+
+bool Database::ImportDatabase(const std::wstring& path) {
   xml_document document;
-  std::wstring path = taiga::GetPath(taiga::Path::DatabaseAnime);
   unsigned int options = pugi::parse_default & ~pugi::parse_eol;
   xml_parse_result parse_result = document.load_file(path.c_str(), options);
 
@@ -105,6 +132,7 @@ void Database::ReadDatabaseNode(xml_node& database_node) {
 
     for (const auto& pair : id_map)
       item.SetId(pair.second, pair.first);
+    IndexServiceIds(item);
 
     item.SetSource(source);
     item.SetTitle(XmlReadStrValue(node, L"title"));
@@ -114,6 +142,7 @@ void Database::ReadDatabaseNode(xml_node& database_node) {
     item.SetGenres(XmlReadStrValue(node, L"genres"));
     item.SetProducers(XmlReadStrValue(node, L"producers"));
     item.SetSynopsis(XmlReadStrValue(node, L"synopsis"));
+    snapshot_synopses_.erase(id);
     item.SetLastModified(ToTime(XmlReadStrValue(node, L"modified")));
 
     // This ordering results in less reallocations
@@ -121,18 +150,23 @@ void Database::ReadDatabaseNode(xml_node& database_node) {
     item.SetJapaneseTitle(XmlReadStrValue(node, L"japanese"));  // alternative
     foreach_xmlnode_(child_node, node, L"synonym")
       item.InsertSynonym(child_node.child_value());  // alternative
-    item.SetPopularity(XmlReadIntValue(node, L"popularity"));  // community(1)
-    item.SetScore(ToDouble(XmlReadStrValue(node, L"score")));  // community(0)
-    item.SetDateEnd(Date(XmlReadStrValue(node, L"date_end")));      // date(1)
-    item.SetDateStart(Date(XmlReadStrValue(node, L"date_start")));  // date(0)
-    item.SetEpisodeLength(XmlReadIntValue(node, L"episode_length"));  // extent(1)
-    item.SetEpisodeCount(XmlReadIntValue(node, L"episode_count"));    // extent(0)
-    item.SetSlug(XmlReadStrValue(node, L"slug"));       // resource(1)
-    item.SetImageUrl(XmlReadStrValue(node, L"image"));  // resource(0)
+
+    item.SetPopularity(XmlReadIntValue(node, L"popularity"));
+    item.SetScore(ToDouble(XmlReadStrValue(node, L"score")));
+    item.SetDateStart(Date(XmlReadStrValue(node, L"date_start")));
+    item.SetDateEnd(Date(XmlReadStrValue(node, L"date_end")));
+    item.SetEpisodeCount(XmlReadIntValue(node, L"episode_count"));
+    item.SetEpisodeLength(XmlReadIntValue(node, L"episode_length"));
+    item.SetSlug(XmlReadStrValue(node, L"slug"));
+    item.SetImageUrl(XmlReadStrValue(node, L"image"));
   }
 }
 
 bool Database::SaveDatabase() {
+  return SaveSnapshot(taiga::GetPath(taiga::Path::DatabaseAnimeSnapshot));
+}
+
+bool Database::ExportDatabase(const std::wstring& path) {
   xml_document document;
 
   xml_node meta_node = document.append_child(L"meta");
@@ -141,7 +175,6 @@ bool Database::SaveDatabase() {
   xml_node database_node = document.append_child(L"database");
   WriteDatabaseNode(database_node);
 
-  std::wstring path = taiga::GetPath(taiga::Path::DatabaseAnime);
   return XmlWriteDocumentToFile(document, path);
 }
 
@@ -217,9 +250,14 @@ Item* Database::FindItem(int id, bool log_error) {
 Item* Database::FindItem(const std::wstring& id, enum_t service,
                          bool log_error) {
   if (!id.empty()) {
-    for (auto& pair : items)
-      if (id == pair.second.GetId(service))
-        return &pair.second;
+    auto& ids = service_ids_[service];
+    auto it = ids.find(id);
+    if (it != ids.end()) {
+      auto item = FindItem(it->second, false);
+      if (item && item->GetId(service) == id)
+        return item;
+      ids.erase(it);
+    }
     if (log_error)
       LOGE(L"Could not find ID: " + id);
   }
@@ -227,6 +265,27 @@ Item* Database::FindItem(const std::wstring& id, enum_t service,
   return nullptr;
 }
 
+void Database::IndexServiceIds(const Item& item) {
+  const int anime_id = item.GetId();
+  if (!IsValidId(anime_id))
+    return;
+
+  for (enum_t service = sync::kTaiga; service <= sync::kLastService; service++) {
+    const auto& id = item.GetId(service);
+    if (!id.empty())
+      service_ids_[service][id] = anime_id;
+  }
+}
+
+void Database::UnindexServiceIds(int anime_id, const Item& item) {
+  for (enum_t service = sync::kTaiga; service <= sync::kLastService; service++) {
+    auto& ids = service_ids_[service];
+    auto it = ids.find(item.GetId(service));
+    if (it != ids.end() && it->second == anime_id)
+      ids.erase(it);
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void Database::ClearInvalidItems() {
@@ -234,23 +293,34 @@ void Database::ClearInvalidItems() {
     if (!anime::IsValidId(it->second.GetId()) ||
         it->first != it->second.GetId()) {
       LOGD(L"ID: " + ToWstr(it->first));
+      UnindexServiceIds(it->first, it->second);
+      snapshot_synopses_.erase(it->first);
       items.erase(it++);
     } else {
       ++it;
     }
   }
+
+  Meow.InvalidateCache();
+  Stats.InvalidateLibrary();
+  AnimeTextIndex.Invalidate();
 }
 
 bool Database::DeleteItem(int id) {
   std::wstring title;
 
   auto anime_item = FindItem(id, false);
-  if (anime_item)
+  if (anime_item) {
     title = anime_item->GetTitle();
+    UnindexServiceIds(id, *anime_item);
+    snapshot_synopses_.erase(id);
+  }
 
   if (items.erase(id) > 0) {
     LOGW(L"ID: " + ToWstr(id) + L" | Title: " + title);
 
+    Meow.InvalidateCache();
+
     auto delete_history_items = [](int id, std::vector<HistoryItem>& items) {
       items.erase(std::remove_if(items.begin(), items.end(),
           [&id](const HistoryItem& item) {
@@ -267,6 +337,9 @@ bool Database::DeleteItem(int id) {
     if (CurrentEpisode.anime_id == id)
       CurrentEpisode.Set(anime::ID_UNKNOWN);
 
+    Stats.UpdateItem(id);
+    AnimeTextIndex.UpdateItem(id);
+
     ui::OnAnimeDelete(id, title);
     return true;
   }
@@ -275,7 +348,31 @@ bool Database::DeleteItem(int id) {
 }
 
 int Database::UpdateItem(const Item& new_item) {
+  bool metadata_updated = false;
+  bool titles_updated = false;
+  Item* item = MergeItem(new_item, metadata_updated, titles_updated);
+
+  if (!item)
+    return ID_UNKNOWN;
+
+  if (titles_updated) {
+    Meow.UpdateTitles(*item);
+  } else if (metadata_updated) {
+    // Episode count, type and dates are also taken into account
+    Meow.InvalidateCache();
+  }
+
+  Stats.UpdateItem(item->GetId());
+  AnimeTextIndex.UpdateItem(item->GetId());
+
+  return item->GetId();
+}
+
+Item* Database::MergeItem(const Item& new_item, bool& metadata_updated,
+                          bool& titles_updated) {
   Item* item = nullptr;
+  metadata_updated = false;
+  titles_updated = false;
 
   for (enum_t i = sync::kTaiga; i <= sync::kLastService; i++) {
     item = FindItem(new_item.GetId(i), i, false);
@@ -288,7 +385,7 @@ int Database::UpdateItem(const Item& new_item) {
 
     if (source == sync::kTaiga) {
       LOGE(L"Invalid source for ID: " + new_item.GetId(source));
-      return ID_UNKNOWN;
+      return nullptr;
     }
 
     int id = ToInt(new_item.GetId(source));
@@ -336,25 +433,29 @@ int Database::UpdateItem(const Item& new_item) {
       item->SetImageUrl(new_item.GetImageUrl());
     if (new_item.GetAgeRating() != kUnknownAgeRating)
       item->SetAgeRating(new_item.GetAgeRating());
-    if (!new_item.GetGenres().empty())
-      item->SetGenres(new_item.GetGenres());
+    if (!new_item.GetGenreSymbols().empty())
+      item->SetGenreSymbols(new_item.GetGenreSymbols());
     if (new_item.GetPopularity() > 0)
       item->SetPopularity(new_item.GetPopularity());
-    if (!new_item.GetProducers().empty())
-      item->SetProducers(new_item.GetProducers());
+    if (!new_item.GetProducerSymbols().empty())
+      item->SetProducerSymbols(new_item.GetProducerSymbols());
     if (new_item.GetScore() != kUnknownScore)
       item->SetScore(new_item.GetScore());
-    if (!new_item.GetSynopsis().empty())
+    if (!new_item.GetSynopsis().empty()) {
       item->SetSynopsis(new_item.GetSynopsis());
+      snapshot_synopses_.erase(item->GetId());
+    }
 
-    // Update clean titles, if necessary
-    if (!new_item.GetTitle().empty() ||
-        !new_item.GetSynonyms().empty() ||
-        !new_item.GetEnglishTitle(false).empty() ||
-        !new_item.GetJapaneseTitle().empty())
-      Meow.UpdateTitles(*item);
+    // Clean titles are updated by the caller, if necessary
+    metadata_updated = true;
+    titles_updated = !new_item.GetTitle().empty() ||
+                     !new_item.GetSynonyms().empty() ||
+                     !new_item.GetEnglishTitle(false).empty() ||
+                     !new_item.GetJapaneseTitle().empty();
   }
 
+  IndexServiceIds(*item);
+
   // Update user information
   if (new_item.IsInList()) {
     // Make sure our pointer to MyInformation class is valid
@@ -380,7 +481,7 @@ int Database::UpdateItem(const Item& new_item) {
     item->SetMyNotes(new_item.GetMyNotes(false));
   }
 
-  return item->GetId();
+  return item;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -388,6 +489,10 @@ int Database::UpdateItem(const Item& new_item) {
 
 bool Database::LoadList() {
   ClearUserData();
+  journal_->Close();
+
+  // A previous save might still be waiting to be written
+  Persistence.Flush();
 
   if (taiga::GetCurrentUsername().empty())
     return false;
@@ -441,6 +546,8 @@ bool Database::LoadList() {
     ReadListInCompatibilityMode(document);
   }
 
+  ReplayJournal();
+
   return true;
 }
 
@@ -480,8 +587,125 @@ bool Database::SaveList(bool include_database) {
     }
   }
 
+  // Records that are in the journal so far can be cleared once the list file
+  // is written
+  taiga::PersistenceService::callback_t on_saved;
+  if (journal_->is_open() &&
+      journal_->path() == taiga::GetPath(taiga::Path::UserLibraryJournal)) {
+    const auto journal = journal_.get();
+    const auto sequence = journal_->sequence();
+    on_saved = [journal, sequence]() { journal->MarkDurable(sequence); };
+  }
+
   std::wstring path = taiga::GetPath(taiga::Path::UserLibrary);
-  return XmlWriteDocumentToFile(document, path);
+  Persistence.Save(path, XmlWriteDocumentToString(document), on_saved);
+
+  return true;
+}
+
+void Database::SaveListEntry(int anime_id, bool flush) {
+  auto anime_item = FindItem(anime_id, false);
+  if (!anime_item)
+    return;
+
+  journal_->ClearDurable();
+
+  JournalRecord record;
+  record.anime_id = anime_id;
+
+  if (anime_item->IsInList()) {
+    record.type = JournalRecordType::Entry;
+    record.library_id = anime_item->GetMyId();
+    record.progress = anime_item->GetMyLastWatchedEpisode(false);
+    record.score = anime_item->GetMyScore(false);
+    record.status = anime_item->GetMyStatus(false);
+    record.rewatched_times = anime_item->GetMyRewatchedTimes(false);
+    record.rewatching = anime_item->GetMyRewatching(false);
+    record.rewatching_ep = anime_item->GetMyRewatchingEp();
+    record.date_start = std::wstring(anime_item->GetMyDateStart(false));
+    record.date_end = std::wstring(anime_item->GetMyDateEnd(false));
+    record.tags = anime_item->GetMyTags(false);
+    record.notes = anime_item->GetMyNotes(false);
+    record.last_updated = anime_item->GetMyLastUpdated();
+  } else {
+    record.type = JournalRecordType::Deletion;
+  }
+
+  // Fall back to saving the whole list if the journal is not available
+  if (!journal_->Append(record)) {
+    SaveList();
+    return;
+  }
+
+  if (journal_->record_count() % kJournalCompactionThreshold == 0)
+    SaveList();
+  if (flush)
+    journal_->Flush();
+}
+
+void Database::CompactList() {
+  if (journal_->record_count() > 0) {
+    SaveList();
+    Persistence.Flush();
+    journal_->ClearDurable();
+  }
+  journal_->Flush();
+}
+
+void Database::ReplayJournal() {
+  const auto path = taiga::GetPath(taiga::Path::UserLibraryJournal);
+
+  std::vector<JournalRecord> records;
+  size_t valid_size = 0;
+  if (!Journal::Read(path, records, valid_size))
+    LOGW(L"Journal is damaged after " + ToWstr(records.size()) +
+         L" record(s): " + path);
+
+  for (const auto& record : records)
+    ApplyJournalRecord(record);
+
+  journal_->Open(path, valid_size, records.size());
+
+  if (!records.empty()) {
+    LOGD(L"Replayed " + ToWstr(records.size()) + L" record(s)");
+    SaveList();
+  }
+}
+
+void Database::ApplyJournalRecord(const JournalRecord& record) {
+  auto anime_item = FindItem(record.anime_id, false);
+
+  if (record.type == JournalRecordType::Deletion) {
+    if (anime_item)
+      anime_item->RemoveFromUserList();
+    return;
+  }
+
+  // Anime that were added to the list might not be in the saved database yet,
+  // in which case they're added the same way as when reading the list
+  if (!anime_item) {
+    Item item;
+    item.SetId(ToWstr(record.anime_id), sync::kTaiga);
+    item.SetSource(sync::kTaiga);
+    UpdateItem(item);
+    anime_item = FindItem(record.anime_id, false);
+    if (!anime_item)
+      return;
+  }
+
+  anime_item->AddtoUserList();
+  anime_item->SetMyId(record.library_id);
+  anime_item->SetMyLastWatchedEpisode(record.progress);
+  anime_item->SetMyScore(record.score);
+  anime_item->SetMyStatus(record.status);
+  anime_item->SetMyRewatchedTimes(record.rewatched_times);
+  anime_item->SetMyRewatching(record.rewatching);
+  anime_item->SetMyRewatchingEp(record.rewatching_ep);
+  anime_item->SetMyDateStart(record.date_start);
+  anime_item->SetMyDateEnd(record.date_end);
+  anime_item->SetMyTags(record.tags);
+  anime_item->SetMyNotes(record.notes);
+  anime_item->SetMyLastUpdated(record.last_updated);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -550,9 +774,10 @@ void Database::AddToList(int anime_id, int status) {
   }
   history_item.mode = taiga::kHttpServiceAddLibraryEntry;
   History.queue.Add(history_item);
+  Stats.UpdateItem(anime_id);
+  AnimeTextIndex.UpdateItem(anime_id);
 
-  SaveDatabase();
-  SaveList();
+  SaveListEntry(anime_id);
 
   ui::OnLibraryEntryAdd(anime_id);
 
@@ -563,6 +788,9 @@ void Database::AddToList(int anime_id, int status) {
 void Database::ClearUserData() {
   for (auto& pair : items)
     pair.second.RemoveFromUserList();
+
+  Stats.InvalidateLibrary();
+  AnimeTextIndex.Invalidate();
 }
 
 bool Database::DeleteListItem(int anime_id) {
@@ -574,6 +802,8 @@ bool Database::DeleteListItem(int anime_id) {
     return false;
 
   anime_item->RemoveFromUserList();
+  Stats.UpdateItem(anime_id);
+  AnimeTextIndex.UpdateItem(anime_id);
 
   ui::ChangeStatusText(L"Item deleted. (" + anime_item->GetTitle() + L")");
   ui::OnLibraryEntryDelete(anime_item->GetId());
@@ -634,7 +864,12 @@ void Database::UpdateItem(const HistoryItem& history_item) {
   if (history_item.mode != taiga::kHttpServiceDeleteLibraryEntry)
     anime::SetMyLastUpdateToNow(*anime_item);
 
-  SaveList();
+  Stats.UpdateItem(history_item.anime_id);
+  AnimeTextIndex.UpdateItem(history_item.anime_id);
+
+  // Queued updates are processed one after another, so the journal is only
+  // flushed after the last one
+  SaveListEntry(history_item.anime_id, History.queue.GetItemCount() <= 1);
 
   History.queue.Remove();
   History.queue.Check(false);
@@ -18,9 +18,15 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
 
 #include "library/anime_item.h"
+#include "library/anime_item_store.h"
 
 class HistoryItem;
 namespace pugi {
@@ -30,22 +36,47 @@ class xml_node;
 
 namespace anime {
 
+class Journal;
+struct JournalRecord;
+class Snapshot;
+
 class Database {
 public:
+  Database();
+  ~Database();
+
   bool LoadDatabase();
   bool SaveDatabase();
 
+  // The database is kept in a binary snapshot. XML is still supported for
+  // importing and exporting, and for databases from earlier versions.
+  bool ImportDatabase(const std::wstring& path);
+  bool ExportDatabase(const std::wstring& path);
+
+  // Synopses are read from the snapshot the first time they're needed
+  void LoadSynopsis(const Item& item);
+
   Item* FindItem(int id, bool log_error = true);
   Item* FindItem(const std::wstring& id, enum_t service, bool log_error = true);
 
   void ClearInvalidItems();
   bool DeleteItem(int id);
   int UpdateItem(const Item& item);
+  // Same as UpdateItem, except that the recognition engine, statistics and
+  // the text index are left for the caller to update
+  Item* MergeItem(const Item& item, bool& metadata_updated,
+                  bool& titles_updated);
 
 public:
   bool LoadList();
   bool SaveList(bool include_database = false);
 
+  // Changes to single entries are appended to a journal instead of rewriting
+  // the whole list. The journal is compacted into the list file once it grows
+  // large enough, and replayed when the list is loaded.
+  void SaveListEntry(int anime_id, bool flush = true);
+  void CompactList();
+
   int GetItemCount(int status, bool check_history = true);
 
   void AddToList(int anime_id, int status);
@@ -54,9 +85,38 @@ public:
   void UpdateItem(const HistoryItem& history_item);
 
 public:
-  std::map<int, Item> items;
+  ItemStore items;
 
 private:
+  // Maps service-specific IDs to Taiga IDs, so that incoming items can be
+  // matched without going through the whole database. Entries are checked
+  // against the items they point to, and stale ones are removed on sight.
+  std::map<enum_t, std::unordered_map<std::wstring, int>> service_ids_;
+
+  void IndexServiceIds(const Item& item);
+  void UnindexServiceIds(int anime_id, const Item& item);
+
+  // Currently loaded snapshot, and the synopses that are yet to be read from
+  // its string table
+  std::unique_ptr<Snapshot> snapshot_;
+  std::unordered_map<int, uint32_t> snapshot_synopses_;
+
+  // Saved snapshots are written next to the current one, which stays mapped
+  // until the new file is on the disk. Synopses of the last saved snapshot
+  // are used once it replaces the current one.
+  std::unordered_map<int, uint32_t> saved_synopses_;
+  unsigned int saved_snapshot_sequence_ = 0;
+  std::atomic<unsigned int> written_snapshot_sequence_{0};
+
+  bool LoadSnapshot(const std::wstring& path, std::wstring& meta_version);
+  bool SaveSnapshot(const std::wstring& path);
+  void SwapSnapshot(const std::wstring& path);
+
+  std::unique_ptr<Journal> journal_;
+
+  void ReplayJournal();
+  void ApplyJournalRecord(const JournalRecord& record);
+
   void ReadDatabaseNode(pugi::xml_node& database_node);
   void WriteDatabaseNode(pugi::xml_node& database_node);
 
@@ -0,0 +1,290 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "base/binary.h"
+#include "base/file.h"
+#include "base/log.h"
+#include "base/string.h"
+#include "library/anime_db_journal.h"
+
+namespace anime {
+
+static const uint32_t kJournalMagic = 0x4C4A4154;  // "TAJL"
+static const uint32_t kJournalFormatVersion = 1;
+
+// Records are flushed to the disk at least this often
+static const size_t kJournalFlushInterval = 16;
+
+static uint32_t GetChecksum(const char* data, size_t size) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static std::string WriteRecord(const JournalRecord& record) {
+  BinaryWriter writer;
+
+  writer.Write(static_cast<uint8_t>(record.type));
+  writer.Write(static_cast<int32_t>(record.anime_id));
+
+  if (record.type == JournalRecordType::Entry) {
+    writer.WriteString(record.library_id);
+    writer.Write(static_cast<int32_t>(record.progress));
+    writer.Write(static_cast<int32_t>(record.score));
+    writer.Write(static_cast<int32_t>(record.status));
+    writer.Write(static_cast<int32_t>(record.rewatched_times));
+    writer.Write(static_cast<int32_t>(record.rewatching));
+    writer.Write(static_cast<int32_t>(record.rewatching_ep));
+    writer.WriteString(record.date_start);
+    writer.WriteString(record.date_end);
+    writer.WriteString(record.tags);
+    writer.WriteString(record.notes);
+    writer.WriteString(record.last_updated);
+  }
+
+  return writer.data();
+}
+
+static bool ReadRecord(const char* data, size_t size, JournalRecord& record) {
+  BinaryReader reader(data, size);
+
+  auto read_int = [&reader](int& value) {
+    int32_t n = 0;
+    if (!reader.Read(n))
+      return false;
+    value = n;
+    return true;
+  };
+
+  uint8_t type = 0;
+  if (!reader.Read(type) || !read_int(record.anime_id))
+    return false;
+
+  switch (static_cast<JournalRecordType>(type)) {
+    case JournalRecordType::Entry:
+      record.type = JournalRecordType::Entry;
+      return reader.ReadString(record.library_id) &&
+             read_int(record.progress) &&
+             read_int(record.score) &&
+             read_int(record.status) &&
+             read_int(record.rewatched_times) &&
+             read_int(record.rewatching) &&
+             read_int(record.rewatching_ep) &&
+             reader.ReadString(record.date_start) &&
+             reader.ReadString(record.date_end) &&
+             reader.ReadString(record.tags) &&
+             reader.ReadString(record.notes) &&
+             reader.ReadString(record.last_updated) &&
+             reader.eof();
+    case JournalRecordType::Deletion:
+      record.type = JournalRecordType::Deletion;
+      return reader.eof();
+  }
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Journal::~Journal() {
+  Close();
+}
+
+bool Journal::Read(const std::wstring& path,
+                   std::vector<JournalRecord>& records, size_t& valid_size) {
+  valid_size = 0;
+
+  std::string data;
+  if (!ReadFromFile(path, data))
+    return !FileExists(path);
+  if (data.empty())
+    return true;
+
+  BinaryReader reader(data);
+
+  uint32_t magic = 0;
+  uint32_t format_version = 0;
+  if (!reader.Read(magic) || !reader.Read(format_version) ||
+      magic != kJournalMagic || format_version != kJournalFormatVersion)
+    return false;
+  valid_size = reader.position();
+
+  while (!reader.eof()) {
+    uint32_t size = 0;
+    uint32_t checksum = 0;
+    if (!reader.Read(size) || !reader.Read(checksum))
+      return false;
+    if (data.size() - reader.position() < size)
+      return false;
+
+    const char* payload = data.data() + reader.position();
+    JournalRecord record;
+    if (GetChecksum(payload, size) != checksum ||
+        !ReadRecord(payload, size, record))
+      return false;
+
+    records.push_back(record);
+    reader.seek(reader.position() + size);
+    valid_size = reader.position();
+  }
+
+  return true;
+}
+
+bool Journal::Open(const std::wstring& path, size_t valid_size,
+                   size_t record_count) {
+  Close();
+
+  CreateFolder(GetPathOnly(path));
+
+  file_handle_ = ::CreateFile(GetExtendedLengthPath(path).c_str(),
+                              GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_handle_ == INVALID_HANDLE_VALUE) {
+    LOGE(L"Could not open journal: " + path);
+    return false;
+  }
+
+  path_ = path;
+  record_count_ = record_count;
+  unflushed_count_ = 0;
+  sequence_ += record_count;
+
+  LARGE_INTEGER position{};
+  position.QuadPart = static_cast<LONGLONG>(valid_size);
+  if (::SetFilePointerEx(file_handle_, position, nullptr, FILE_BEGIN) == FALSE ||
+      ::SetEndOfFile(file_handle_) == FALSE) {
+    LOGE(L"Could not truncate journal: " + path);
+    Close();
+    return false;
+  }
+
+  if (valid_size == 0 && !WriteHeader()) {
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+void Journal::Close() {
+  if (file_handle_ != INVALID_HANDLE_VALUE) {
+    Flush();
+    ::CloseHandle(file_handle_);
+  }
+
+  file_handle_ = INVALID_HANDLE_VALUE;
+  record_count_ = 0;
+  unflushed_count_ = 0;
+}
+
+bool Journal::Clear() {
+  if (!is_open())
+    return false;
+
+  const auto path = path_;
+  return Open(path, 0, 0);
+}
+
+bool Journal::Append(const JournalRecord& record) {
+  if (!is_open())
+    return false;
+
+  const auto payload = WriteRecord(record);
+
+  BinaryWriter writer;
+  writer.Write(static_cast<uint32_t>(payload.size()));
+  writer.Write(GetChecksum(payload.data(), payload.size()));
+  writer.WriteBytes(payload.data(), payload.size());
+
+  const auto& data = writer.data();
+  DWORD bytes_written = 0;
+  if (::WriteFile(file_handle_, data.data(), static_cast<DWORD>(data.size()),
+                  &bytes_written, nullptr) == FALSE ||
+      bytes_written != data.size()) {
+    LOGE(L"Could not write to journal: " + path_);
+    return false;
+  }
+
+  record_count_ += 1;
+  sequence_ += 1;
+  if (++unflushed_count_ >= kJournalFlushInterval)
+    Flush();
+
+  return true;
+}
+
+bool Journal::Flush() {
+  if (!is_open())
+    return false;
+  if (unflushed_count_ == 0)
+    return true;
+
+  unflushed_count_ = 0;
+  return ::FlushFileBuffers(file_handle_) != FALSE;
+}
+
+void Journal::MarkDurable(uint64_t sequence) {
+  durable_sequence_ = sequence;
+}
+
+bool Journal::ClearDurable() {
+  if (record_count_ == 0 || durable_sequence_ < sequence_)
+    return false;
+
+  return Clear();
+}
+
+bool Journal::is_open() const {
+  return file_handle_ != INVALID_HANDLE_VALUE;
+}
+
+const std::wstring& Journal::path() const {
+  return path_;
+}
+
+size_t Journal::record_count() const {
+  return record_count_;
+}
+
+uint64_t Journal::sequence() const {
+  return sequence_;
+}
+
+bool Journal::WriteHeader() {
+  BinaryWriter writer;
+  writer.Write(kJournalMagic);
+  writer.Write(kJournalFormatVersion);
+
+  const auto& data = writer.data();
+  DWORD bytes_written = 0;
+  if (::WriteFile(file_handle_, data.data(), static_cast<DWORD>(data.size()),
+                  &bytes_written, nullptr) == FALSE ||
+      bytes_written != data.size()) {
+    LOGE(L"Could not write to journal: " + path_);
+    return false;
+  }
+
+  return ::FlushFileBuffers(file_handle_) != FALSE;
+}
+
+}  // namespace anime
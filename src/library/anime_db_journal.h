@@ -0,0 +1,105 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <windows.h>
+
+namespace anime {
+
+// Journal file layout:
+//   header: magic, format version
+//   records: payload size, payload checksum, payload
+// Each record holds the complete state of a list entry after a change, so
+// replaying a record more than once is harmless. A record that is cut short
+// or fails its checksum ends the journal.
+
+enum class JournalRecordType : uint8_t {
+  Entry = 1,
+  Deletion = 2,
+};
+
+struct JournalRecord {
+  JournalRecordType type = JournalRecordType::Entry;
+  int anime_id = 0;
+  std::wstring library_id;
+  int progress = 0;
+  int score = 0;
+  int status = 0;
+  int rewatched_times = 0;
+  int rewatching = 0;
+  int rewatching_ep = 0;
+  std::wstring date_start;
+  std::wstring date_end;
+  std::wstring tags;
+  std::wstring notes;
+  std::wstring last_updated;
+};
+
+// Append-only log of changes to the user's list, so that the whole list
+// doesn't have to be rewritten after every change. Records are written as
+// they come, but flushed to the disk in batches.
+//
+// Every record gets a sequence number. Once the list file that includes a
+// record is on the disk, the record is marked as durable and can be cleared.
+class Journal {
+public:
+  Journal() {}
+  ~Journal();
+
+  Journal(const Journal&) = delete;
+  Journal& operator=(const Journal&) = delete;
+
+  // Reads all valid records, and the size of the file up to the last one
+  static bool Read(const std::wstring& path, std::vector<JournalRecord>& records, size_t& valid_size);
+
+  // Anything after valid_size is discarded, so that new records don't end up
+  // behind a damaged one
+  bool Open(const std::wstring& path, size_t valid_size, size_t record_count);
+  void Close();
+  bool Clear();
+
+  bool Append(const JournalRecord& record);
+  bool Flush();
+
+  // MarkDurable can be called from any thread
+  void MarkDurable(uint64_t sequence);
+  bool ClearDurable();
+
+  bool is_open() const;
+  const std::wstring& path() const;
+  size_t record_count() const;
+  uint64_t sequence() const;
+
+private:
+  bool WriteHeader();
+
+  HANDLE file_handle_ = INVALID_HANDLE_VALUE;
+  std::wstring path_;
+  size_t record_count_ = 0;
+  size_t unflushed_count_ = 0;
+  uint64_t sequence_ = 0;
+  std::atomic<uint64_t> durable_sequence_{0};
+};
+
+}  // namespace anime
@@ -0,0 +1,491 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+
+#include "base/file.h"
+#include "base/log.h"
+#include "base/string.h"
+#include "base/time.h"
+#include "library/anime_db.h"
+#include "library/anime_db_snapshot.h"
+#include "sync/service.h"
+#include "taiga/path.h"
+#include "taiga/persistence.h"
+#include "taiga/taiga.h"
+
+namespace anime {
+
+static const uint32_t kSnapshotMagic = 0x42444154;  // "TADB"
+static const uint32_t kSnapshotFormatVersion = 1;
+
+static_assert(kSnapshotServiceCount == sync::kLastService + 1,
+              "Snapshot format must be updated for the new service");
+static_assert(sizeof(SnapshotRecord) == 112,
+              "Snapshot records must not have any padding");
+
+static uint32_t PackDate(const Date& date) {
+  if (!date)
+    return 0;
+  return (date.year() << 16) | (date.month() << 8) | date.day();
+}
+
+static Date UnpackDate(uint32_t value) {
+  return Date(static_cast<unsigned short>(value >> 16),
+              static_cast<unsigned short>((value >> 8) & 0xFF),
+              static_cast<unsigned short>(value & 0xFF));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Snapshot::Open(const std::wstring& path) {
+  if (!file_.Open(path))
+    return false;
+
+  if (!Read(file_.data(), file_.size())) {
+    file_.Close();
+    return false;
+  }
+
+  return true;
+}
+
+const std::string& Snapshot::app_version() const {
+  return app_version_;
+}
+
+size_t Snapshot::record_count() const {
+  return record_count_;
+}
+
+SnapshotRecord Snapshot::GetRecord(size_t index) const {
+  SnapshotRecord record;
+  std::memcpy(&record, records_ + index * sizeof(SnapshotRecord),
+              sizeof(SnapshotRecord));
+  return record;
+}
+
+uint32_t Snapshot::GetOffset(uint32_t index) const {
+  uint32_t offset = 0;
+  std::memcpy(&offset, offsets_ + index * sizeof(uint32_t), sizeof(uint32_t));
+  return offset;
+}
+
+const char* Snapshot::GetStringData(uint32_t index, size_t& length) const {
+  if (index >= string_count_) {
+    length = 0;
+    return nullptr;
+  }
+
+  const auto offset = GetOffset(index);
+  length = GetOffset(index + 1) - offset;
+  return characters_ + offset * sizeof(wchar_t);
+}
+
+std::wstring Snapshot::GetString(uint32_t index) const {
+  size_t length = 0;
+  const char* data = GetStringData(index, length);
+
+  std::wstring str(length, L'\0');
+  if (length)
+    std::memcpy(&str[0], data, length * sizeof(wchar_t));
+  return str;
+}
+
+std::vector<std::wstring> Snapshot::GetList(uint32_t first,
+                                            uint32_t count) const {
+  std::vector<std::wstring> strings;
+  strings.reserve(count);
+
+  for (uint32_t i = first; i < first + count; ++i) {
+    uint32_t index = 0;
+    std::memcpy(&index, lists_ + i * sizeof(uint32_t), sizeof(uint32_t));
+    strings.push_back(GetString(index));
+  }
+
+  return strings;
+}
+
+bool Snapshot::Read(const char* data, size_t size) {
+  BinaryReader reader(data, size);
+
+  uint32_t magic = 0;
+  uint32_t format_version = 0;
+  uint32_t char_size = 0;
+  uint32_t service_count = 0;
+
+  if (!reader.Read(magic) || !reader.Read(format_version) ||
+      !reader.Read(char_size) || !reader.Read(service_count) ||
+      !reader.ReadString(app_version_))
+    return false;
+
+  if (magic != kSnapshotMagic ||
+      format_version != kSnapshotFormatVersion ||
+      char_size != sizeof(wchar_t) ||
+      service_count != kSnapshotServiceCount)
+    return false;
+
+  // Each table is preceded by its size, and the whole table has to be inside
+  // the file
+  auto read_table = [&](uint32_t& count, size_t element_size,
+                        size_t extra_count, const char*& table) {
+    if (!reader.Read(count))
+      return false;
+    const size_t available = (size - reader.position()) / element_size;
+    if (count > available || extra_count > available - count)
+      return false;
+    table = data + reader.position();
+    reader.seek(reader.position() + (count + extra_count) * element_size);
+    return true;
+  };
+
+  if (!read_table(string_count_, sizeof(uint32_t), 1, offsets_) ||
+      string_count_ == 0)
+    return false;
+
+  uint32_t character_count = 0;
+  for (uint32_t i = 0; i <= string_count_; ++i) {
+    const auto offset = GetOffset(i);
+    if (offset < character_count)
+      return false;
+    character_count = offset;
+  }
+  if (GetOffset(0) != 0 || GetOffset(1) != 0)
+    return false;
+  if ((size - reader.position()) / sizeof(wchar_t) < character_count)
+    return false;
+  characters_ = data + reader.position();
+  reader.seek(reader.position() + character_count * sizeof(wchar_t));
+
+  if (!read_table(list_count_, sizeof(uint32_t), 0, lists_))
+    return false;
+  for (uint32_t i = 0; i < list_count_; ++i) {
+    uint32_t index = 0;
+    std::memcpy(&index, lists_ + i * sizeof(uint32_t), sizeof(uint32_t));
+    if (index >= string_count_)
+      return false;
+  }
+
+  if (!read_table(record_count_, sizeof(SnapshotRecord), 0, records_))
+    return false;
+  for (uint32_t i = 0; i < record_count_; ++i)
+    if (!IsValidRecord(GetRecord(i)))
+      return false;
+
+  return true;
+}
+
+bool Snapshot::IsValidRecord(const SnapshotRecord& record) const {
+  auto is_valid_string = [this](uint32_t index) {
+    return index < string_count_;
+  };
+  auto is_valid_list = [this](uint32_t first, uint32_t count) {
+    return first <= list_count_ && count <= list_count_ - first;
+  };
+
+  for (const auto& id : record.ids)
+    if (!is_valid_string(id))
+      return false;
+
+  return is_valid_string(record.title) &&
+         is_valid_string(record.english_title) &&
+         is_valid_string(record.japanese_title) &&
+         is_valid_string(record.slug) &&
+         is_valid_string(record.image_url) &&
+         is_valid_string(record.synopsis) &&
+         is_valid_list(record.synonyms, record.synonym_count) &&
+         is_valid_list(record.genres, record.genre_count) &&
+         is_valid_list(record.producers, record.producer_count);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SnapshotWriter::SnapshotWriter() {
+  offsets_.push_back(0);
+  AddStringData(nullptr, 0);
+}
+
+uint32_t SnapshotWriter::AddString(const std::wstring& str) {
+  if (str.empty())
+    return 0;
+
+  auto it = string_indices_.find(str);
+  if (it != string_indices_.end())
+    return it->second;
+
+  const auto index = AddStringData(reinterpret_cast<const char*>(str.data()),
+                                   str.size());
+  string_indices_.emplace(str, index);
+  return index;
+}
+
+uint32_t SnapshotWriter::AddStringData(const char* data, size_t length) {
+  const auto offset = characters_.size();
+  characters_.resize(offset + length);
+  if (length)
+    std::memcpy(&characters_[offset], data, length * sizeof(wchar_t));
+
+  offsets_.push_back(static_cast<uint32_t>(characters_.size()));
+  return static_cast<uint32_t>(offsets_.size() - 2);
+}
+
+uint32_t SnapshotWriter::AddList(const std::vector<std::wstring>& strings) {
+  const auto first = static_cast<uint32_t>(lists_.size());
+  for (const auto& str : strings)
+    lists_.push_back(AddString(str));
+  return first;
+}
+
+void SnapshotWriter::AddRecord(const SnapshotRecord& record) {
+  records_.push_back(record);
+}
+
+std::string SnapshotWriter::Write(const std::string& app_version) const {
+  BinaryWriter writer;
+
+  writer.Write(kSnapshotMagic);
+  writer.Write(kSnapshotFormatVersion);
+  writer.Write(static_cast<uint32_t>(sizeof(wchar_t)));
+  writer.Write(static_cast<uint32_t>(kSnapshotServiceCount));
+  writer.WriteString(app_version);
+
+  writer.Write(static_cast<uint32_t>(offsets_.size() - 1));
+  writer.WriteBytes(offsets_.data(), offsets_.size() * sizeof(uint32_t));
+  writer.WriteBytes(characters_.data(), characters_.size() * sizeof(wchar_t));
+
+  writer.Write(static_cast<uint32_t>(lists_.size()));
+  writer.WriteBytes(lists_.data(), lists_.size() * sizeof(uint32_t));
+
+  writer.Write(static_cast<uint32_t>(records_.size()));
+  writer.WriteBytes(records_.data(), records_.size() * sizeof(SnapshotRecord));
+
+  return writer.data();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static std::wstring GetSavedSnapshotPath(const std::wstring& path) {
+  return path + L".new";
+}
+
+static bool ReplaceSnapshotFile(const std::wstring& path) {
+  const auto saved_path = GetSavedSnapshotPath(path);
+  if (!::MoveFileEx(GetExtendedLengthPath(saved_path).c_str(),
+                    GetExtendedLengthPath(path).c_str(),
+                    MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+    LOGE(L"Could not replace database snapshot: " + path);
+    return false;
+  }
+  return true;
+}
+
+bool Database::LoadSnapshot(const std::wstring& path,
+                            std::wstring& meta_version) {
+  // A snapshot that was saved before exiting has yet to replace the old one
+  if (FileExists(GetSavedSnapshotPath(path)))
+    ReplaceSnapshotFile(path);
+
+  auto snapshot = std::make_unique<Snapshot>();
+
+  if (!snapshot->Open(path)) {
+    if (FileExists(path))
+      LOGW(L"Could not read database snapshot: " + path);
+    return false;
+  }
+
+  items.reserve(items.size() + snapshot->record_count());
+
+  for (size_t i = 0; i < snapshot->record_count(); ++i) {
+    const auto record = snapshot->GetRecord(i);
+
+    if (record.source == sync::kTaiga) {
+      LOGE(L"Invalid source for ID: " + snapshot->GetString(record.ids[0]));
+      continue;
+    }
+
+    const int id = ToInt(snapshot->GetString(record.ids[sync::kTaiga]));
+    Item& item = items[id];  // Creates the item if it doesn't exist
+
+    for (enum_t service = sync::kTaiga; service <= sync::kLastService; service++)
+      if (record.ids[service])
+        item.SetId(snapshot->GetString(record.ids[service]), service);
+    IndexServiceIds(item);
+
+    item.SetSource(static_cast<enum_t>(record.source));
+    item.SetTitle(snapshot->GetString(record.title));
+    item.SetType(record.type);
+    item.SetAiringStatus(record.airing_status);
+    item.SetAgeRating(static_cast<enum_t>(record.age_rating));
+    item.SetGenres(snapshot->GetList(record.genres, record.genre_count));
+    item.SetProducers(snapshot->GetList(record.producers, record.producer_count));
+    item.SetLastModified(static_cast<time_t>(record.modified));
+
+    if (record.synopsis)
+      snapshot_synopses_[id] = record.synopsis;
+
+    item.SetEnglishTitle(snapshot->GetString(record.english_title));
+    item.SetJapaneseTitle(snapshot->GetString(record.japanese_title));
+    item.SetSynonyms(snapshot->GetList(record.synonyms, record.synonym_count));
+    item.SetPopularity(record.popularity);
+    item.SetScore(record.score);
+    if (record.date_end)
+      item.SetDateEnd(UnpackDate(record.date_end));
+    if (record.date_start)
+      item.SetDateStart(UnpackDate(record.date_start));
+    item.SetEpisodeLength(record.episode_length);
+    item.SetEpisodeCount(record.episode_count);
+    item.SetSlug(snapshot->GetString(record.slug));
+    item.SetImageUrl(snapshot->GetString(record.image_url));
+  }
+
+  meta_version = StrToWstr(snapshot->app_version());
+  snapshot_ = std::move(snapshot);
+
+  return true;
+}
+
+bool Database::SaveSnapshot(const std::wstring& path) {
+  SwapSnapshot(path);
+
+  SnapshotWriter writer;
+  std::unordered_map<int, uint32_t> synopses;
+
+  auto positive = [](int value) {
+    return value > 0 ? value : 0;
+  };
+
+  for (const auto& pair : items) {
+    const auto& item = pair.second;
+    SnapshotRecord record{};
+
+    for (enum_t service = sync::kTaiga; service <= sync::kLastService; service++)
+      record.ids[service] = writer.AddString(item.GetId(service));
+
+    record.source = item.GetSource();
+    record.modified = static_cast<int64_t>(item.GetLastModified());
+    record.title = writer.AddString(item.GetTitle());
+    record.english_title = writer.AddString(item.GetEnglishTitle());
+    record.japanese_title = writer.AddString(item.GetJapaneseTitle());
+    record.slug = writer.AddString(item.GetSlug());
+    record.image_url = writer.AddString(item.GetImageUrl());
+
+    const auto synonyms = item.GetSynonyms();
+    record.synonyms = writer.AddList(synonyms);
+    record.synonym_count = static_cast<uint32_t>(synonyms.size());
+    record.genres = writer.AddList(item.GetGenres());
+    record.genre_count = static_cast<uint32_t>(item.GetGenres().size());
+    record.producers = writer.AddList(item.GetProducers());
+    record.producer_count = static_cast<uint32_t>(item.GetProducers().size());
+
+    record.type = positive(item.GetType());
+    record.airing_status = positive(item.GetAiringStatus());
+    record.episode_count = positive(item.GetEpisodeCount());
+    record.episode_length = positive(item.GetEpisodeLength());
+    record.age_rating = positive(item.GetAgeRating());
+    record.popularity = positive(item.GetPopularity());
+    record.score = item.GetScore() > 0.0 ? item.GetScore() : 0.0;
+    record.date_start = PackDate(item.GetDateStart());
+    record.date_end = PackDate(item.GetDateEnd());
+
+    // Synopses that haven't been read yet are copied over as they are
+    auto synopsis = snapshot_synopses_.find(pair.first);
+    if (snapshot_ && synopsis != snapshot_synopses_.end()) {
+      size_t length = 0;
+      const char* data = snapshot_->GetStringData(synopsis->second, length);
+      record.synopsis = writer.AddStringData(data, length);
+    } else if (!item.GetSynopsis().empty()) {
+      record.synopsis = writer.AddStringData(
+          reinterpret_cast<const char*>(item.GetSynopsis().data()),
+          item.GetSynopsis().size());
+    }
+    if (record.synopsis)
+      synopses[pair.first] = record.synopsis;
+
+    writer.AddRecord(record);
+  }
+
+  auto data = writer.Write(Taiga.version.str());
+
+  // The current file can't be replaced while it's mapped, so the new one is
+  // written next to it. Unread synopses keep referring to the current file
+  // until the new one is swapped in on this thread.
+  saved_synopses_ = std::move(synopses);
+  const auto sequence = ++saved_snapshot_sequence_;
+  Persistence.Save(GetSavedSnapshotPath(path), std::move(data),
+      [this, sequence]() { written_snapshot_sequence_ = sequence; });
+
+  return true;
+}
+
+void Database::SwapSnapshot(const std::wstring& path) {
+  // Only the last saved snapshot is swapped in, as the synopses refer to it
+  if (!saved_snapshot_sequence_ ||
+      written_snapshot_sequence_ != saved_snapshot_sequence_)
+    return;
+  saved_snapshot_sequence_ = 0;
+  written_snapshot_sequence_ = 0;
+
+  snapshot_.reset();
+  const bool replaced = ReplaceSnapshotFile(path);
+
+  auto snapshot = std::make_unique<Snapshot>();
+  if (!snapshot->Open(path)) {
+    LOGE(L"Could not read database snapshot: " + path);
+    snapshot_synopses_.clear();
+    saved_synopses_.clear();
+    return;
+  }
+  snapshot_ = std::move(snapshot);
+
+  // Synopses that were read or changed in the meantime are left alone. If the
+  // file could not be replaced, the current one is still in use.
+  if (replaced) {
+    for (auto it = saved_synopses_.begin(); it != saved_synopses_.end(); ) {
+      if (!snapshot_synopses_.count(it->first)) {
+        it = saved_synopses_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    snapshot_synopses_ = std::move(saved_synopses_);
+  }
+  saved_synopses_.clear();
+}
+
+void Database::LoadSynopsis(const Item& item) {
+  SwapSnapshot(taiga::GetPath(taiga::Path::DatabaseAnimeSnapshot));
+
+  if (snapshot_synopses_.empty() || !snapshot_)
+    return;
+
+  const int id = item.GetId();
+  auto it = snapshot_synopses_.find(id);
+  if (it == snapshot_synopses_.end())
+    return;
+
+  // Copies of database items are left alone
+  auto anime_item = FindItem(id, false);
+  if (anime_item != &item)
+    return;
+
+  const auto index = it->second;
+  snapshot_synopses_.erase(it);
+  anime_item->SetSynopsis(snapshot_->GetString(index));
+}
+
+}  // namespace anime
@@ -0,0 +1,119 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "base/binary.h"
+#include "base/file.h"
+
+namespace anime {
+
+// Snapshot file layout:
+//   header: magic, format version, wchar_t size, service count,
+//           application version
+//   strings: count, offsets (count + 1, in characters), characters
+//   lists: count, string indices (synonyms, genres, producers)
+//   records: count, fixed-width records
+// The first string is always empty, so that index 0 can stand for missing
+// values. Values are stored in native byte order.
+
+constexpr size_t kSnapshotServiceCount = 3;
+
+struct SnapshotRecord {
+  double score;
+  int64_t modified;
+  uint32_t ids[kSnapshotServiceCount];
+  uint32_t source;
+  uint32_t title;
+  uint32_t english_title;
+  uint32_t japanese_title;
+  uint32_t slug;
+  uint32_t image_url;
+  uint32_t synopsis;
+  uint32_t synonyms;
+  uint32_t synonym_count;
+  uint32_t genres;
+  uint32_t genre_count;
+  uint32_t producers;
+  uint32_t producer_count;
+  int32_t type;
+  int32_t airing_status;
+  int32_t episode_count;
+  int32_t episode_length;
+  int32_t age_rating;
+  int32_t popularity;
+  uint32_t date_start;  // year << 16 | month << 8 | day
+  uint32_t date_end;
+};
+
+class Snapshot {
+public:
+  bool Open(const std::wstring& path);
+
+  const std::string& app_version() const;
+  size_t record_count() const;
+
+  SnapshotRecord GetRecord(size_t index) const;
+  std::wstring GetString(uint32_t index) const;
+  std::vector<std::wstring> GetList(uint32_t first, uint32_t count) const;
+
+  // Characters of a string, as they are stored in the file
+  const char* GetStringData(uint32_t index, size_t& length) const;
+
+private:
+  bool Read(const char* data, size_t size);
+  bool IsValidRecord(const SnapshotRecord& record) const;
+  uint32_t GetOffset(uint32_t index) const;
+
+  MappedFile file_;
+
+  std::string app_version_;
+  uint32_t string_count_ = 0;
+  const char* offsets_ = nullptr;
+  const char* characters_ = nullptr;
+  uint32_t list_count_ = 0;
+  const char* lists_ = nullptr;
+  uint32_t record_count_ = 0;
+  const char* records_ = nullptr;
+};
+
+class SnapshotWriter {
+public:
+  SnapshotWriter();
+
+  uint32_t AddString(const std::wstring& str);
+  uint32_t AddStringData(const char* data, size_t length);
+  uint32_t AddList(const std::vector<std::wstring>& strings);
+  void AddRecord(const SnapshotRecord& record);
+
+  std::string Write(const std::string& app_version) const;
+
+private:
+  std::vector<uint32_t> offsets_;
+  std::wstring characters_;
+  std::unordered_map<std::wstring, uint32_t> string_indices_;
+  std::vector<uint32_t> lists_;
+  std::vector<SnapshotRecord> records_;
+};
+
+}  // namespace anime
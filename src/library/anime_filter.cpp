@@ -16,9 +16,12 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+
 #include "base/string.h"
 #include "library/anime_filter.h"
 #include "library/anime_item.h"
+#include "library/anime_text_index.h"
 #include "library/anime_util.h"
 
 namespace anime {
@@ -52,18 +55,20 @@ bool Filters::CheckItem(const Item& item, int text_index) const {
 }
 
 bool Filters::FilterText(const Item& item, int text_index) const {
-  std::vector<std::wstring> words;
-  auto it = text.find(text_index);
-  auto filter_text = it != text.end() ? it->second : std::wstring();
-  Split(filter_text, L" ", words);
-  RemoveEmptyStrings(words);
+  const auto& text_words = GetTextWords(text_index);
+  if (text_words.words.empty())
+    return true;
 
+  if (AnimeTextIndex.Contains(item.GetId()))
+    return std::binary_search(text_words.anime_ids.begin(),
+                              text_words.anime_ids.end(), item.GetId());
+
+  // Items that are not in the list are not indexed
   std::vector<std::wstring> titles;
   GetAllTitles(item.GetId(), titles);
 
-  const auto& genres = item.GetGenres();
-
-  for (const auto& word : words) {
+  for (size_t i = 0; i < text_words.words.size(); ++i) {
+    const auto& word = text_words.words.at(i);
     auto check_strings = [&word](const std::vector<std::wstring>& v) {
       for (const auto& str : v) {
         if (InStr(str, word, 0, true) > -1)
@@ -72,7 +77,7 @@ bool Filters::FilterText(const Item& item, int text_index) const {
       return false;
     };
     if (!check_strings(titles) &&
-        !check_strings(genres) &&
+        !item.HasGenreIn(text_words.genres.at(i)) &&
         InStr(item.GetMyTags(), word, 0, true) == -1)
       return false;
   }
@@ -80,6 +85,42 @@ bool Filters::FilterText(const Item& item, int text_index) const {
   return true;
 }
 
+const Filters::TextWords& Filters::GetTextWords(int text_index) const {
+  auto it = text.find(text_index);
+  const auto& filter_text = it != text.end() ? it->second : EmptyString();
+
+  // The index is not built until there's something to search for
+  if (!filter_text.empty())
+    AnimeTextIndex.Refresh();
+
+  // New symbols may have been added since the last time, which could match
+  // the same words
+  auto& text_words = text_words_[text_index];
+  if (text_words.text == filter_text &&
+      text_words.symbol_count == Symbols.size() &&
+      text_words.index_version == AnimeTextIndex.version())
+    return text_words;
+
+  text_words.text = filter_text;
+  text_words.symbol_count = Symbols.size();
+  text_words.index_version = AnimeTextIndex.version();
+  text_words.words.clear();
+  Split(filter_text, L" ", text_words.words);
+  RemoveEmptyStrings(text_words.words);
+
+  text_words.genres.clear();
+  text_words.genres.resize(text_words.words.size());
+  for (size_t i = 0; i < text_words.words.size(); ++i)
+    Symbols.Search(text_words.words.at(i), text_words.genres.at(i));
+
+  text_words.anime_ids.clear();
+  if (!text_words.words.empty())
+    AnimeTextIndex.Search(filter_text, TextMatch::Substring,
+                          text_words.anime_ids);
+
+  return text_words;
+}
+
 void Filters::Reset() {
   my_status.clear();
   status.clear();
@@ -90,6 +131,7 @@ void Filters::Reset() {
   type.resize(6, true);
 
   text.clear();
+  text_words_.clear();
 }
 
 }  // namespace anime
\ No newline at end of file
@@ -22,6 +22,8 @@
 #include <string>
 #include <vector>
 
+#include "library/symbol_table.h"
+
 namespace anime {
 
 class Item;
@@ -41,6 +43,20 @@ public:
 
 private:
   bool FilterText(const Item& item, int text_index) const;
+
+  // Words of each filter text, along with the genres that contain them, and
+  // the list items that match them. These are found once for every text,
+  // rather than once for every item.
+  struct TextWords {
+    std::wstring text;
+    size_t symbol_count = 0;
+    unsigned int index_version = 0;
+    std::vector<std::wstring> words;
+    std::vector<library::SymbolSet> genres;
+    std::vector<int> anime_ids;
+  };
+  const TextWords& GetTextWords(int text_index) const;
+  mutable std::map<int, TextWords> text_words_;
 };
 
 }  // namespace anime
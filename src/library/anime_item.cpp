@@ -54,10 +54,7 @@ const std::wstring& Item::GetId(enum_t service) const {
 }
 
 const std::wstring& Item::GetSlug() const {
-  if (metadata_.resource.size() > 1)
-    return metadata_.resource.at(1);
-
-  return EmptyString();
+  return metadata_.slug;
 }
 
 enum_t Item::GetSource() const {
@@ -69,17 +66,11 @@ int Item::GetType() const {
 }
 
 int Item::GetEpisodeCount() const {
-  if (metadata_.extent.size() > 0)
-    return metadata_.extent.at(0);
-
-  return kUnknownEpisodeCount;
+  return metadata_.episode_count;
 }
 
 int Item::GetEpisodeLength() const {
-  if (metadata_.extent.size() > 1)
-    return metadata_.extent.at(1);
-
-  return kUnknownEpisodeLength;
+  return metadata_.episode_length;
 }
 
 int Item::GetAiringStatus(bool check_date) const {
@@ -125,53 +116,49 @@ std::vector<std::wstring> Item::GetSynonyms() const {
 }
 
 const Date& Item::GetDateStart() const {
-  if (metadata_.date.size() > 0)
-    return metadata_.date.at(0);
-
-  return EmptyDate();
+  return metadata_.date_start;
 }
 
 const Date& Item::GetDateEnd() const {
-  if (metadata_.date.size() > 1)
-    return metadata_.date.at(1);
-
-  return EmptyDate();
+  return metadata_.date_end;
 }
 
 const std::wstring& Item::GetImageUrl() const {
-  if (metadata_.resource.size() > 0)
-    return metadata_.resource.at(0);
-
-  return EmptyString();
+  return metadata_.image_url;
 }
 
 enum_t Item::GetAgeRating() const {
   return metadata_.audience;
 }
 
-const std::vector<std::wstring>& Item::GetGenres() const {
+std::vector<std::wstring> Item::GetGenres() const {
+  return Symbols.GetStrings(metadata_.subject);
+}
+
+const library::symbols_t& Item::GetGenreSymbols() const {
   return metadata_.subject;
 }
 
 int Item::GetPopularity() const {
-  if (metadata_.community.size() > 1)
-    return ToInt(metadata_.community.at(1));
+  return metadata_.popularity;
+}
 
-  return 0;
+std::vector<std::wstring> Item::GetProducers() const {
+  return Symbols.GetStrings(metadata_.creator);
 }
 
-const std::vector<std::wstring>& Item::GetProducers() const {
+const library::symbols_t& Item::GetProducerSymbols() const {
   return metadata_.creator;
 }
 
 double Item::GetScore() const {
-  if (metadata_.community.size() > 0)
-    return ToDouble(metadata_.community.at(0));
-
-  return 0.0;
+  return metadata_.score;
 }
 
 const std::wstring& Item::GetSynopsis() const {
+  if (metadata_.description.empty())
+    database_->LoadSynopsis(*this);
+
   return metadata_.description;
 }
 
@@ -189,13 +176,7 @@ void Item::SetId(const std::wstring& id, enum_t service) {
 }
 
 void Item::SetSlug(const std::wstring& slug) {
-  if (metadata_.resource.size() < 2) {
-    if (slug.empty())
-      return;
-    metadata_.resource.resize(2);
-  }
-
-  metadata_.resource.at(1) = slug;
+  metadata_.slug = slug;
 }
 
 void Item::SetSource(enum_t source) {
@@ -207,10 +188,7 @@ void Item::SetType(int type) {
 }
 
 void Item::SetEpisodeCount(int number) {
-  if (metadata_.extent.size() < 1)
-    metadata_.extent.resize(1);
-
-  metadata_.extent.at(0) = number;
+  metadata_.episode_count = number;
 
   // TODO: Call it separately
   if (number >= 0)
@@ -219,13 +197,10 @@ void Item::SetEpisodeCount(int number) {
 }
 
 void Item::SetEpisodeLength(int number) {
-  if (metadata_.extent.size() < 2) {
-    if (number <= 0)
-      return;
-    metadata_.extent.resize(2);
-  }
+  if (number <= 0 && metadata_.episode_length == kUnknownEpisodeLength)
+    return;
 
-  metadata_.extent.at(1) = number;
+  metadata_.episode_length = number;
 }
 
 void Item::SetAiringStatus(int status) {
@@ -301,13 +276,7 @@ void Item::SetSynonyms(const std::vector<std::wstring>& synonyms) {
 }
 
 void Item::SetDateStart(const Date& date) {
-  if (metadata_.date.size() < 1) {
-    if (!IsValidDate(date))
-      return;
-    metadata_.date.resize(1);
-  }
-
-  metadata_.date.at(0) = date;
+  metadata_.date_start = date;
 }
 
 void Item::SetDateStart(const std::wstring& date) {
@@ -315,13 +284,7 @@ void Item::SetDateStart(const std::wstring& date) {
 }
 
 void Item::SetDateEnd(const Date& date) {
-  if (metadata_.date.size() < 2) {
-    if (!IsValidDate(date))
-      return;
-    metadata_.date.resize(2);
-  }
-
-  metadata_.date.at(1) = date;
+  metadata_.date_end = date;
 }
 
 void Item::SetDateEnd(const std::wstring& date) {
@@ -329,13 +292,7 @@ void Item::SetDateEnd(const std::wstring& date) {
 }
 
 void Item::SetImageUrl(const std::wstring& url) {
-  if (metadata_.resource.size() < 1) {
-    if (url.empty())
-      return;
-    metadata_.resource.resize(1);
-  }
-
-  metadata_.resource.at(0) = url;
+  metadata_.image_url = url;
 }
 
 void Item::SetAgeRating(enum_t rating) {
@@ -351,17 +308,15 @@ void Item::SetGenres(const std::wstring& genres) {
 }
 
 void Item::SetGenres(const std::vector<std::wstring>& genres) {
+  metadata_.subject = Symbols.Intern(genres);
+}
+
+void Item::SetGenreSymbols(const library::symbols_t& genres) {
   metadata_.subject = genres;
 }
 
 void Item::SetPopularity(int popularity) {
-  if (metadata_.community.size() < 2) {
-    if (popularity <= 0)
-      return;
-    metadata_.community.resize(2);
-  }
-
-  metadata_.community.at(1) = ToWstr(popularity);
+  metadata_.popularity = popularity > 0 ? popularity : 0;
 }
 
 void Item::SetProducers(const std::wstring& producers) {
@@ -373,17 +328,15 @@ void Item::SetProducers(const std::wstring& producers) {
 }
 
 void Item::SetProducers(const std::vector<std::wstring>& producers) {
+  metadata_.creator = Symbols.Intern(producers);
+}
+
+void Item::SetProducerSymbols(const library::symbols_t& producers) {
   metadata_.creator = producers;
 }
 
 void Item::SetScore(double score) {
-  if (metadata_.community.size() < 1) {
-    if (score <= 0.0)
-      return;
-    metadata_.community.resize(1);
-  }
-
-  metadata_.community.at(0) = score > 0.0 ? ToWstr(score) : L"";
+  metadata_.score = score > 0.0 ? score : kUnknownScore;
 }
 
 void Item::SetSynopsis(const std::wstring& synopsis) {
@@ -394,6 +347,35 @@ void Item::SetLastModified(time_t modified) {
   metadata_.modified = modified;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+bool Item::HasGenre(const std::wstring& genre) const {
+  library::symbol_t symbol;
+  if (!Symbols.Find(genre, symbol))
+    return false;
+
+  const auto& genres = metadata_.subject;
+  return std::find(genres.begin(), genres.end(), symbol) != genres.end();
+}
+
+bool Item::HasGenreIn(const library::SymbolSet& genres) const {
+  return genres.contains_any(metadata_.subject);
+}
+
+bool Item::HasProducer(const std::wstring& producer) const {
+  library::symbol_t symbol;
+  if (!Symbols.Find(producer, symbol))
+    return false;
+
+  const auto& producers = metadata_.creator;
+  return std::find(producers.begin(), producers.end(), symbol) !=
+         producers.end();
+}
+
+bool Item::HasProducerIn(const library::SymbolSet& producers) const {
+  return producers.contains_any(metadata_.creator);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -61,9 +61,11 @@ public:
   const Date& GetDateEnd() const;
   const std::wstring& GetImageUrl() const;
   enum_t GetAgeRating() const;
-  const std::vector<std::wstring>& GetGenres() const;
+  std::vector<std::wstring> GetGenres() const;
+  const library::symbols_t& GetGenreSymbols() const;
   int GetPopularity() const;
-  const std::vector<std::wstring>& GetProducers() const;
+  std::vector<std::wstring> GetProducers() const;
+  const library::symbols_t& GetProducerSymbols() const;
   double GetScore() const;
   const std::wstring& GetSynopsis() const;
   const time_t GetLastModified() const;
@@ -89,13 +91,20 @@ public:
   void SetAgeRating(enum_t rating);
   void SetGenres(const std::wstring& genres);
   void SetGenres(const std::vector<std::wstring>& genres);
+  void SetGenreSymbols(const library::symbols_t& genres);
   void SetPopularity(int popularity);
   void SetProducers(const std::wstring& producers);
   void SetProducers(const std::vector<std::wstring>& producers);
+  void SetProducerSymbols(const library::symbols_t& producers);
   void SetScore(double score);
   void SetSynopsis(const std::wstring& synopsis);
   void SetLastModified(time_t modified);
 
+  bool HasGenre(const std::wstring& genre) const;
+  bool HasGenreIn(const library::SymbolSet& genres) const;
+  bool HasProducer(const std::wstring& producer) const;
+  bool HasProducerIn(const library::SymbolSet& producers) const;
+
   //////////////////////////////////////////////////////////////////////////////
   // Library data
 
@@ -0,0 +1,118 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "library/anime_item_store.h"
+
+namespace anime {
+
+ItemStore::iterator ItemStore::find(int id) {
+  auto it = slots_.find(id);
+  return it != slots_.end() ? iterator(this, it->second) : end();
+}
+
+ItemStore::const_iterator ItemStore::find(int id) const {
+  auto it = slots_.find(id);
+  return it != slots_.end() ? const_iterator(this, it->second) : end();
+}
+
+Item& ItemStore::operator[](int id) {
+  auto it = slots_.find(id);
+  if (it != slots_.end())
+    return GetSlot(it->second)->second;
+
+  size_t slot = slot_count_;
+  if (!free_slots_.empty()) {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  } else {
+    if (slot == capacity())
+      blocks_.push_back(std::make_unique<slot_t[]>(kBlockSize));
+    ++slot_count_;
+  }
+
+  auto& value = GetSlot(slot);
+  value.emplace(std::piecewise_construct,
+                std::forward_as_tuple(id), std::forward_as_tuple());
+  slots_[id] = slot;
+  ++size_;
+
+  return value->second;
+}
+
+ItemStore::iterator ItemStore::erase(const_iterator it) {
+  const size_t slot = it.slot_;
+  auto& value = GetSlot(slot);
+
+  slots_.erase(value->first);
+  value.reset();
+  free_slots_.push_back(slot);
+  --size_;
+
+  return iterator(this, NextSlot(slot));
+}
+
+size_t ItemStore::erase(int id) {
+  auto it = find(id);
+  if (it == end())
+    return 0;
+
+  erase(it);
+  return 1;
+}
+
+void ItemStore::clear() {
+  blocks_.clear();
+  slots_.clear();
+  free_slots_.clear();
+  slot_count_ = 0;
+  size_ = 0;
+}
+
+void ItemStore::reserve(size_t count) {
+  slots_.reserve(count);
+  blocks_.reserve((count + kBlockSize - 1) / kBlockSize);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ItemStore::slot_t& ItemStore::GetSlot(size_t slot) {
+  return blocks_[slot / kBlockSize][slot % kBlockSize];
+}
+
+const ItemStore::slot_t& ItemStore::GetSlot(size_t slot) const {
+  return blocks_[slot / kBlockSize][slot % kBlockSize];
+}
+
+size_t ItemStore::NextSlot(size_t slot) const {
+  // kNoSlot wraps around to the first slot
+  for (++slot; slot < slot_count_; ++slot)
+    if (GetSlot(slot))
+      return slot;
+
+  return slot_count_;
+}
+
+size_t ItemStore::PreviousSlot(size_t slot) const {
+  while (slot > 0)
+    if (GetSlot(--slot))
+      return slot;
+
+  return kNoSlot;
+}
+
+}  // namespace anime
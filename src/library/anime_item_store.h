@@ -0,0 +1,146 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "library/anime_item.h"
+
+namespace anime {
+
+// Keeps items in blocks of contiguous slots, with a table that maps IDs to
+// slots. Going through the whole database touches memory in order, instead of
+// following the nodes of a tree.
+//
+// Slots are never moved, so pointers to items remain valid until they are
+// erased, as they did with std::map. Erased slots are reused by later items.
+// Items are iterated in slot order rather than ID order.
+class ItemStore {
+public:
+  typedef std::pair<const int, Item> value_type;
+
+  template <typename Store, typename Value>
+  class basic_iterator {
+  public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef std::remove_const_t<Value> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef Value* pointer;
+    typedef Value& reference;
+
+    basic_iterator() = default;
+    basic_iterator(Store* store, size_t slot) : store_(store), slot_(slot) {}
+    template <typename OtherStore, typename OtherValue>
+    basic_iterator(const basic_iterator<OtherStore, OtherValue>& it)
+        : store_(it.store_), slot_(it.slot_) {}
+
+    reference operator*() const { return *store_->GetSlot(slot_); }
+    pointer operator->() const { return &*store_->GetSlot(slot_); }
+
+    basic_iterator& operator++() {
+      slot_ = store_->NextSlot(slot_);
+      return *this;
+    }
+    basic_iterator operator++(int) {
+      auto it = *this;
+      ++*this;
+      return it;
+    }
+    basic_iterator& operator--() {
+      slot_ = store_->PreviousSlot(slot_);
+      return *this;
+    }
+    basic_iterator operator--(int) {
+      auto it = *this;
+      --*this;
+      return it;
+    }
+
+    bool operator==(const basic_iterator& it) const { return slot_ == it.slot_; }
+    bool operator!=(const basic_iterator& it) const { return slot_ != it.slot_; }
+
+  private:
+    template <typename, typename>
+    friend class basic_iterator;
+    friend class ItemStore;
+
+    Store* store_ = nullptr;
+    size_t slot_ = 0;
+  };
+
+  typedef basic_iterator<ItemStore, value_type> iterator;
+  typedef basic_iterator<const ItemStore, const value_type> const_iterator;
+  typedef std::reverse_iterator<iterator> reverse_iterator;
+  typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+  iterator begin() { return iterator(this, NextSlot(kNoSlot)); }
+  iterator end() { return iterator(this, slot_count_); }
+  const_iterator begin() const { return const_iterator(this, NextSlot(kNoSlot)); }
+  const_iterator end() const { return const_iterator(this, slot_count_); }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+  reverse_iterator rbegin() { return reverse_iterator(end()); }
+  reverse_iterator rend() { return reverse_iterator(begin()); }
+  const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+  const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+  const_reverse_iterator crbegin() const { return rbegin(); }
+  const_reverse_iterator crend() const { return rend(); }
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return blocks_.size() * kBlockSize; }
+
+  iterator find(int id);
+  const_iterator find(int id) const;
+
+  // Creates the item if it doesn't exist
+  Item& operator[](int id);
+
+  iterator erase(const_iterator it);
+  size_t erase(int id);
+  void clear();
+  void reserve(size_t count);
+
+private:
+  static constexpr size_t kBlockSize = 256;
+  static constexpr size_t kNoSlot = static_cast<size_t>(-1);
+
+  typedef std::optional<value_type> slot_t;
+
+  slot_t& GetSlot(size_t slot);
+  const slot_t& GetSlot(size_t slot) const;
+  size_t NextSlot(size_t slot) const;
+  size_t PreviousSlot(size_t slot) const;
+
+  std::vector<std::unique_ptr<slot_t[]>> blocks_;
+  std::unordered_map<int, size_t> slots_;
+  std::vector<size_t> free_slots_;
+  size_t slot_count_ = 0;
+  size_t size_ = 0;
+};
+
+}  // namespace anime
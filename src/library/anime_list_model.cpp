@@ -0,0 +1,214 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "library/anime.h"
+#include "library/anime_item.h"
+#include "library/anime_list_model.h"
+
+namespace anime {
+
+static bool IsListedStatus(int status) {
+  return status >= kMyStatusFirst && status < kMyStatusLast;
+}
+
+void ListModel::SetFindFunction(find_function_t find_function) {
+  find_function_ = find_function;
+}
+
+void ListModel::SetStatusFunction(status_function_t status_function) {
+  status_function_ = status_function;
+}
+
+void ListModel::SetLessFunction(less_function_t less_function) {
+  less_function_ = less_function;
+}
+
+void ListModel::Rebuild(const std::vector<int>& anime_ids) {
+  Clear();
+
+  if (status_function_) {
+    for (const auto anime_id : anime_ids) {
+      auto anime_item = FindItem(anime_id);
+      if (!anime_item)
+        continue;
+      const int status = status_function_(*anime_item);
+      if (IsListedStatus(status)) {
+        items_.at(status).push_back(anime_id);
+        positions_[anime_id] = {status, -1};
+      }
+    }
+  }
+
+  Sort();
+  built_ = true;
+}
+
+void ListModel::Sort() {
+  if (!less_function_)
+    return;
+
+  std::vector<const Item*> items;
+
+  for (auto& anime_ids : items_) {
+    // Items are looked up once, rather than once for every comparison
+    items.clear();
+    for (const auto anime_id : anime_ids) {
+      auto anime_item = FindItem(anime_id);
+      if (anime_item) {
+        items.push_back(anime_item);
+      } else {
+        positions_.erase(anime_id);
+      }
+    }
+
+    std::sort(items.begin(), items.end(),
+              [this](const Item* item1, const Item* item2) {
+                return less_function_(*item1, *item2);
+              });
+
+    anime_ids.resize(items.size());
+    for (size_t i = 0; i < items.size(); ++i)
+      anime_ids.at(i) = items.at(i)->GetId();
+  }
+
+  for (size_t status = 0; status < items_.size(); ++status)
+    UpdatePositions(static_cast<int>(status),
+                    0, static_cast<int>(items_.at(status).size()));
+}
+
+void ListModel::Clear() {
+  items_.clear();
+  items_.resize(kMyStatusLast);
+  positions_.clear();
+  built_ = false;
+}
+
+void ListModel::UpdateItem(int anime_id, std::vector<ListChange>& changes) {
+  changes.clear();
+
+  if (!built_)
+    return;
+
+  // Previous position. The item may not compare the same as it used to, so
+  // it's looked up by its ID.
+  int old_status = kNotInList;
+  int old_index = -1;
+  auto it = positions_.find(anime_id);
+  if (it != positions_.end()) {
+    old_status = it->second.status;
+    old_index = it->second.index;
+    auto& anime_ids = items_.at(old_status);
+    anime_ids.erase(anime_ids.begin() + old_index);
+    positions_.erase(it);
+  }
+
+  // New position. Other items have not changed, so a binary search is enough.
+  int new_status = kNotInList;
+  int new_index = -1;
+  auto anime_item = FindItem(anime_id);
+  if (anime_item && status_function_)
+    new_status = status_function_(*anime_item);
+  if (IsListedStatus(new_status)) {
+    auto& anime_ids = items_.at(new_status);
+    auto position = std::lower_bound(
+        anime_ids.begin(), anime_ids.end(), anime_id,
+        [this](int anime_id1, int anime_id2) {
+          return Less(anime_id1, anime_id2);
+        });
+    new_index = static_cast<int>(position - anime_ids.begin());
+    anime_ids.insert(position, anime_id);
+  }
+
+  // Only the items between the previous and the new position have shifted
+  if (old_index > -1 && new_index > -1 && old_status == new_status) {
+    UpdatePositions(new_status, std::min(old_index, new_index),
+                    std::max(old_index, new_index) + 1);
+  } else {
+    if (old_index > -1)
+      UpdatePositions(old_status, old_index,
+                      static_cast<int>(items_.at(old_status).size()));
+    if (new_index > -1)
+      UpdatePositions(new_status, new_index,
+                      static_cast<int>(items_.at(new_status).size()));
+  }
+
+  if (old_index > -1 && new_index > -1 && old_status == new_status) {
+    changes.push_back({old_index == new_index ? ListChange::Type::Update :
+                                                ListChange::Type::Move,
+                       anime_id, new_status, old_index, new_index});
+    return;
+  }
+
+  if (old_index > -1)
+    changes.push_back({ListChange::Type::Remove,
+                       anime_id, old_status, old_index, -1});
+  if (new_index > -1)
+    changes.push_back({ListChange::Type::Insert,
+                       anime_id, new_status, -1, new_index});
+}
+
+bool ListModel::built() const {
+  return built_;
+}
+
+const std::vector<int>& ListModel::GetItems(int status) const {
+  static const std::vector<int> empty_items;
+
+  if (!IsListedStatus(status) || items_.empty())
+    return empty_items;
+
+  return items_.at(status);
+}
+
+int ListModel::GetIndex(int anime_id) const {
+  auto it = positions_.find(anime_id);
+  return it != positions_.end() ? it->second.index : -1;
+}
+
+int ListModel::GetStatus(int anime_id) const {
+  auto it = positions_.find(anime_id);
+  return it != positions_.end() ? it->second.status : kNotInList;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const Item* ListModel::FindItem(int anime_id) const {
+  return find_function_ ? find_function_(anime_id) : nullptr;
+}
+
+bool ListModel::Less(int anime_id1, int anime_id2) const {
+  auto item1 = FindItem(anime_id1);
+  auto item2 = FindItem(anime_id2);
+
+  if (!item1 || !item2)
+    return anime_id1 < anime_id2;
+  if (!less_function_)
+    return anime_id1 < anime_id2;
+
+  return less_function_(*item1, *item2);
+}
+
+void ListModel::UpdatePositions(int status, int begin, int end) {
+  const auto& anime_ids = items_.at(status);
+  for (int i = begin; i < end; ++i)
+    positions_[anime_ids.at(i)] = {status, i};
+}
+
+}  // namespace anime
@@ -0,0 +1,102 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace anime {
+
+class Item;
+
+// A change to a single row of a list model. Indices are positions within the
+// status that the item belongs to. An item that moves to another status is
+// reported as a removal followed by an insertion.
+struct ListChange {
+  enum class Type {
+    Insert,  // Added at new_index
+    Remove,  // Removed from old_index
+    Move,    // Moved from old_index to new_index within the same status
+    Update,  // Stayed at the same index, but its values may have changed
+  };
+
+  Type type;
+  int anime_id;
+  int status;
+  int old_index;
+  int new_index;
+};
+
+// Keeps the list items of each status filtered and sorted, independently of
+// how the list is displayed. A full rebuild goes through every given item,
+// while a single item can be updated with a binary search, which reports what
+// happened to it so that a view can apply the same change to its rows. The
+// position of each item is remembered, because a changed item may no longer
+// compare the same as it used to. Items are only ever accessed through the
+// find function.
+class ListModel {
+public:
+  // Returns the item with the given ID, or nullptr if there is no such item
+  typedef std::function<const Item*(int)> find_function_t;
+  // Returns the status under which an item is listed, or kNotInList if it
+  // should not be listed at all
+  typedef std::function<int(const Item&)> status_function_t;
+  // Returns true if the first item comes before the second one. Items must
+  // never compare equal, and the order of items must not change without the
+  // model being notified.
+  typedef std::function<bool(const Item&, const Item&)> less_function_t;
+
+  void SetFindFunction(find_function_t find_function);
+  void SetStatusFunction(status_function_t status_function);
+  void SetLessFunction(less_function_t less_function);
+
+  // Rebuilds every status from the given items
+  void Rebuild(const std::vector<int>& anime_ids);
+  // Sorts every status again, e.g. after the less function is changed
+  void Sort();
+  void Clear();
+
+  // Updates a single item that has been added, changed or removed
+  void UpdateItem(int anime_id, std::vector<ListChange>& changes);
+
+  bool built() const;
+  const std::vector<int>& GetItems(int status) const;
+  int GetIndex(int anime_id) const;
+  int GetStatus(int anime_id) const;
+
+private:
+  struct Position {
+    int status;
+    int index;
+  };
+
+  const Item* FindItem(int anime_id) const;
+  bool Less(int anime_id1, int anime_id2) const;
+  void UpdatePositions(int status, int begin, int end);
+
+  std::vector<std::vector<int>> items_;
+  std::unordered_map<int, Position> positions_;
+  find_function_t find_function_;
+  status_function_t status_function_;
+  less_function_t less_function_;
+  bool built_ = false;
+};
+
+}  // namespace anime
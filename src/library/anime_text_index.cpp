@@ -0,0 +1,285 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <iterator>
+
+#include "base/string.h"
+#include "library/anime_db.h"
+#include "library/anime_item.h"
+#include "library/anime_text_index.h"
+
+anime::TextIndex AnimeTextIndex;
+
+namespace anime {
+
+// Cannot appear in search words, which are separated by spaces
+static const wchar_t kFieldSeparator = L'\n';
+
+void TextIndex::UpdateItem(int anime_id) {
+  if (built_)
+    changed_items_.insert(anime_id);
+}
+
+void TextIndex::Invalidate() {
+  documents_.clear();
+  postings_.clear();
+  changed_items_.clear();
+  built_ = false;
+  ++version_;
+}
+
+bool TextIndex::Refresh() {
+  if (!built_) {
+    Build();
+    return true;
+  }
+
+  if (changed_items_.empty())
+    return false;
+
+  for (const auto anime_id : changed_items_) {
+    RemoveItem(anime_id);
+    auto anime_item = AnimeDatabase.FindItem(anime_id, false);
+    if (anime_item && anime_item->IsInList())
+      AddItem(*anime_item);
+  }
+  changed_items_.clear();
+  ++version_;
+
+  return true;
+}
+
+bool TextIndex::Contains(int anime_id) const {
+  return documents_.find(anime_id) != documents_.end();
+}
+
+void TextIndex::Search(const std::wstring& text, TextMatch match,
+                       std::vector<int>& anime_ids) {
+  Refresh();
+
+  std::vector<std::wstring> words;
+  Split(text, L" ", words);
+  RemoveEmptyStrings(words);
+
+  anime_ids.clear();
+
+  if (words.empty()) {
+    for (const auto& pair : documents_)
+      anime_ids.push_back(pair.first);
+    std::sort(anime_ids.begin(), anime_ids.end());
+    return;
+  }
+
+  std::vector<int> word_ids;
+  std::vector<int> intersection;
+
+  for (size_t i = 0; i < words.size(); ++i) {
+    ToLower(words.at(i));
+    SearchWord(words.at(i), match, i == 0 ? anime_ids : word_ids);
+    if (i > 0) {
+      intersection.clear();
+      std::set_intersection(anime_ids.begin(), anime_ids.end(),
+                            word_ids.begin(), word_ids.end(),
+                            std::back_inserter(intersection));
+      anime_ids.swap(intersection);
+    }
+    if (anime_ids.empty())
+      break;
+  }
+}
+
+unsigned int TextIndex::version() const {
+  return version_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TextIndex::Build() {
+  documents_.clear();
+  postings_.clear();
+  changed_items_.clear();
+
+  for (const auto& pair : AnimeDatabase.items)
+    if (pair.second.IsInList())
+      AddItem(pair.second);
+
+  built_ = true;
+  ++version_;
+}
+
+void TextIndex::AddItem(const Item& item) {
+  const int anime_id = item.GetId();
+  auto document = GetDocument(item);
+
+  std::vector<trigram_t> trigrams;
+  GetTrigrams(document, trigrams);
+
+  for (const auto trigram : trigrams) {
+    auto& anime_ids = postings_[trigram];
+    auto it = std::lower_bound(anime_ids.begin(), anime_ids.end(), anime_id);
+    if (it == anime_ids.end() || *it != anime_id)
+      anime_ids.insert(it, anime_id);
+  }
+
+  documents_[anime_id] = std::move(document);
+}
+
+void TextIndex::RemoveItem(int anime_id) {
+  auto document = documents_.find(anime_id);
+  if (document == documents_.end())
+    return;
+
+  std::vector<trigram_t> trigrams;
+  GetTrigrams(document->second, trigrams);
+
+  for (const auto trigram : trigrams) {
+    auto posting = postings_.find(trigram);
+    if (posting == postings_.end())
+      continue;
+    auto& anime_ids = posting->second;
+    auto it = std::lower_bound(anime_ids.begin(), anime_ids.end(), anime_id);
+    if (it != anime_ids.end() && *it == anime_id)
+      anime_ids.erase(it);
+    if (anime_ids.empty())
+      postings_.erase(posting);
+  }
+
+  documents_.erase(document);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TextIndex::SearchWord(const std::wstring& word, TextMatch match,
+                           std::vector<int>& anime_ids) const {
+  anime_ids.clear();
+
+  // Words that are too short to have a trigram are checked against every
+  // document. That's still cheaper than the alternative, since documents are
+  // already lowercased and in one piece.
+  if (word.size() < 3) {
+    for (const auto& pair : documents_)
+      if (MatchDocument(pair.second, word, match))
+        anime_ids.push_back(pair.first);
+    std::sort(anime_ids.begin(), anime_ids.end());
+    return;
+  }
+
+  std::vector<trigram_t> trigrams;
+  GetTrigrams(word, trigrams);
+
+  std::vector<const std::vector<int>*> postings;
+  for (const auto trigram : trigrams) {
+    auto it = postings_.find(trigram);
+    if (it == postings_.end())
+      return;
+    postings.push_back(&it->second);
+  }
+
+  // Starting with the shortest list keeps intermediate results small
+  std::sort(postings.begin(), postings.end(),
+            [](const std::vector<int>* a, const std::vector<int>* b) {
+              return a->size() < b->size();
+            });
+
+  std::vector<int> candidates = *postings.front();
+  std::vector<int> intersection;
+  for (size_t i = 1; i < postings.size() && !candidates.empty(); ++i) {
+    intersection.clear();
+    std::set_intersection(candidates.begin(), candidates.end(),
+                          postings.at(i)->begin(), postings.at(i)->end(),
+                          std::back_inserter(intersection));
+    candidates.swap(intersection);
+  }
+
+  // Having every trigram of a word doesn't mean having the word itself
+  for (const auto anime_id : candidates)
+    if (MatchDocument(documents_.at(anime_id), word, match))
+      anime_ids.push_back(anime_id);
+}
+
+bool TextIndex::MatchDocument(const std::wstring& document,
+                              const std::wstring& word,
+                              TextMatch match) const {
+  for (auto pos = document.find(word); pos != std::wstring::npos;
+       pos = document.find(word, pos + 1)) {
+    if (match == TextMatch::Substring)
+      return true;
+    if (pos == 0 || !IsAlphanumericChar(document.at(pos - 1)))
+      return true;
+  }
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::wstring TextIndex::GetDocument(const Item& item) {
+  std::wstring document;
+
+  auto append = [&document](const std::wstring& str) {
+    if (str.empty())
+      return;
+    if (!document.empty())
+      document.push_back(kFieldSeparator);
+    document.append(str);
+  };
+
+  append(item.GetTitle());
+  append(item.GetEnglishTitle());
+  append(item.GetJapaneseTitle());
+  for (const auto& synonym : item.GetSynonyms())
+    append(synonym);
+  for (const auto& synonym : item.GetUserSynonyms())
+    append(synonym);
+  for (const auto& genre : item.GetGenres())
+    append(genre);
+  append(item.GetMyTags());
+
+  ToLower(document);
+
+  return document;
+}
+
+void TextIndex::GetTrigrams(const std::wstring& document,
+                            std::vector<trigram_t>& trigrams) {
+  trigrams.clear();
+  if (document.size() < 3)
+    return;
+
+  // 21 bits are enough for any code point
+  auto pack = [](wchar_t c) {
+    return static_cast<trigram_t>(c) & 0x1FFFFF;
+  };
+
+  for (size_t i = 0; i + 2 < document.size(); ++i) {
+    const wchar_t c0 = document.at(i);
+    const wchar_t c1 = document.at(i + 1);
+    const wchar_t c2 = document.at(i + 2);
+    if (c0 == kFieldSeparator || c1 == kFieldSeparator ||
+        c2 == kFieldSeparator)
+      continue;
+    trigrams.push_back((pack(c0) << 42) | (pack(c1) << 21) | pack(c2));
+  }
+
+  std::sort(trigrams.begin(), trigrams.end());
+  trigrams.erase(std::unique(trigrams.begin(), trigrams.end()),
+                 trigrams.end());
+}
+
+}  // namespace anime
@@ -0,0 +1,91 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace anime {
+
+class Item;
+
+enum class TextMatch {
+  Prefix,     // Matches the beginning of a word
+  Substring,  // Matches anywhere
+};
+
+// An inverted index over the titles, synonyms, genres and tags of list items,
+// so that the search bar doesn't have to go through every item's strings on
+// each keystroke. Each item's fields are lowercased and split into trigrams,
+// which map to sorted lists of anime IDs. A query intersects the lists of its
+// own trigrams, and only verifies the few candidates that remain.
+//
+// The index is built the first time it's needed. After that, changed items
+// are marked, and are indexed again before the next query.
+class TextIndex {
+public:
+  // Called whenever an item, or a queued value that overrides its list
+  // values, changes. Bulk changes should invalidate the index instead.
+  void UpdateItem(int anime_id);
+  void Invalidate();
+
+  // Brings the index up to date. Returns false if nothing has changed since
+  // the last call.
+  bool Refresh();
+
+  bool Contains(int anime_id) const;
+
+  // Finds items whose fields contain every word in text. Resulting IDs are
+  // sorted.
+  void Search(const std::wstring& text, TextMatch match,
+              std::vector<int>& anime_ids);
+
+  unsigned int version() const;
+
+private:
+  typedef uint64_t trigram_t;
+
+  void Build();
+  void AddItem(const Item& item);
+  void RemoveItem(int anime_id);
+
+  void SearchWord(const std::wstring& word, TextMatch match,
+                  std::vector<int>& anime_ids) const;
+  bool MatchDocument(const std::wstring& document, const std::wstring& word,
+                     TextMatch match) const;
+
+  static std::wstring GetDocument(const Item& item);
+  static void GetTrigrams(const std::wstring& document,
+                          std::vector<trigram_t>& trigrams);
+
+  // Lowercased fields of each item, separated by line breaks
+  std::unordered_map<int, std::wstring> documents_;
+  std::unordered_map<trigram_t, std::vector<int>> postings_;
+
+  std::unordered_set<int> changed_items_;
+  bool built_ = false;
+  unsigned int version_ = 0;
+};
+
+}  // namespace anime
+
+extern anime::TextIndex AnimeTextIndex;
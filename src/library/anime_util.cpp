@@ -26,6 +26,7 @@
 #include "library/anime.h"
 #include "library/anime_db.h"
 #include "library/anime_episode.h"
+#include "library/anime_text_index.h"
 #include "library/anime_util.h"
 #include "library/history.h"
 #include "sync/kitsu_util.h"
@@ -187,7 +188,7 @@ bool MetadataNeedsRefresh(const Item& item) {
 
   if (item.GetSynopsis().empty())
     return true;
-  if (item.GetGenres().empty())
+  if (item.GetGenreSymbols().empty())
     return true;
   if (item.GetScore() == kUnknownScore && IsAiredYet(item))
     return true;
@@ -201,18 +202,30 @@ bool IsNsfw(const Item& item) {
   if (item.GetAgeRating() == anime::kAgeRatingR18)
     return true;
 
-  if (item.GetAgeRating() == anime::kUnknownAgeRating) {
-    auto& genres = item.GetGenres();
-    if (std::find(genres.begin(), genres.end(), L"Hentai") != genres.end())
+  if (item.GetAgeRating() == anime::kUnknownAgeRating)
+    if (item.HasGenre(L"Hentai"))
       return true;
-  }
 
   return false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool PlayEpisode(int anime_id, int number) {
+static void PlayEpisodeFile(const Item& anime_item, int number,
+                            const std::wstring& file_path,
+                            const std::function<void()>& on_not_found) {
+  if (file_path.empty()) {
+    ui::ChangeStatusText(L"Could not find episode #" + ToWstr(number) +
+                         L" (" + anime_item.GetTitle() + L").");
+    if (on_not_found)
+      on_not_found();
+  } else {
+    Execute(file_path);
+  }
+}
+
+bool PlayEpisode(int anime_id, int number,
+                 std::function<void()> on_not_found) {
   auto anime_item = AnimeDatabase.FindItem(anime_id);
 
   if (!anime_item)
@@ -242,20 +255,24 @@ bool PlayEpisode(int anime_id, int number) {
 
   // Scan available episodes
   if (file_path.empty()) {
-    ScanAvailableEpisodes(false, anime_item->GetId(), number);
-    if (anime_item->IsEpisodeAvailable(number)) {
-      file_path = file_search_helper.path_found();
-    }
-  }
-
-  if (file_path.empty()) {
-    ui::ChangeStatusText(L"Could not find episode #" + ToWstr(number) +
-                         L" (" + anime_item->GetTitle() + L").");
-  } else {
-    Execute(file_path);
+    ScanAvailableEpisodes(false, anime_id, number,
+        [anime_id, number, on_not_found]() {
+          auto anime_item = AnimeDatabase.FindItem(anime_id);
+          if (!anime_item) {
+            if (on_not_found)
+              on_not_found();
+            return;
+          }
+          std::wstring file_path;
+          if (anime_item->IsEpisodeAvailable(number))
+            file_path = GetScannedEpisodePath();
+          PlayEpisodeFile(*anime_item, number, file_path, on_not_found);
+        });
+    return true;
   }
 
-  return !file_path.empty();
+  PlayEpisodeFile(*anime_item, number, file_path, on_not_found);
+  return true;
 }
 
 bool PlayLastEpisode(int anime_id) {
@@ -267,7 +284,7 @@ bool PlayLastEpisode(int anime_id) {
   return PlayEpisode(anime_id, anime_item->GetMyLastWatchedEpisode());
 }
 
-bool PlayNextEpisode(int anime_id) {
+bool PlayNextEpisode(int anime_id, std::function<void()> on_not_found) {
   auto anime_item = AnimeDatabase.FindItem(anime_id);
 
   if (!anime_item)
@@ -279,7 +296,7 @@ bool PlayNextEpisode(int anime_id) {
     if (number > anime_item->GetEpisodeCount())
       number = 1;  // Play the first episode of completed series
 
-  return PlayEpisode(anime_id, number);
+  return PlayEpisode(anime_id, number, on_not_found);
 }
 
 bool PlayNextEpisodeOfLastWatchedAnime() {
@@ -305,12 +322,44 @@ bool PlayNextEpisodeOfLastWatchedAnime() {
   return PlayNextEpisode(anime_id);
 }
 
+// Anime and episodes are tried in turn, as each try might have to wait for a
+// scan to find out that the episode isn't there
+static void PlayNextEpisodeOfAny(std::vector<int> anime_ids) {
+  while (!anime_ids.empty()) {
+    const int anime_id = anime_ids.back();
+    anime_ids.pop_back();
+    if (PlayNextEpisode(anime_id, [anime_ids]() {
+          PlayNextEpisodeOfAny(anime_ids);
+        }))
+      return;
+  }
+
+  ui::OnAnimeEpisodeNotFound();
+}
+
+static void PlayAnyEpisode(int anime_id, std::vector<int> numbers) {
+  while (!numbers.empty()) {
+    const int number = numbers.back();
+    numbers.pop_back();
+    if (PlayEpisode(anime_id, number, [anime_id, numbers]() {
+          PlayAnyEpisode(anime_id, numbers);
+        }))
+      return;
+  }
+
+  ui::OnAnimeEpisodeNotFound();
+}
+
 bool PlayRandomAnime() {
   static time_t time_last_checked = 0;
   time_t time_now = time(nullptr);
   if (time_now > time_last_checked + (60 * 2)) {  // 2 minutes
-    ScanAvailableEpisodesQuick();
     time_last_checked = time_now;
+    ScanAvailableEpisodesQuick(ID_UNKNOWN, []() {
+      time_last_checked = time(nullptr);
+      PlayRandomAnime();
+    });
+    return true;
   }
 
   std::vector<int> valid_ids;
@@ -334,15 +383,14 @@ bool PlayRandomAnime() {
 
   srand(static_cast<unsigned int>(GetTickCount()));
 
+  std::vector<int> anime_ids;
   for (const auto& unused : valid_ids) {
     size_t index = rand() % max_value;
-    int anime_id = valid_ids.at(index);
-    if (PlayNextEpisode(anime_id))
-      return true;
+    anime_ids.push_back(valid_ids.at(index));
   }
 
-  ui::OnAnimeEpisodeNotFound();
-  return false;
+  PlayNextEpisodeOfAny(anime_ids);
+  return !anime_ids.empty();
 }
 
 bool PlayRandomEpisode(int anime_id) {
@@ -357,14 +405,14 @@ bool PlayRandomEpisode(int anime_id) {
 
   srand(static_cast<unsigned int>(GetTickCount()));
 
+  std::vector<int> numbers;
   for (int i = 0; i < std::min(total, max_tries); i++) {
     int episode_number = rand() % total + 1;
-    if (PlayEpisode(anime_item->GetId(), episode_number))
-      return true;
+    numbers.push_back(episode_number);
   }
 
-  ui::OnAnimeEpisodeNotFound();
-  return false;
+  PlayAnyEpisode(anime_item->GetId(), numbers);
+  return !numbers.empty();
 }
 
 bool LinkEpisodeToAnime(Episode& episode, int anime_id) {
@@ -383,6 +431,7 @@ bool LinkEpisodeToAnime(Episode& episode, int anime_id) {
   synonyms.push_back(CurrentEpisode.anime_title());
   anime_item->SetUserSynonyms(synonyms);
   Meow.UpdateTitles(*anime_item);
+  AnimeTextIndex.UpdateItem(anime_id);
   Settings.Save();
 
   StartWatching(*anime_item, episode);
@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -45,9 +46,14 @@ bool MetadataNeedsRefresh(const Item& item);
 
 bool IsNsfw(const Item& item);
 
-bool PlayEpisode(int anime_id, int number);
+// Episodes whose path is unknown are played once a scan finds them. Returns
+// false if the episode can't be played; otherwise on_not_found is called if
+// the scan doesn't find it.
+bool PlayEpisode(int anime_id, int number,
+                 std::function<void()> on_not_found = nullptr);
 bool PlayLastEpisode(int anime_id);
-bool PlayNextEpisode(int anime_id);
+bool PlayNextEpisode(int anime_id,
+                     std::function<void()> on_not_found = nullptr);
 bool PlayNextEpisodeOfLastWatchedAnime();
 bool PlayRandomAnime();
 bool PlayRandomEpisode(int anime_id);
@@ -21,12 +21,15 @@
 #include "base/string.h"
 #include "base/xml.h"
 #include "library/anime_db.h"
+#include "library/anime_text_index.h"
 #include "library/anime_util.h"
 #include "library/history.h"
 #include "sync/sync.h"
 #include "taiga/announce.h"
 #include "taiga/path.h"
+#include "taiga/persistence.h"
 #include "taiga/settings.h"
+#include "taiga/stats.h"
 #include "taiga/taiga.h"
 #include "track/media.h"
 #include "track/search.h"
@@ -41,10 +44,45 @@ HistoryItem::HistoryItem()
       mode(0) {
 }
 
+static bool HasValue(const HistoryItem& item, QueueSearch search_mode) {
+  switch (search_mode) {
+    // Date
+    case QueueSearch::DateStart:
+      return item.date_start;
+    case QueueSearch::DateEnd:
+      return item.date_finish;
+    // Episode
+    case QueueSearch::Episode:
+      return item.episode;
+    // Notes
+    case QueueSearch::Notes:
+      return item.notes;
+    // Rewatched times
+    case QueueSearch::RewatchedTimes:
+      return item.rewatched_times;
+    // Rewatching
+    case QueueSearch::Rewatching:
+      return item.enable_rewatching;
+    // Score
+    case QueueSearch::Score:
+      return item.score;
+    // Status
+    case QueueSearch::Status:
+      return item.status;
+    // Tags
+    case QueueSearch::Tags:
+      return item.tags;
+    // Default
+    default:
+      return true;
+  }
+}
+
 HistoryQueue::HistoryQueue()
     : index(0),
       history(nullptr),
-      updating(false) {
+      updating(false),
+      indexed_count_(0) {
 }
 
 void HistoryQueue::Add(HistoryItem& item, bool save) {
@@ -100,6 +138,9 @@ void HistoryQueue::Add(HistoryItem& item, bool save) {
       break;
   }
 
+  if (indexed_count_ != items.size())
+    RebuildIndex();
+
   // Edit previous item with the same ID...
   bool add_new_item = true;
   if (!History.queue.updating) {
@@ -131,6 +172,7 @@ void HistoryQueue::Add(HistoryItem& item, bool save) {
           if (!add_new_item) {
             it->mode = taiga::kHttpServiceUpdateLibraryEntry;
             it->time = (std::wstring)GetDate() + L" " + GetTime();
+            IndexItem(std::distance(items.begin(), it.base()) - 1);
           }
           break;
         }
@@ -142,8 +184,13 @@ void HistoryQueue::Add(HistoryItem& item, bool save) {
     if (item.time.empty())
       item.time = (std::wstring)GetDate() + L" " + GetTime();
     items.push_back(item);
+    IndexItem(items.size() - 1);
+    indexed_count_ = items.size();
   }
 
+  Stats.UpdateItem(item.anime_id);
+  AnimeTextIndex.UpdateItem(item.anime_id);
+
   if (anime && save) {
     // Save
     history->Save();
@@ -213,6 +260,11 @@ void HistoryQueue::Clear(bool save) {
   items.clear();
   index = 0;
 
+  positions_.clear();
+  indexed_count_ = 0;
+  Stats.InvalidateLibrary();
+  AnimeTextIndex.Invalidate();
+
   ui::OnHistoryChange();
 
   if (save)
@@ -220,60 +272,28 @@ void HistoryQueue::Clear(bool save) {
 }
 
 HistoryItem* HistoryQueue::FindItem(int anime_id, QueueSearch search_mode) {
-  for (auto it = items.rbegin(); it != items.rend(); ++it) {
-    if (it->anime_id == anime_id && it->enabled) {
-      switch (search_mode) {
-        // Date
-        case QueueSearch::DateStart:
-          if (it->date_start)
-            return &(*it);
-          break;
-        case QueueSearch::DateEnd:
-          if (it->date_finish)
-            return &(*it);
-          break;
-        // Episode
-        case QueueSearch::Episode:
-          if (it->episode)
-            return &(*it);
-          break;
-        // Notes
-        case QueueSearch::Notes:
-          if (it->notes)
-            return &(*it);
-          break;
-        // Rewatched times
-        case QueueSearch::RewatchedTimes:
-          if (it->rewatched_times)
-            return &(*it);
-          break;
-        // Rewatching
-        case QueueSearch::Rewatching:
-          if (it->enable_rewatching)
-            return &(*it);
-          break;
-        // Score
-        case QueueSearch::Score:
-          if (it->score)
-            return &(*it);
-          break;
-        // Status
-        case QueueSearch::Status:
-          if (it->status)
-            return &(*it);
-          break;
-        // Tags
-        case QueueSearch::Tags:
-          if (it->tags)
-            return &(*it);
-          break;
-        // Default
-        default:
-          return &(*it);
-      }
-    }
+  if (indexed_count_ != items.size())
+    RebuildIndex();
+
+  auto find_item = [&]() -> HistoryItem* {
+    auto it = positions_.find(anime_id);
+    if (it == positions_.end())
+      return nullptr;
+    const int position = it->second[static_cast<size_t>(search_mode)];
+    return position > -1 ? &items[position] : nullptr;
+  };
+
+  auto history_item = find_item();
+
+  // The item might have been disabled in the meantime
+  if (history_item && (history_item->anime_id != anime_id ||
+                       !history_item->enabled ||
+                       !HasValue(*history_item, search_mode))) {
+    RebuildIndex();
+    history_item = find_item();
   }
-  return nullptr;
+
+  return history_item;
 }
 
 HistoryItem* HistoryQueue::GetCurrentItem() {
@@ -318,7 +338,12 @@ void HistoryQueue::Remove(int index, bool save, bool refresh, bool to_history) {
       }
     }
 
+    if (indexed_count_ != items.size())
+      RebuildIndex();
     items.erase(it);
+    UnindexItem(index, history_item.anime_id);
+    Stats.UpdateItem(history_item.anime_id);
+    AnimeTextIndex.UpdateItem(history_item.anime_id);
 
     if (refresh)
       ui::OnHistoryChange(&history_item);
@@ -339,6 +364,12 @@ void HistoryQueue::RemoveDisabled(bool save, bool refresh) {
     }
   }
 
+  if (needs_refresh) {
+    RebuildIndex();
+    Stats.InvalidateLibrary();
+    AnimeTextIndex.Invalidate();
+  }
+
   if (refresh && needs_refresh)
     ui::OnHistoryChange();
 
@@ -346,6 +377,49 @@ void HistoryQueue::RemoveDisabled(bool save, bool refresh) {
     history->Save();
 }
 
+void HistoryQueue::IndexItem(size_t position) {
+  const auto& item = items[position];
+  if (!item.enabled)
+    return;
+
+  auto result = positions_.try_emplace(item.anime_id);
+  auto& positions = result.first->second;
+  if (result.second)
+    positions.fill(-1);
+
+  // Items can be indexed out of order (e.g. when an earlier item is merged
+  // with a new one), and the last item with a value must be kept
+  for (size_t i = 0; i < kQueueSearchCount; ++i)
+    if (HasValue(item, static_cast<QueueSearch>(i)) &&
+        positions[i] < static_cast<int>(position))
+      positions[i] = static_cast<int>(position);
+}
+
+void HistoryQueue::UnindexItem(size_t position, int anime_id) {
+  // Items after the removed one are shifted back by one
+  for (auto& pair : positions_)
+    for (auto& value : pair.second)
+      if (value > static_cast<int>(position))
+        --value;
+
+  // Other items of the same anime might provide the removed values
+  positions_.erase(anime_id);
+  for (size_t i = 0; i < items.size(); ++i)
+    if (items[i].anime_id == anime_id)
+      IndexItem(i);
+
+  indexed_count_ = items.size();
+}
+
+void HistoryQueue::RebuildIndex() {
+  positions_.clear();
+
+  for (size_t i = 0; i < items.size(); ++i)
+    IndexItem(i);
+
+  indexed_count_ = items.size();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 History::History()
@@ -365,6 +439,11 @@ void History::Clear(bool save) {
 bool History::Load() {
   items.clear();
   queue.items.clear();
+  Stats.InvalidateLibrary();
+  AnimeTextIndex.Invalidate();
+
+  // A previous save might still be waiting to be written
+  Persistence.Flush();
 
   xml_document document;
   std::wstring path = taiga::GetPath(taiga::Path::UserHistory);
@@ -489,7 +568,8 @@ bool History::Save() {
     #undef APPEND_ATTRIBUTE_INT
   }
 
-  return XmlWriteDocumentToFile(document, path);
+  Persistence.Save(path, XmlWriteDocumentToString(document));
+  return true;
 }
 
 int History::TranslateModeFromString(const std::wstring& mode) {
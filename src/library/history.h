@@ -18,8 +18,10 @@
 
 #pragma once
 
+#include <array>
 #include <string>
 #include <queue>
+#include <unordered_map>
 #include <vector>
 
 #include "base/optional.h"
@@ -39,6 +41,8 @@ enum class QueueSearch {
   Tags,
 };
 
+constexpr size_t kQueueSearchCount = static_cast<size_t>(QueueSearch::Tags) + 1;
+
 class AnimeValues {
 public:
   Optional<int> episode;
@@ -84,6 +88,19 @@ public:
   std::vector<HistoryItem> items;
   History* history;
   bool updating;
+
+private:
+  // Position of the latest enabled item that has a value for each field, by
+  // anime ID. Values in the queue override the ones in the list, so FindItem
+  // is called for each item whenever the list is displayed. The index is
+  // rebuilt if the items are modified from outside.
+  typedef std::array<int, kQueueSearchCount> positions_t;
+  std::unordered_map<int, positions_t> positions_;
+  size_t indexed_count_;
+
+  void IndexItem(size_t position);
+  void UnindexItem(size_t position, int anime_id);
+  void RebuildIndex();
 };
 
 class History {
@@ -30,7 +30,11 @@ Title::Title(TitleType type, const string_t& value)
 
 Metadata::Metadata()
     : audience(0),
+      episode_count(-1),
+      episode_length(-1),
       modified(0),
+      popularity(0),
+      score(0.0),
       source(0),
       status(0),
       type(0) {
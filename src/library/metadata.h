@@ -20,6 +20,7 @@
 
 #include "base/time.h"
 #include "base/types.h"
+#include "library/symbol_table.h"
 
 namespace library {
 
@@ -55,13 +56,20 @@ struct Metadata {
   enum_t status;
   enum_t audience;
 
-  std::vector<unsigned short> extent;
-  std::vector<Date> date;
+  // Fields that every item has at most one of are stored inline, so that
+  // reading them doesn't involve another allocation
+  int episode_count;
+  int episode_length;
+  Date date_start;
+  Date date_end;
 
-  std::vector<string_t> subject;
-  std::vector<string_t> creator;
-  std::vector<string_t> resource;
-  std::vector<string_t> community;
+  // Interned in the global symbol table
+  symbols_t subject;
+  symbols_t creator;
+  string_t image_url;
+  string_t slug;
+  double score;
+  int popularity;
 
   string_t description;
 };
@@ -24,6 +24,7 @@
 #include "library/resource.h"
 #include "sync/sync.h"
 #include "taiga/path.h"
+#include "taiga/stats.h"
 #include "ui/dlg/dlg_anime_info.h"
 #include "ui/dlg/dlg_season.h"
 
@@ -111,6 +112,7 @@ void ImageDatabase::Clear() {
 
   std::wstring path = taiga::GetPath(taiga::Path::DatabaseImage);
   DeleteFolder(path);
+  Stats.InvalidateLocalData();
 }
 
 base::Image* ImageDatabase::GetImage(int anime_id) {
@@ -0,0 +1,125 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "base/string.h"
+#include "library/symbol_table.h"
+
+library::SymbolTable Symbols;
+
+namespace library {
+
+bool SymbolSet::empty() const {
+  return count_ == 0;
+}
+
+void SymbolSet::clear() {
+  bits_.clear();
+  count_ = 0;
+}
+
+void SymbolSet::insert(symbol_t symbol) {
+  const size_t index = symbol / 64;
+  if (index >= bits_.size())
+    bits_.resize(index + 1);
+
+  const uint64_t mask = uint64_t{1} << (symbol % 64);
+  if (!(bits_[index] & mask)) {
+    bits_[index] |= mask;
+    ++count_;
+  }
+}
+
+bool SymbolSet::contains(symbol_t symbol) const {
+  const size_t index = symbol / 64;
+  if (index >= bits_.size())
+    return false;
+
+  return (bits_[index] & (uint64_t{1} << (symbol % 64))) != 0;
+}
+
+bool SymbolSet::contains_any(const symbols_t& symbols) const {
+  if (empty())
+    return false;
+
+  return std::any_of(symbols.begin(), symbols.end(),
+                     [this](symbol_t symbol) { return contains(symbol); });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+symbol_t SymbolTable::Intern(const string_t& str) {
+  auto it = symbols_.find(str);
+  if (it != symbols_.end())
+    return it->second;
+
+  const auto symbol = static_cast<symbol_t>(strings_.size());
+  strings_.push_back(str);
+  symbols_.emplace(strings_.back(), symbol);
+
+  return symbol;
+}
+
+symbols_t SymbolTable::Intern(const std::vector<string_t>& strings) {
+  symbols_t symbols;
+  symbols.reserve(strings.size());
+
+  for (const auto& str : strings)
+    symbols.push_back(Intern(str));
+
+  return symbols;
+}
+
+bool SymbolTable::Find(const string_t& str, symbol_t& symbol) const {
+  auto it = symbols_.find(str);
+  if (it == symbols_.end())
+    return false;
+
+  symbol = it->second;
+  return true;
+}
+
+const string_t& SymbolTable::GetString(symbol_t symbol) const {
+  if (symbol < strings_.size())
+    return strings_[symbol];
+
+  return EmptyString();
+}
+
+std::vector<string_t> SymbolTable::GetStrings(const symbols_t& symbols) const {
+  std::vector<string_t> strings;
+  strings.reserve(symbols.size());
+
+  for (const auto symbol : symbols)
+    strings.push_back(GetString(symbol));
+
+  return strings;
+}
+
+void SymbolTable::Search(const string_t& text, SymbolSet& symbols) const {
+  for (size_t i = 0; i < strings_.size(); ++i)
+    if (InStr(strings_[i], text, 0, true) > -1)
+      symbols.insert(static_cast<symbol_t>(i));
+}
+
+size_t SymbolTable::size() const {
+  return strings_.size();
+}
+
+}  // namespace library
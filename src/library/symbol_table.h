@@ -0,0 +1,79 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "base/types.h"
+
+namespace library {
+
+typedef uint32_t symbol_t;
+typedef std::vector<symbol_t> symbols_t;
+
+// A set of symbols, stored as a bitmap so that checking an item against it
+// costs one lookup per symbol of the item
+class SymbolSet {
+public:
+  bool empty() const;
+  void clear();
+  void insert(symbol_t symbol);
+
+  bool contains(symbol_t symbol) const;
+  bool contains_any(const symbols_t& symbols) const;
+
+private:
+  std::vector<uint64_t> bits_;
+  size_t count_ = 0;
+};
+
+// Strings that are repeated across many items (e.g. genres and producers) are
+// stored only once, and items refer to them by symbol. Symbols are never
+// removed, so they remain valid for the lifetime of the application.
+//
+// The table is not synchronized. Like the rest of the database, it is meant to
+// be modified from the main thread only.
+class SymbolTable {
+public:
+  symbol_t Intern(const string_t& str);
+  symbols_t Intern(const std::vector<string_t>& strings);
+  bool Find(const string_t& str, symbol_t& symbol) const;
+
+  const string_t& GetString(symbol_t symbol) const;
+  std::vector<string_t> GetStrings(const symbols_t& symbols) const;
+
+  // Symbols of every string that contains the given text, case-insensitive
+  void Search(const string_t& text, SymbolSet& symbols) const;
+
+  size_t size() const;
+
+private:
+  // Strings are kept in a deque, so that the views in the lookup table are not
+  // invalidated when new strings are added
+  std::deque<string_t> strings_;
+  std::unordered_map<std::wstring_view, symbol_t> symbols_;
+};
+
+}  // namespace library
+
+extern library::SymbolTable Symbols;
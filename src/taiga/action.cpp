@@ -44,6 +44,37 @@
 #include "ui/menu.h"
 #include "ui/ui.h"
 
+// Asks for the folder if it's still unknown after scanning
+static void OpenAnimeFolder(int anime_id) {
+  auto anime_item = AnimeDatabase.FindItem(anime_id);
+  if (!anime_item)
+    return;
+  if (anime_item->GetFolder().empty()) {
+    if (ui::OnAnimeFolderNotFound()) {
+      std::wstring default_path, path;
+      if (!Settings.library_folders.empty())
+        default_path = Settings.library_folders.front();
+      if (win::BrowseForFolder(ui::GetWindowHandle(ui::Dialog::Main),
+                               L"Select Anime Folder",
+                               default_path, path)) {
+        anime_item->SetFolder(path);
+        Settings.Save();
+      }
+    }
+  }
+  ui::ClearStatusText();
+  const auto next_episode_path = anime_item->GetNextEpisodePath();
+  const auto anime_folder = anime_item->GetFolder();
+  if (!next_episode_path.empty()) {
+    if (anime_folder.empty() || StartsWith(next_episode_path, anime_folder))
+      if (OpenFolderAndSelectFile(next_episode_path))
+        return;
+  }
+  if (!anime_folder.empty()) {
+    Execute(anime_folder);
+  }
+}
+
 void ExecuteAction(std::wstring action, WPARAM wParam, LPARAM lParam) {
   LOGD(action);
 
@@ -468,31 +499,11 @@ void ExecuteAction(std::wstring action, WPARAM wParam, LPARAM lParam) {
     auto anime_item = AnimeDatabase.FindItem(anime_id);
     if (!anime_item || !anime_item->IsInList())
       return;
-    if (!anime::ValidateFolder(*anime_item))
-      ScanAvailableEpisodes(false, anime_item->GetId(), 0);
-    if (anime_item->GetFolder().empty()) {
-      if (ui::OnAnimeFolderNotFound()) {
-        std::wstring default_path, path;
-        if (!Settings.library_folders.empty())
-          default_path = Settings.library_folders.front();
-        if (win::BrowseForFolder(ui::GetWindowHandle(ui::Dialog::Main),
-                                 L"Select Anime Folder",
-                                 default_path, path)) {
-          anime_item->SetFolder(path);
-          Settings.Save();
-        }
-      }
-    }
-    ui::ClearStatusText();
-    const auto next_episode_path = anime_item->GetNextEpisodePath();
-    const auto anime_folder = anime_item->GetFolder();
-    if (!next_episode_path.empty()) {
-      if (anime_folder.empty() || StartsWith(next_episode_path, anime_folder))
-        if (OpenFolderAndSelectFile(next_episode_path))
-          return;
-    }
-    if (!anime_folder.empty()) {
-      Execute(anime_folder);
+    if (anime::ValidateFolder(*anime_item)) {
+      OpenAnimeFolder(anime_id);
+    } else {
+      ScanAvailableEpisodes(false, anime_id, 0,
+                            [anime_id]() { OpenAnimeFolder(anime_id); });
     }
 
   //////////////////////////////////////////////////////////////////////////////
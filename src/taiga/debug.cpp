@@ -32,7 +32,7 @@ void Tester::Start() {
   t0_ = clock_t::now();
 }
 
-void Tester::Stop(std::wstring str, bool display_result) {
+float Tester::Stop(std::wstring str, bool display_result) {
   using duration_t =
       std::chrono::duration<float, std::chrono::milliseconds::period>;
 
@@ -44,6 +44,8 @@ void Tester::Stop(std::wstring str, bool display_result) {
     str = ToWstr(duration.count(), 2) + L"ms | Text: [" + str + L"]";
     ui::DlgMain.SetText(str);
   }
+
+  return duration.count();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -57,24 +59,17 @@ void Print(std::wstring text) {
 }
 
 void Test() {
-  // Define variables
-  std::wstring str;
-
-  // Start ticking
-  Tester test;
-  test.Start();
-
-  for (int i = 0; i < 10000; i++) {
-    // Do some tests here
-    //       ___
-    //      {o,o}
-    //      |)__)
-    //     --"-"--
-    //      O RLY?
-  }
-
-  // Show result
-  test.Stop(str, true);
+  // Benchmarks compare the current implementations with the ones they
+  // replaced, and report the results to the debug log
+  BenchmarkTrigrams();
+  BenchmarkEditDistance();
+  BenchmarkNormalization();
+  BenchmarkRecognitionCache();
+  BenchmarkRelations();
+  BenchmarkRelationsParser();
+  BenchmarkDatabaseImport();
+  BenchmarkDatabaseScan();
+  BenchmarkListSort();
 }
 
 } // namespace debug
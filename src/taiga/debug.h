@@ -30,7 +30,7 @@ public:
   Tester();
 
   void Start();
-  void Stop(std::wstring str, bool display_result);
+  float Stop(std::wstring str, bool display_result);
 
 private:
   clock_t::time_point t0_;
@@ -39,4 +39,14 @@ private:
 void Print(std::wstring text);
 void Test();
 
+void BenchmarkDatabaseImport();
+void BenchmarkDatabaseScan();
+void BenchmarkEditDistance();
+void BenchmarkListSort();
+void BenchmarkNormalization();
+void BenchmarkRecognitionCache();
+void BenchmarkRelations();
+void BenchmarkRelationsParser();
+void BenchmarkTrigrams();
+
 }  // namespace debug
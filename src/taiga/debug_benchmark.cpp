@@ -0,0 +1,1067 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <regex>
+
+#include <windows.h>
+#include <psapi.h>
+
+#include <utf8proc/utf8proc.h>
+
+#include "base/file.h"
+#include "base/log.h"
+#include "base/string.h"
+#include "library/anime_db.h"
+#include "library/anime_episode.h"
+#include "library/anime_util.h"
+#include "library/anime_item_store.h"
+#include "sync/service.h"
+#include "taiga/debug.h"
+#include "taiga/path.h"
+#include "taiga/settings.h"
+#include "track/feed.h"
+#include "track/recognition.h"
+#include "track/recognition_relations.h"
+#include "ui/dlg/dlg_main.h"
+#include "ui/list.h"
+
+namespace debug {
+
+// Benchmarks are run manually (e.g. from Test()) against the current database,
+// and results are written to the debug log and the main window's status text.
+
+static std::vector<std::wstring> GetBenchmarkTitles(size_t max_count) {
+  std::vector<std::wstring> titles;
+
+  for (const auto& it : AnimeDatabase.items) {
+    if (titles.size() >= max_count)
+      break;
+    titles.push_back(ToLower_Copy(it.second.GetTitle()));
+  }
+
+  return titles;
+}
+
+static void ReportBenchmark(const std::wstring& name,
+                            const std::vector<std::pair<std::wstring, float>>& results) {
+  std::wstring text = name + L" |";
+  for (const auto& result : results)
+    text += L" " + result.first + L": " + ToWstr(result.second, 2) + L"ms";
+
+  LOGD(text);
+  ui::DlgMain.SetText(text);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace legacy {
+
+// Previous implementation, kept for comparison
+typedef std::array<wchar_t, 3> trigram_t;
+typedef std::vector<trigram_t> trigram_container_t;
+
+static void GetTrigrams(const std::wstring& str, trigram_container_t& output) {
+  const size_t n = 3;
+
+  output.clear();
+
+  if (n >= str.size()) {
+    trigram_t buffer = {'\0'};
+    std::copy(str.begin(), str.end(), buffer.begin());
+    output.push_back(buffer);
+    return;
+  }
+
+  for (size_t i = 0; i <= str.size() - n; ++i) {
+    trigram_t buffer = {'\0'};
+    std::copy(str.begin() + i, str.begin() + (i + n), buffer.begin());
+    output.push_back(buffer);
+  }
+
+  std::sort(output.begin(), output.end());
+}
+
+static double CompareTrigrams(const trigram_container_t& t1,
+                              const trigram_container_t& t2) {
+  trigram_container_t intersection;
+
+  std::set_intersection(t1.begin(), t1.end(), t2.begin(), t2.end(),
+                        std::back_inserter(intersection));
+
+  return static_cast<double>(intersection.size()) /
+         static_cast<double>(std::max(t1.size(), t2.size()));
+}
+
+static size_t LongestCommonSubsequenceLength(const std::wstring& str1,
+                                             const std::wstring& str2) {
+  if (str1.empty() || str2.empty())
+    return 0;
+
+  const size_t len1 = str1.length();
+  const size_t len2 = str2.length();
+
+  std::vector<std::vector<size_t>> table(len1 + 1);
+  for (auto it = table.begin(); it != table.end(); ++it)
+    it->resize(len2 + 1);
+
+  for (size_t i = 0; i < len1; i++) {
+    for (size_t j = 0; j < len2; j++) {
+      if (str1[i] == str2[j]) {
+        table[i + 1][j + 1] = table[i][j] + 1;
+      } else {
+        table[i + 1][j + 1] = std::max(table[i + 1][j], table[i][j + 1]);
+      }
+    }
+  }
+
+  return table.back().back();
+}
+
+static double LevenshteinDistance(const std::wstring& str1,
+                                  const std::wstring& str2) {
+  const size_t len1 = str1.size();
+  const size_t len2 = str2.size();
+
+  std::vector<size_t> prev_col(len2 + 1);
+  for (size_t i = 0; i < prev_col.size(); i++)
+    prev_col[i] = i;
+
+  std::vector<size_t> col(len2 + 1);
+
+  for (size_t i = 0; i < len1; i++) {
+    col[0] = i + 1;
+
+    for (size_t j = 0; j < len2; j++)
+      col[j + 1] = std::min(std::min(1 + col[j], 1 + prev_col[1 + j]),
+                            prev_col[j] + (str1[i] == str2[j] ? 0 : 1));
+
+    col.swap(prev_col);
+  }
+
+  const double len = static_cast<double>(std::max(str1.size(), str2.size()));
+  return 1.0 - (prev_col[len2] / len);
+}
+
+static void ConvertOrdinalNumbers(std::wstring& str) {
+  static const std::vector<std::pair<std::wstring, std::wstring>> ordinals{
+    {L"1st", L"first"}, {L"2nd", L"second"}, {L"3rd", L"third"},
+    {L"4th", L"fourth"}, {L"5th", L"fifth"}, {L"6th", L"sixth"},
+    {L"7th", L"seventh"}, {L"8th", L"eighth"}, {L"9th", L"ninth"},
+  };
+
+  for (const auto& ordinal : ordinals)
+    ReplaceString(str, 0, ordinal.second, ordinal.first, true, true);
+}
+
+static void ConvertRomanNumbers(std::wstring& str) {
+  static const std::vector<std::pair<std::wstring, std::wstring>> numerals{
+    {L"2", L"II"}, {L"3", L"III"}, {L"4", L"IV"}, {L"5", L"V"},
+    {L"6", L"VI"}, {L"7", L"VII"}, {L"8", L"VIII"}, {L"9", L"IX"},
+    {L"11", L"XI"}, {L"12", L"XII"}, {L"13", L"XIII"},
+  };
+
+  for (const auto& numeral : numerals)
+    ReplaceString(str, 0, numeral.second, numeral.first, true, true);
+}
+
+static void ConvertSeasonNumbers(std::wstring& str) {
+  typedef std::vector<std::wstring> season_t;
+  static const std::vector<std::pair<std::wstring, season_t>> values{
+    {L"1", {L"1st season", L"season 1", L"series 1", L"s1"}},
+    {L"2", {L"2nd season", L"season 2", L"series 2", L"s2"}},
+    {L"3", {L"3rd season", L"season 3", L"series 3", L"s3"}},
+    {L"4", {L"4th season", L"season 4", L"series 4", L"s4"}},
+    {L"5", {L"5th season", L"season 5", L"series 5", L"s5"}},
+    {L"6", {L"6th season", L"season 6", L"series 6", L"s6"}},
+  };
+
+  for (const auto& value : values)
+    for (const auto& season : value.second)
+      ReplaceString(str, 0, season, value.first, true, true);
+}
+
+static void Transliterate(std::wstring& str) {
+  for (size_t i = 0; i < str.size(); ++i) {
+    auto& c = str[i];
+    switch (c) {
+      case L'@': c = L'a'; break;
+      case L'\u00D7': c = L'x'; break;
+      case L'\uA789': c = L':'; break;
+      case L'\u014C': str.replace(i, 1, L"ou"); break;
+      case L'\u014D': str.replace(i, 1, L"ou"); break;
+      case L'\u016B': str.replace(i, 1, L"uu"); break;
+    }
+  }
+
+  ReplaceString(str, 0, L"wa", L"ha", true, true);
+  ReplaceString(str, 0, L"e", L"he", true, true);
+  ReplaceString(str, 0, L"o", L"wo", true, true);
+}
+
+static void NormalizeUnicode(std::wstring& str) {
+  static const int options =
+      UTF8PROC_COMPAT | UTF8PROC_COMPOSE | UTF8PROC_STABLE |
+      UTF8PROC_IGNORE | UTF8PROC_STRIPCC | UTF8PROC_STRIPMARK |
+      UTF8PROC_LUMP | UTF8PROC_CASEFOLD;
+
+  char* buffer = nullptr;
+  std::string temp = WstrToStr(str);
+
+  int length = utf8proc_map(
+      reinterpret_cast<const utf8proc_uint8_t*>(temp.data()), temp.length(),
+      reinterpret_cast<utf8proc_uint8_t**>(&buffer),
+      static_cast<utf8proc_option_t>(options));
+
+  if (length >= 0) {
+    temp.assign(buffer, length);
+    str = StrToWstr(temp);
+  }
+
+  if (buffer)
+    free(buffer);
+}
+
+static void EraseUnnecessary(std::wstring& str) {
+  ReplaceString(str, 0, L"&", L"and", true, true);
+  ReplaceString(str, 0, L"the animation", L"", true, true);
+  ReplaceString(str, 0, L"the", L"", true, true);
+  ReplaceString(str, 0, L"episode", L"", true, true);
+  ReplaceString(str, 0, L"oad", L"ova", true, true);
+  ReplaceString(str, 0, L"oav", L"ova", true, true);
+  ReplaceString(str, 0, L"specials", L"sp", true, true);
+  ReplaceString(str, 0, L"special", L"sp", true, true);
+  ReplaceString(str, 0, L"(tv)", L"", true, true);
+}
+
+// Same as Engine::NormalizeTitle
+static void NormalizeTitle(std::wstring& title) {
+  ConvertRomanNumbers(title);
+  Transliterate(title);
+  NormalizeUnicode(title);
+  ConvertOrdinalNumbers(title);
+  ConvertSeasonNumbers(title);
+  EraseUnnecessary(title);
+  Trim(title);
+
+  while (ReplaceString(title, 0, L"  ", L" ", false, true));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+class Relation {
+public:
+  void AddRange(int id, std::pair<int, int> r1, std::pair<int, int> r2) {
+    ranges_.push_back({id, r1, r2});
+  }
+
+  bool FindRange(int episode_number, std::pair<int, int>& result) const {
+    for (const auto& it : ranges_) {
+      int distance = episode_number - it.r0.first;
+      if (distance >= 0 && it.r0.second - episode_number >= 0) {
+        int destination = it.r1.first;
+        if (it.r1.first != it.r1.second)
+          destination += distance;
+        if (destination <= it.r1.second) {
+          result = {it.id, destination};
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  int GetLastEpisode() const {
+    int last_episode = 0;
+    for (const auto& it : ranges_)
+      if (it.r0.second != INT_MAX)
+        last_episode = std::max(last_episode, it.r0.second);
+      else
+        last_episode = std::max(last_episode, it.r0.first);
+    return last_episode;
+  }
+
+private:
+  struct Range {
+    int id;
+    std::pair<int, int> r0;
+    std::pair<int, int> r1;
+  };
+  std::vector<Range> ranges_;
+};
+
+static bool ParseRule(const std::wstring& rule, std::map<int, Relation>& relations) {
+  static std::wstring id_pattern = L"(\\d+|[?~])";
+  static std::wstring episode_pattern = L"(\\d+)(?:-(\\d+|\\?))?";
+  static const std::wregex pattern(
+      id_pattern + L"\\|" + id_pattern + L":" + episode_pattern + L" -> " +
+      id_pattern + L"\\|" + id_pattern + L":" + episode_pattern + L"(!)?");
+
+  std::match_results<std::wstring::const_iterator> match_results;
+  if (!std::regex_match(rule, match_results, pattern))
+    return false;
+
+  auto get_id = [&](size_t first, size_t second) {
+    switch (taiga::GetCurrentServiceId()) {
+      case sync::kMyAnimeList: return ToInt(match_results[first].str());
+      case sync::kKitsu: return ToInt(match_results[second].str());
+      default: return 0;
+    }
+  };
+  auto get_range = [&](size_t first, size_t second) {
+    std::pair<int, int> range;
+    range.first = ToInt(match_results[first].str());
+    if (match_results[second].matched) {
+      range.second = IsNumericString(match_results[second].str()) ?
+          ToInt(match_results[second].str()) : INT_MAX;
+    } else {
+      range.second = range.first;
+    }
+    return range;
+  };
+
+  int id0 = get_id(1, 2);
+  if (!id0)
+    return false;
+  auto r0 = get_range(3, 4);
+  int id1 = get_id(5, 6);
+  if (!id1)
+    id1 = id0;
+  auto r1 = get_range(7, 8);
+
+  relations[id0].AddRange(id1, r0, r1);
+  if (match_results[9].matched)
+    relations[id1].AddRange(id1, r0, r1);
+
+  return true;
+}
+
+static bool SearchEpisodeRedirection(const std::map<int, Relation>& relations,
+                                     int id, const std::pair<int, int>& range,
+                                     int& destination_id,
+                                     std::pair<int, int>& destination_range) {
+  auto it = relations.find(id);
+
+  if (it == relations.end())
+    return false;
+
+  const auto& relation = it->second;
+
+  std::pair<std::pair<int, int>, std::pair<int, int>> results;
+
+  if (!relation.FindRange(range.first, results.first))
+    return false;
+
+  if (range.first != range.second) {
+    if (!relation.FindRange(range.second, results.second))
+      return false;
+    if (results.first.first != results.second.first)
+      return false;
+  }
+
+  destination_id = results.first.first;
+  destination_range.first = results.first.second;
+  destination_range.second = results.second.second;
+
+  return true;
+}
+
+static void ReadRelations(const std::string& document,
+                          std::map<int, Relation>& relations) {
+  std::vector<std::wstring> lines;
+  Split(StrToWstr(document), L"\n", lines);
+
+  bool rules_section = false;
+  for (auto& line : lines) {
+    Trim(line, L"\r ");
+    if (line.empty() || line.front() == L'#')
+      continue;
+    if (StartsWith(line, L"::")) {
+      rules_section = line.substr(2) == L"rules";
+      continue;
+    }
+    if (rules_section) {
+      TrimLeft(line, L"- ");
+      ParseRule(line, relations);
+    }
+  }
+}
+
+}  // namespace legacy
+
+void BenchmarkEditDistance() {
+  auto titles = GetBenchmarkTitles(500);
+
+  // Make sure that multi-block patterns are covered as well
+  for (size_t i = 0; i + 1 < titles.size() && i < 50; i += 2)
+    titles.push_back(titles[i] + L" " + titles[i + 1] + L" " + titles[i]);
+
+  Tester test;
+  size_t mismatch_count = 0;
+
+  for (const auto& str1 : titles) {
+    for (const auto& str2 : titles) {
+      if (legacy::LongestCommonSubsequenceLength(str1, str2) !=
+              LongestCommonSubsequenceLength(str1, str2) ||
+          legacy::LevenshteinDistance(str1, str2) !=
+              LevenshteinDistance(str1, str2)) {
+        LOGW(L"Edit distance mismatch: " + str1 + L" | " + str2);
+        ++mismatch_count;
+      }
+    }
+  }
+
+  size_t legacy_lcs_sum = 0;
+  size_t lcs_sum = 0;
+  double legacy_levenshtein_sum = 0.0;
+  double levenshtein_sum = 0.0;
+
+  test.Start();
+  for (const auto& str1 : titles)
+    for (const auto& str2 : titles)
+      legacy_lcs_sum += legacy::LongestCommonSubsequenceLength(str1, str2);
+  const auto legacy_lcs_duration = test.Stop(L"", false);
+
+  test.Start();
+  for (const auto& str1 : titles)
+    for (const auto& str2 : titles)
+      lcs_sum += LongestCommonSubsequenceLength(str1, str2);
+  const auto lcs_duration = test.Stop(L"", false);
+
+  test.Start();
+  for (const auto& str1 : titles)
+    for (const auto& str2 : titles)
+      legacy_levenshtein_sum += legacy::LevenshteinDistance(str1, str2);
+  const auto legacy_levenshtein_duration = test.Stop(L"", false);
+
+  test.Start();
+  for (const auto& str1 : titles)
+    for (const auto& str2 : titles)
+      levenshtein_sum += LevenshteinDistance(str1, str2);
+  const auto levenshtein_duration = test.Stop(L"", false);
+
+  if (legacy_lcs_sum != lcs_sum || legacy_levenshtein_sum != levenshtein_sum)
+    ++mismatch_count;
+
+  ReportBenchmark(L"Edit distance (" + ToWstr(titles.size()) + L"^2, " +
+                      ToWstr(mismatch_count) + L" mismatches)",
+                  {{L"legacy LCS", legacy_lcs_duration},
+                   {L"LCS", lcs_duration},
+                   {L"legacy Levenshtein", legacy_levenshtein_duration},
+                   {L"Levenshtein", levenshtein_duration}});
+}
+
+void BenchmarkNormalization() {
+  // Every title in the database, along with a few that are known to be
+  // affected by the order in which the rules are applied
+  std::vector<std::wstring> titles{
+    L"Monogatari Series: Second Season",
+    L"Fate/Zero 2nd Season",
+    L"Hunter x Hunter (TV)&",
+    L"Ore no Imouto ga Konna ni Kawaii Wake ga Nai. Season 2",
+    L"The iDOLM@STER Cinderella Girls",
+    L"Tasogare Otome \u00D7 Amnesia",
+    L"Nisekoi\uA789",
+    L"Sh\u014Dwa Genroku Rakugo Shinj\u016B",
+    L"Mobile Suit Gundam Wing: Endless Waltz Special",
+    L"Sword Art Online II",
+    L"Kara no Kyoukai 7: Satsujin Kousatsu (Kou)",
+    L"Pok\u00E9mon\tthe Movie\r\n\u00C9pisode\x7F II",
+    L"\uFF2B\uFF0D\uFF2F\uFF2E\uFF01\uFF01 \u2160\u2161",
+    L"2nd season first season\t",
+  };
+  for (const auto& it : AnimeDatabase.items) {
+    const auto& item = it.second;
+    titles.push_back(item.GetTitle());
+    titles.push_back(item.GetEnglishTitle());
+    titles.push_back(item.GetJapaneseTitle());
+    for (const auto& synonym : item.GetSynonyms())
+      titles.push_back(synonym);
+    for (const auto& synonym : item.GetUserSynonyms())
+      titles.push_back(synonym);
+  }
+  titles.erase(std::remove(titles.begin(), titles.end(), std::wstring()),
+               titles.end());
+
+  size_t mismatch_count = 0;
+  for (const auto& title : titles) {
+    auto legacy_title = title;
+    auto normal_title = title;
+    legacy::NormalizeTitle(legacy_title);
+    Meow.NormalizeTitle(normal_title);
+    if (legacy_title != normal_title) {
+      LOGE(L"Normalization mismatch: " + title + L" | " + legacy_title +
+           L" | " + normal_title);
+      ++mismatch_count;
+    }
+  }
+
+  Tester test;
+  const int repeat_count = 10;
+
+  test.Start();
+  for (int i = 0; i < repeat_count; ++i) {
+    for (const auto& title : titles) {
+      auto normal_title = title;
+      legacy::NormalizeTitle(normal_title);
+    }
+  }
+  const auto legacy_duration = test.Stop(L"", false);
+
+  test.Start();
+  for (int i = 0; i < repeat_count; ++i) {
+    for (const auto& title : titles) {
+      auto normal_title = title;
+      Meow.NormalizeTitle(normal_title);
+    }
+  }
+  const auto duration = test.Stop(L"", false);
+
+  ReportBenchmark(L"Normalize (" + ToWstr(titles.size()) + L"x" +
+                      ToWstr(repeat_count) + L", " +
+                      ToWstr(mismatch_count) + L" mismatches)",
+                  {{L"legacy", legacy_duration}, {L"single pass", duration}});
+}
+
+void BenchmarkRecognitionCache() {
+  std::vector<std::wstring> filenames;
+  for (const auto& title : GetBenchmarkTitles(1000))
+    filenames.push_back(L"[Group] " + title + L" - 02 [720p].mkv");
+
+  track::recognition::ParseOptions parse_options;
+  track::recognition::MatchOptions match_options;
+  match_options.allow_sequels = true;
+  match_options.check_airing_date = true;
+  match_options.check_anime_type = true;
+  match_options.check_episode_number = true;
+
+  const size_t repeat_count = 5;
+  std::vector<int> ids(filenames.size());
+  size_t mismatch_count = 0;
+
+  Meow.InvalidateCache();
+  const auto stats_before = Meow.GetCacheStats();
+
+  Tester test;
+
+  test.Start();
+  for (size_t i = 0; i < repeat_count; ++i) {
+    for (size_t j = 0; j < filenames.size(); ++j) {
+      anime::Episode episode;
+      if (Meow.Parse(filenames[j], parse_options, episode))
+        Meow.Identify(episode, false, match_options);
+      ids[j] = episode.anime_id;
+    }
+  }
+  const auto uncached_duration = test.Stop(L"", false);
+
+  test.Start();
+  for (size_t i = 0; i < repeat_count; ++i) {
+    for (size_t j = 0; j < filenames.size(); ++j) {
+      anime::Episode episode;
+      Meow.ParseAndIdentify(filenames[j], parse_options, match_options,
+                            episode);
+      if (episode.anime_id != ids[j])
+        ++mismatch_count;
+    }
+  }
+  const auto cached_duration = test.Stop(L"", false);
+
+  const auto stats = Meow.GetCacheStats();
+
+  ReportBenchmark(L"Recognition (" + ToWstr(filenames.size()) + L"x" +
+                      ToWstr(repeat_count) + L", " +
+                      ToWstr(stats.hits - stats_before.hits) + L" hits, " +
+                      ToWstr(stats.misses - stats_before.misses) + L" misses, " +
+                      ToWstr(mismatch_count) + L" mismatches)",
+                  {{L"uncached", uncached_duration}, {L"cached", cached_duration}});
+}
+
+void BenchmarkRelations() {
+  // Relations are compared with the ones that the engine read from the same
+  // file
+  std::string document;
+  if (!ReadFromFile(taiga::GetPath(taiga::Path::DatabaseAnimeRelations),
+                    document)) {
+    LOGW(L"Could not read anime relations data.");
+    return;
+  }
+  std::map<int, legacy::Relation> legacy_relations;
+  legacy::ReadRelations(document, legacy_relations);
+  Meow.InitializeTitles();
+
+  // Every episode of every source, either on its own or up to the last one,
+  // is redirected the same way by both
+  size_t lookup_count = 0;
+  size_t mismatch_count = 0;
+  for (const auto& it : legacy_relations) {
+    const int last_episode = it.second.GetLastEpisode() + 1;
+    for (int episode = 0; episode <= last_episode; ++episode) {
+      for (const auto& range : {std::make_pair(episode, episode),
+                                std::make_pair(episode, last_episode)}) {
+        int legacy_destination_id = anime::ID_UNKNOWN;
+        int destination_id = anime::ID_UNKNOWN;
+        std::pair<int, int> legacy_destination_range;
+        std::pair<int, int> destination_range;
+        const bool legacy_found = legacy::SearchEpisodeRedirection(
+            legacy_relations, it.first, range, legacy_destination_id,
+            legacy_destination_range);
+        const bool found = Meow.SearchEpisodeRedirection(
+            it.first, range, destination_id, destination_range);
+        if (legacy_found != found ||
+            (found && (legacy_destination_id != destination_id ||
+                       legacy_destination_range != destination_range))) {
+          LOGE(L"Redirection mismatch: " + ToWstr(it.first) + L":" +
+               anime::GetEpisodeRange(range));
+          ++mismatch_count;
+        }
+        ++lookup_count;
+      }
+    }
+  }
+
+  // Current torrent feed, along with sequel episodes that are likely to be
+  // redirected
+  std::vector<std::wstring> titles;
+  auto feed = Aggregator.GetFeed(FeedCategory::Link);
+  if (feed)
+    for (const auto& feed_item : feed->items)
+      titles.push_back(feed_item.title);
+  for (const auto& title : GetBenchmarkTitles(1000))
+    titles.push_back(L"[Group] " + title + L" - 14 [720p].mkv");
+
+  track::recognition::ParseOptions parse_options;
+  track::recognition::MatchOptions match_options;
+  match_options.allow_sequels = true;
+  match_options.check_airing_date = true;
+  match_options.check_anime_type = true;
+  match_options.check_episode_number = true;
+
+  std::vector<anime::Episode> episodes;
+  for (const auto& title : titles) {
+    anime::Episode episode;
+    if (Meow.Parse(title, parse_options, episode))
+      episodes.push_back(std::move(episode));
+  }
+
+  // Every item is looked up and validated against every anime in the
+  // database, which is the worst case for ValidateOptions
+  Tester test;
+  size_t legacy_redirection_count = 0;
+  size_t redirection_count = 0;
+  size_t valid_count = 0;
+
+  test.Start();
+  for (const auto& episode : episodes) {
+    const auto range = episode.episode_number_range();
+    for (const auto& it : AnimeDatabase.items) {
+      int destination_id = anime::ID_UNKNOWN;
+      std::pair<int, int> destination_range;
+      if (legacy::SearchEpisodeRedirection(legacy_relations, it.first, range,
+                                           destination_id, destination_range))
+        ++legacy_redirection_count;
+    }
+  }
+  const auto legacy_duration = test.Stop(L"", false);
+
+  test.Start();
+  for (const auto& episode : episodes) {
+    const auto range = episode.episode_number_range();
+    for (const auto& it : AnimeDatabase.items) {
+      int destination_id = anime::ID_UNKNOWN;
+      std::pair<int, int> destination_range;
+      if (Meow.SearchEpisodeRedirection(it.first, range, destination_id,
+                                        destination_range))
+        ++redirection_count;
+    }
+  }
+  const auto redirection_duration = test.Stop(L"", false);
+
+  if (legacy_redirection_count != redirection_count)
+    ++mismatch_count;
+
+  test.Start();
+  for (const auto& episode : episodes) {
+    // Episodes are not modified unless they're redirected
+    anime::Episode copy(episode);
+    for (const auto& it : AnimeDatabase.items) {
+      if (Meow.ValidateOptions(copy, it.first, match_options, false))
+        ++valid_count;
+    }
+  }
+  const auto validate_duration = test.Stop(L"", false);
+
+  test.Start();
+  for (const auto& episode : episodes) {
+    anime::Episode copy(episode);
+    Meow.Identify(copy, false, match_options);
+  }
+  const auto identify_duration = test.Stop(L"", false);
+
+  ReportBenchmark(L"Relations (" + ToWstr(lookup_count) + L" lookups, " +
+                      ToWstr(mismatch_count) + L" mismatches, " +
+                      ToWstr(episodes.size()) + L"x" +
+                      ToWstr(AnimeDatabase.items.size()) + L", " +
+                      ToWstr(redirection_count) + L" redirections, " +
+                      ToWstr(valid_count) + L" valid)",
+                  {{L"legacy redirection", legacy_duration},
+                   {L"redirection", redirection_duration},
+                   {L"validate", validate_duration},
+                   {L"identify", identify_duration}});
+}
+
+void BenchmarkRelationsParser() {
+  std::string document;
+  if (!ReadFromFile(taiga::GetPath(taiga::Path::DatabaseAnimeRelations),
+                    document)) {
+    LOGW(L"Could not read anime relations data.");
+    return;
+  }
+
+  // Edge cases that the current file may not have
+  document += "\n::rules\n"
+              "- 1|2:3-? -> 4|~:5-?!\n"
+              "- 6|?:1-12 -> ~|~:13-24\n"
+              "- 7|7:0 -> 8|8:1!\n"
+              "- ?|9:1 -> 10|10:1\n"
+              "- 11|11:1-2 -> 12|12:3-\n"
+              "- 13|13:1 ->14|14:1\n"
+              "- 15|15:1 -> 16|16:1 \r\n";
+
+  const size_t repeat_count = 10;
+  std::map<int, legacy::Relation> legacy_relations;
+  Tester test;
+
+  test.Start();
+  for (size_t i = 0; i < repeat_count; ++i) {
+    legacy_relations.clear();
+    legacy::ReadRelations(document, legacy_relations);
+  }
+  const auto legacy_duration = test.Stop(L"", false);
+
+  // Rules are parsed into a local container, so that the engine keeps using
+  // the actual relations
+  track::recognition::Relations relations;
+  std::string last_modified;
+
+  test.Start();
+  for (size_t i = 0; i < repeat_count; ++i) {
+    relations = track::recognition::Relations();
+    track::recognition::ParseRelations(document, relations, last_modified);
+  }
+  const auto duration = test.Stop(L"", false);
+
+  // Every episode of every source is redirected the same way by both
+  size_t lookup_count = 0;
+  size_t mismatch_count = 0;
+  for (const auto& it : legacy_relations) {
+    const int last_episode = it.second.GetLastEpisode() + 1;
+    for (int episode = 0; episode <= last_episode; ++episode) {
+      std::pair<int, int> legacy_result;
+      const bool legacy_found = it.second.FindRange(episode, legacy_result);
+      std::pair<int, int> result;
+      const bool found = relations.FindRange(it.first, episode, result);
+      if (legacy_found != found || (found && legacy_result != result)) {
+        LOGW(L"Redirection differs: " + ToWstr(it.first) + L":" +
+             ToWstr(episode));
+        ++mismatch_count;
+      }
+      ++lookup_count;
+    }
+  }
+
+  ReportBenchmark(L"ReadRelations (" + ToWstr(repeat_count) + L"x, " +
+                      ToWstr(lookup_count) + L" lookups, " +
+                      ToWstr(mismatch_count) + L" mismatches)",
+                  {{L"regex", legacy_duration}, {L"single pass", duration}});
+}
+
+void BenchmarkDatabaseImport() {
+  // Library entries as they come out of a service response
+  const size_t item_count = 20000;
+  std::vector<anime::Item> library;
+  for (size_t i = 0; i < item_count; ++i) {
+    anime::Item anime_item;
+    anime_item.SetSource(sync::kMyAnimeList);
+    anime_item.SetId(ToWstr(static_cast<int>(i + 1)), sync::kMyAnimeList);
+    anime_item.SetEpisodeCount(12);
+    anime_item.SetLastModified(1);
+    anime_item.AddtoUserList();
+    anime_item.SetMyStatus(anime::kWatching);
+    anime_item.SetMyLastWatchedEpisode(static_cast<int>(i % 12));
+    library.push_back(anime_item);
+  }
+
+  // Items are merged without notifying the recognition engine, statistics or
+  // the text index, which all refer to AnimeDatabase
+  anime::Database database;
+  bool metadata_updated = false;
+  bool titles_updated = false;
+  Tester test;
+
+  test.Start();
+  for (const auto& anime_item : library)
+    database.MergeItem(anime_item, metadata_updated, titles_updated);
+  const auto import_duration = test.Stop(L"", false);
+
+  test.Start();
+  for (const auto& anime_item : library)
+    database.MergeItem(anime_item, metadata_updated, titles_updated);
+  const auto update_duration = test.Stop(L"", false);
+
+  // Previous implementation went through every item for each service
+  const size_t legacy_count = 1000;
+  size_t found_count = 0;
+  test.Start();
+  for (size_t i = 0; i < legacy_count; ++i) {
+    const auto& id = library[i].GetId(sync::kMyAnimeList);
+    for (enum_t service = sync::kTaiga; service <= sync::kLastService; service++) {
+      auto it = std::find_if(database.items.begin(), database.items.end(),
+          [&](const std::pair<const int, anime::Item>& pair) {
+            return pair.second.GetId(service) == id;
+          });
+      if (it != database.items.end()) {
+        ++found_count;
+        break;
+      }
+    }
+  }
+  const auto legacy_duration = test.Stop(L"", false);
+
+  ReportBenchmark(L"Database import (" + ToWstr(database.items.size()) +
+                      L" items, " + ToWstr(found_count) + L" linear lookups)",
+                  {{L"import", import_duration},
+                   {L"update", update_duration},
+                   {L"linear x" + ToWstr(static_cast<int>(legacy_count)),
+                    legacy_duration}});
+}
+
+static size_t GetPrivateUsage() {
+  PROCESS_MEMORY_COUNTERS_EX counters = {};
+  ::GetProcessMemoryInfo(::GetCurrentProcess(),
+                         reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters),
+                         sizeof(counters));
+  return counters.PrivateUsage;
+}
+
+static void FillBenchmarkItem(anime::Item& anime_item, int id) {
+  anime_item.SetId(ToWstr(id), sync::kTaiga);
+  anime_item.SetId(ToWstr(id), sync::kMyAnimeList);
+  anime_item.SetSource(sync::kMyAnimeList);
+  anime_item.SetTitle(L"Benchmark Title " + ToWstr(id));
+  anime_item.SetEnglishTitle(L"Benchmark English Title " + ToWstr(id));
+  anime_item.SetEpisodeCount(12 + id % 14);
+  anime_item.SetEpisodeLength(24);
+  anime_item.SetDateStart(Date(2000 + id % 20, 1 + id % 12, 1));
+  anime_item.SetDateEnd(Date(2000 + id % 20, 1 + (id + 3) % 12, 1));
+  anime_item.SetGenres(std::vector<std::wstring>{L"Action", L"Comedy", L"Drama"});
+  anime_item.SetProducers(std::vector<std::wstring>{L"Studio A", L"Studio B"});
+  anime_item.SetImageUrl(L"https://example.com/images/anime/" + ToWstr(id));
+  anime_item.SetScore(5.0 + (id % 50) / 10.0);
+  anime_item.SetPopularity(id);
+  if (id % 4 == 0) {
+    anime_item.AddtoUserList();
+    anime_item.SetMyStatus(anime::kCompleted);
+  }
+}
+
+template <typename Container>
+static double ScanBenchmarkItems(const Container& items) {
+  double sum = 0.0;
+  for (const auto& pair : items) {
+    const auto& anime_item = pair.second;
+    sum += anime_item.GetEpisodeCount() * anime_item.GetEpisodeLength();
+    sum += anime_item.GetScore() + anime_item.GetPopularity();
+    sum += anime_item.GetDateStart().year();
+  }
+  return sum;
+}
+
+void BenchmarkDatabaseScan() {
+  // Synthetic items, so that results are comparable between databases
+  const int item_count = 25000;
+  const int scan_count = 20;
+
+  // Previous container, which allocated a tree node for every item
+  size_t usage = GetPrivateUsage();
+  auto legacy_items = std::make_unique<std::map<int, anime::Item>>();
+  for (int id = 1; id <= item_count; ++id)
+    FillBenchmarkItem((*legacy_items)[id], id);
+  const size_t legacy_memory = GetPrivateUsage() - usage;
+
+  usage = GetPrivateUsage();
+  auto items = std::make_unique<anime::ItemStore>();
+  items->reserve(item_count);
+  for (int id = 1; id <= item_count; ++id)
+    FillBenchmarkItem((*items)[id], id);
+  const size_t memory = GetPrivateUsage() - usage;
+
+  Tester test;
+  double legacy_sum = 0.0;
+  double sum = 0.0;
+
+  test.Start();
+  for (int i = 0; i < scan_count; ++i)
+    legacy_sum += ScanBenchmarkItems(*legacy_items);
+  const auto legacy_duration = test.Stop(L"", false) / scan_count;
+
+  test.Start();
+  for (int i = 0; i < scan_count; ++i)
+    sum += ScanBenchmarkItems(*items);
+  const auto duration = test.Stop(L"", false) / scan_count;
+
+  if (legacy_sum != sum)
+    LOGW(L"Scan results differ: " + ToWstr(legacy_sum) + L" vs " +
+         ToWstr(sum));
+
+  ReportBenchmark(L"Database scan (" + ToWstr(item_count) + L" items, " +
+                      L"item size: " + ToWstr(static_cast<int>(sizeof(anime::Item))) +
+                      L" bytes, map: " + ToWstr(static_cast<int>(legacy_memory / 1024)) +
+                      L" KB, store: " + ToWstr(static_cast<int>(memory / 1024)) +
+                      L" KB)",
+                  {{L"map", legacy_duration}, {L"store", duration}});
+}
+
+void BenchmarkListSort() {
+  // Synthetic list, so that every column has something to sort by
+  const int item_count = 10000;
+
+  auto items = std::make_unique<anime::ItemStore>();
+  items->reserve(item_count);
+  for (int id = 1; id <= item_count; ++id) {
+    auto& anime_item = (*items)[id];
+    FillBenchmarkItem(anime_item, id);
+    anime_item.SetType(anime::kTv + id % 6);
+    anime_item.AddtoUserList();
+    anime_item.SetMyStatus(anime::kWatching);
+    anime_item.SetMyLastWatchedEpisode(id % 13);
+    anime_item.SetMyScore((id * 7) % 101);
+    anime_item.SetMyLastUpdated(ToWstr(1500000000 + (id * 7919) % 86400));
+  }
+
+  std::vector<const anime::Item*> shuffled_items;
+  for (const auto& pair : *items)
+    shuffled_items.push_back(&pair.second);
+  std::shuffle(shuffled_items.begin(), shuffled_items.end(),
+               std::mt19937(item_count));
+
+  const std::vector<std::pair<int, std::wstring>> sort_types{
+    {ui::kListSortDateStart, L"Date"},
+    {ui::kListSortEpisodeCount, L"Episodes"},
+    {ui::kListSortLastUpdated, L"Last updated"},
+    {ui::kListSortPopularity, L"Popularity"},
+    {ui::kListSortProgress, L"Progress"},
+    {ui::kListSortMyScore, L"My score"},
+    {ui::kListSortScore, L"Score"},
+    {ui::kListSortSeason, L"Season"},
+    {ui::kListSortStatus, L"Status"},
+    {ui::kListSortTitle, L"Title"},
+    {ui::kListSortType, L"Type"},
+  };
+  const int order = base::kGreaterThan;
+
+  Tester test;
+  float legacy_total = 0.0f;
+  float total = 0.0f;
+
+  for (const auto& sort_type : sort_types) {
+    const int type = sort_type.first;
+
+    // Previous comparators, which went through both items every time
+    auto legacy_items = shuffled_items;
+    test.Start();
+    std::sort(legacy_items.begin(), legacy_items.end(),
+        [&](const anime::Item* item1, const anime::Item* item2) {
+          const int result = ui::SortList(type, order, *item1, *item2) * order;
+          if (result != base::kEqualTo)
+            return result < 0;
+          return item1->GetId() < item2->GetId();
+        });
+    const auto legacy_duration = test.Stop(L"", false);
+
+    // Keys are computed from scratch, as they would be for a new sort column
+    ui::SortKeyCache sort_keys;
+    auto sorted_items = shuffled_items;
+    test.Start();
+    std::sort(sorted_items.begin(), sorted_items.end(),
+        [&](const anime::Item* item1, const anime::Item* item2) {
+          const int result = order * ui::CompareSortKeys(type, order,
+              sort_keys.Get(type, *item1), sort_keys.Get(type, *item2));
+          if (result != base::kEqualTo)
+            return result < 0;
+          return item1->GetId() < item2->GetId();
+        });
+    const auto duration = test.Stop(L"", false);
+
+    if (legacy_items != sorted_items)
+      LOGW(L"Sort results differ for column: " + sort_type.second);
+
+    ReportBenchmark(L"List sort by " + sort_type.second + L" (" +
+                        ToWstr(item_count) + L" items)",
+                    {{L"legacy", legacy_duration}, {L"keys", duration}});
+
+    legacy_total += legacy_duration;
+    total += duration;
+  }
+
+  ReportBenchmark(L"List sort by all columns (" + ToWstr(item_count) +
+                      L" items)",
+                  {{L"legacy", legacy_total}, {L"keys", total}});
+}
+
+void BenchmarkTrigrams() {
+  const auto titles = GetBenchmarkTitles(2000);
+
+  std::vector<legacy::trigram_container_t> legacy_trigrams(titles.size());
+  std::vector<trigram_container_t> trigrams(titles.size());
+  for (size_t i = 0; i < titles.size(); ++i) {
+    legacy::GetTrigrams(titles[i], legacy_trigrams[i]);
+    GetTrigrams(titles[i], trigrams[i]);
+  }
+
+  Tester test;
+  double legacy_sum = 0.0;
+  double sum = 0.0;
+
+  test.Start();
+  for (const auto& t1 : legacy_trigrams)
+    for (const auto& t2 : legacy_trigrams)
+      legacy_sum += legacy::CompareTrigrams(t1, t2);
+  const auto legacy_duration = test.Stop(L"", false);
+
+  test.Start();
+  for (const auto& t1 : trigrams)
+    for (const auto& t2 : trigrams)
+      sum += CompareTrigrams(t1, t2);
+  const auto duration = test.Stop(L"", false);
+
+  if (legacy_sum != sum)
+    LOGW(L"Trigram results differ: " + ToWstr(legacy_sum) + L" vs " +
+         ToWstr(sum));
+
+  ReportBenchmark(L"CompareTrigrams (" + ToWstr(titles.size()) + L"^2)",
+                  {{L"legacy", legacy_duration}, {L"packed", duration}});
+}
+
+}  // namespace debug
@@ -228,6 +228,7 @@ void HttpManager::HandleResponse(HttpResponse& response) {
       const int anime_id = static_cast<int>(response.parameter);
       if (response.GetStatusCategory() == 200) {
         SaveToFile(client.write_buffer_, anime::GetImagePath(anime_id));
+        Stats.InvalidateLocalData();
         if (ImageDatabase.Reload(anime_id))
           ui::OnLibraryEntryImageChange(anime_id);
       } else if (response.code == 404) {
@@ -66,8 +66,14 @@ std::wstring GetPath(Path path) {
       return data_path + L"db\\anime.xml";
     case Path::DatabaseAnimeRelations:
       return data_path + L"db\\anime-relations.txt";
+    case Path::DatabaseAnimeSnapshot:
+      return data_path + L"db\\anime.bin";
     case Path::DatabaseImage:
       return data_path + L"db\\image\\";
+    case Path::DatabaseRecognition:
+      return data_path + L"db\\recognition.bin";
+    case Path::DatabaseScanCache:
+      return data_path + L"db\\scan.bin";
     case Path::DatabaseSeason:
       return data_path + L"db\\season\\";
     case Path::Feed:
@@ -92,6 +98,8 @@ std::wstring GetPath(Path path) {
       return data_path + L"user\\" + GetUserDirectoryName() + L"\\history.xml";
     case Path::UserLibrary:
       return data_path + L"user\\" + GetUserDirectoryName() + L"\\anime.xml";
+    case Path::UserLibraryJournal:
+      return data_path + L"user\\" + GetUserDirectoryName() + L"\\anime.journal";
   }
 }
 
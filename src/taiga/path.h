@@ -31,7 +31,10 @@ enum class Path {
   Database,
   DatabaseAnime,
   DatabaseAnimeRelations,
+  DatabaseAnimeSnapshot,
   DatabaseImage,
+  DatabaseRecognition,
+  DatabaseScanCache,
   DatabaseSeason,
   Feed,
   FeedHistory,
@@ -43,7 +46,8 @@ enum class Path {
   ThemeCurrent,
   User,
   UserHistory,
-  UserLibrary
+  UserLibrary,
+  UserLibraryJournal
 };
 
 std::wstring GetUserDirectoryName(const sync::ServiceId service_id);
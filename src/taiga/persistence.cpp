@@ -0,0 +1,162 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <windows.h>
+
+#include "base/file.h"
+#include "base/log.h"
+#include "base/string.h"
+#include "taiga/persistence.h"
+
+taiga::PersistenceService Persistence;
+
+namespace taiga {
+
+PersistenceService::~PersistenceService() {
+  Shutdown();
+}
+
+void PersistenceService::Save(const std::wstring& path, std::string data,
+                              callback_t on_saved) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = requests_.find(path);
+  if (it != requests_.end()) {
+    // Keep the original due time, so that a file that keeps changing is still
+    // written at least once per window
+    it->second.data = std::move(data);
+    it->second.on_saved = std::move(on_saved);
+  } else {
+    auto& request = requests_[path];
+    request.data = std::move(data);
+    request.on_saved = std::move(on_saved);
+    request.due = std::chrono::steady_clock::now() + window_;
+  }
+
+  if (!thread_.joinable()) {
+    stopping_ = false;
+    thread_ = std::thread(&PersistenceService::WorkerProc, this);
+  }
+
+  request_condition_.notify_one();
+}
+
+void PersistenceService::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  if (!thread_.joinable())
+    return;
+
+  ++flush_count_;
+  request_condition_.notify_one();
+  idle_condition_.wait(lock, [this]() {
+    return requests_.empty() && !writing_;
+  });
+  --flush_count_;
+}
+
+void PersistenceService::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!thread_.joinable())
+      return;
+    stopping_ = true;
+    request_condition_.notify_one();
+  }
+
+  // The worker writes everything that is left before it stops
+  thread_.join();
+}
+
+void PersistenceService::set_window(std::chrono::milliseconds window) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  window_ = window;
+}
+
+void PersistenceService::WorkerProc() {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (true) {
+    if (requests_.empty()) {
+      idle_condition_.notify_all();
+      if (stopping_)
+        break;
+      request_condition_.wait(lock);
+      continue;
+    }
+
+    auto it = requests_.begin();
+    for (auto i = requests_.begin(); i != requests_.end(); ++i)
+      if (i->second.due < it->second.due)
+        it = i;
+
+    if (!stopping_ && flush_count_ == 0 &&
+        std::chrono::steady_clock::now() < it->second.due) {
+      request_condition_.wait_until(lock, it->second.due);
+      continue;
+    }
+
+    const std::wstring path = it->first;
+    Request request = std::move(it->second);
+    requests_.erase(it);
+    writing_ = true;
+
+    lock.unlock();
+    if (WriteToFile(path, request.data)) {
+      if (request.on_saved)
+        request.on_saved();
+    } else {
+      LOGE(L"Could not save file: " + path);
+    }
+    lock.lock();
+
+    writing_ = false;
+  }
+}
+
+bool PersistenceService::WriteToFile(const std::wstring& path,
+                                     const std::string& data) {
+  CreateFolder(GetPathOnly(path));
+
+  const std::wstring temp_path = path + L".tmp";
+
+  HANDLE file_handle = ::CreateFile(GetExtendedLengthPath(temp_path).c_str(),
+                                    GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_handle == INVALID_HANDLE_VALUE)
+    return false;
+
+  DWORD bytes_written = 0;
+  const BOOL result =
+      ::WriteFile(file_handle, data.data(), static_cast<DWORD>(data.size()),
+                  &bytes_written, nullptr) &&
+      bytes_written == data.size() &&
+      ::FlushFileBuffers(file_handle);
+  ::CloseHandle(file_handle);
+
+  if (!result) {
+    ::DeleteFile(GetExtendedLengthPath(temp_path).c_str());
+    return false;
+  }
+
+  return ::MoveFileEx(GetExtendedLengthPath(temp_path).c_str(),
+                      GetExtendedLengthPath(path).c_str(),
+                      MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+}
+
+}  // namespace taiga
@@ -0,0 +1,79 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace taiga {
+
+// Writes files on a background thread, so that saving doesn't block the UI.
+//
+// Callers serialize their data beforehand, and the service only ever sees
+// those immutable buffers. Repeated requests for the same file within the
+// coalescing window replace each other, so only the latest data is written.
+// Files are written to a temporary file first and then renamed over the
+// original, so that a crash can't leave a half-written file behind.
+class PersistenceService {
+public:
+  typedef std::function<void()> callback_t;
+
+  ~PersistenceService();
+
+  // on_saved is called from the worker thread, once the data is on the disk
+  void Save(const std::wstring& path, std::string data,
+            callback_t on_saved = nullptr);
+
+  // Blocks until everything that has been queued so far is written
+  void Flush();
+  // Flushes and stops the worker thread; must be called before exiting
+  void Shutdown();
+
+  void set_window(std::chrono::milliseconds window);
+
+private:
+  struct Request {
+    std::string data;
+    callback_t on_saved;
+    std::chrono::steady_clock::time_point due;
+  };
+
+  void WorkerProc();
+  static bool WriteToFile(const std::wstring& path, const std::string& data);
+
+  std::map<std::wstring, Request> requests_;
+  std::chrono::milliseconds window_{1000};
+
+  std::mutex mutex_;
+  std::condition_variable request_condition_;
+  std::condition_variable idle_condition_;
+  std::thread thread_;
+  size_t flush_count_ = 0;
+  bool stopping_ = false;
+  bool writing_ = false;
+};
+
+}  // namespace taiga
+
+extern taiga::PersistenceService Persistence;
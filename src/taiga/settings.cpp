@@ -27,6 +27,7 @@
 #include "base/xml.h"
 #include "library/anime_db.h"
 #include "library/anime_season.h"
+#include "library/anime_text_index.h"
 #include "library/discover.h"
 #include "library/history.h"
 #include "library/resource.h"
@@ -40,6 +41,7 @@
 #include "taiga/version.h"
 #include "track/media.h"
 #include "track/monitor.h"
+#include "track/recognition.h"
 #include "ui/dlg/dlg_anime_list.h"
 #include "ui/dlg/dlg_season.h"
 #include "ui/menu.h"
@@ -267,6 +269,7 @@ bool AppSettings::Load() {
     anime_item->SetUserSynonyms(item.attribute(L"titles").value());
     anime_item->SetUseAlternative(item.attribute(L"use_alternative").as_bool());
   }
+  AnimeTextIndex.Invalidate();
 
   // Media players
   xml_node node_players = settings.child(L"recognition").child(L"mediaplayers");
@@ -447,6 +450,9 @@ void AppSettings::ApplyChanges(const std::wstring& previous_service,
     ui::OnSettingsChange();
   }
 
+  // Ignored strings and library folders are used while recognizing files
+  Meow.InvalidateCache();
+
   bool enable_monitor = GetBool(kLibrary_WatchFolders);
   FolderMonitor.Enable(enable_monitor);
 
@@ -17,6 +17,7 @@
 */
 
 #include <algorithm>
+#include <cmath>
 
 #include "base/file.h"
 #include "library/anime_db.h"
@@ -42,85 +43,50 @@ Statistics::Statistics()
       tigers_harmed(0),
       torrent_count(0),
       torrent_size(0),
-      uptime(0) {
+      uptime(0),
+      score_sum_(0),
+      score_sum_squares_(0),
+      seconds_planned_(0),
+      seconds_watched_(0),
+      library_valid_(false),
+      local_data_valid_(false) {
 }
 
 void Statistics::CalculateAll() {
-  CalculateAnimeCount();
-  CalculateEpisodeCount();
-  CalculateLifePlannedToWatch();
-  CalculateLifeSpentWatching();
+  CalculateLibrary();
   CalculateLocalData();
-  CalculateMeanScore();
-  CalculateScoreDeviation();
-  CalculateScoreDistribution();
 }
 
-int Statistics::CalculateAnimeCount() {
-  anime_count = 0;
-
-  for (const auto& pair : AnimeDatabase.items)
-    if (pair.second.IsInList())
-      anime_count++;
+void Statistics::Update() {
+  if (!library_valid_)
+    CalculateLibrary();
+  if (!local_data_valid_)
+    CalculateLocalData();
 
-  return anime_count;
+  UpdateResults();
 }
 
-int Statistics::CalculateEpisodeCount() {
-  episode_count = 0;
-
-  for (const auto& pair : AnimeDatabase.items) {
-    if (!pair.second.IsInList())
-      continue;
+void Statistics::CalculateLibrary() {
+  items_.clear();
 
-    episode_count += pair.second.GetMyLastWatchedEpisode();
-    episode_count += anime::GetMyRewatchedTimes(pair.second) *
-                     pair.second.GetEpisodeCount();
-  }
-
-  return episode_count;
-}
-
-const std::wstring& Statistics::CalculateLifePlannedToWatch() {
-  int seconds = 0;
+  anime_count = 0;
+  episode_count = 0;
+  for (auto& value : score_count)
+    value = 0;
+  score_sum_ = 0;
+  score_sum_squares_ = 0;
+  seconds_planned_ = 0;
+  seconds_watched_ = 0;
 
   for (const auto& pair : AnimeDatabase.items) {
-    const auto& item = pair.second;
-
-    switch (item.GetMyStatus()) {
-      case anime::kNotInList:
-      case anime::kCompleted:
-      case anime::kDropped:
-        continue;
-    }
-
-    int episodes = EstimateEpisodeCount(item) - item.GetMyLastWatchedEpisode();
-
-    seconds += (EstimateDuration(item) * 60) * episodes;
+    const auto stats = GetItemStats(pair.second);
+    items_[pair.first] = stats;
+    AddItemStats(stats, 1);
   }
 
-  life_planned_to_watch = seconds > 0 ? ToDateString(seconds) : L"None";
-  return life_planned_to_watch;
-}
-
-const std::wstring& Statistics::CalculateLifeSpentWatching() {
-  int seconds = 0;
-
-  for (const auto& pair : AnimeDatabase.items) {
-    const auto& item = pair.second;
-
-    if (!item.IsInList())
-      continue;
+  library_valid_ = true;
 
-    int episodes_watched = item.GetMyLastWatchedEpisode();
-    episodes_watched += anime::GetMyRewatchedTimes(item) *
-                        item.GetEpisodeCount();
-
-    seconds += (EstimateDuration(item) * 60) * episodes_watched;
-  }
-
-  life_spent_watching = seconds > 0 ? ToDateString(seconds) : L"None";
-  return life_spent_watching;
+  UpdateResults();
 }
 
 void Statistics::CalculateLocalData() {
@@ -134,68 +100,112 @@ void Statistics::CalculateLocalData() {
 
   torrent_count = PopulateFiles(file_list, path, L"torrent", true);
   torrent_size = GetFolderSize(path, true);
+
+  local_data_valid_ = true;
 }
 
-float Statistics::CalculateMeanScore() {
-  float items_scored = 0.0f;
-  float sum_scores = 0.0f;
+void Statistics::UpdateItem(int anime_id) {
+  // Everything is going to be recalculated anyway
+  if (!library_valid_)
+    return;
 
-  for (const auto& pair : AnimeDatabase.items) {
-    if (!pair.second.IsInList())
-      continue;
+  auto it = items_.find(anime_id);
+  if (it != items_.end()) {
+    AddItemStats(it->second, -1);
+    items_.erase(it);
+  }
 
-    if (pair.second.GetMyScore() > 0) {
-      sum_scores += static_cast<float>(pair.second.GetMyScore());
-      items_scored++;
-    }
+  const auto anime_item = AnimeDatabase.FindItem(anime_id, false);
+  if (anime_item) {
+    const auto stats = GetItemStats(*anime_item);
+    items_[anime_id] = stats;
+    AddItemStats(stats, 1);
   }
+}
 
-  score_mean = items_scored > 0 ? (sum_scores / items_scored) : 0.0f;
+void Statistics::InvalidateLibrary() {
+  library_valid_ = false;
+}
 
-  return score_mean;
+void Statistics::InvalidateLocalData() {
+  local_data_valid_ = false;
 }
 
-float Statistics::CalculateScoreDeviation() {
-  float items_scored = 0.0f;
-  float sum_squares = 0.0f;
+////////////////////////////////////////////////////////////////////////////////
 
-  for (const auto& pair : AnimeDatabase.items) {
-    if (!pair.second.IsInList())
-      continue;
+Statistics::ItemStats Statistics::GetItemStats(const anime::Item& item) const {
+  ItemStats stats;
+
+  if (!item.IsInList())
+    return stats;
 
-    if (pair.second.GetMyScore() > 0) {
-      float score = static_cast<float>(pair.second.GetMyScore());
-      sum_squares += pow(score - score_mean, 2);
-      items_scored++;
+  stats.in_list = true;
+
+  stats.episodes = item.GetMyLastWatchedEpisode();
+  stats.episodes += anime::GetMyRewatchedTimes(item) * item.GetEpisodeCount();
+
+  const long long duration = EstimateDuration(item) * 60;
+  stats.seconds_watched = duration * stats.episodes;
+
+  switch (item.GetMyStatus()) {
+    case anime::kNotInList:
+    case anime::kCompleted:
+    case anime::kDropped:
+      break;
+    default: {
+      int episodes = EstimateEpisodeCount(item) - item.GetMyLastWatchedEpisode();
+      stats.seconds_planned = duration * episodes;
+      break;
     }
   }
 
-  score_deviation = items_scored > 0 ? sqrt(sum_squares / items_scored) : 0.0f;
+  const int score = item.GetMyScore();
+  if (score > 0 && score < static_cast<int>(score_count.size()))
+    stats.score = score;
 
-  return score_deviation;
+  return stats;
 }
 
-const std::vector<float>& Statistics::CalculateScoreDistribution() {
-  for (auto& value : score_count)
-    value = 0;
-  for (auto& value : score_distribution)
-    value = 0.0f;
-
-  float extreme_value = 1.0f;
+void Statistics::AddItemStats(const ItemStats& stats, int sign) {
+  if (stats.in_list)
+    anime_count += sign;
+  episode_count += sign * stats.episodes;
+  seconds_planned_ += sign * stats.seconds_planned;
+  seconds_watched_ += sign * stats.seconds_watched;
+
+  if (stats.score > 0) {
+    score_count[stats.score] += sign;
+    score_sum_ += sign * stats.score;
+    score_sum_squares_ += sign * stats.score * stats.score;
+  }
+}
 
-  for (const auto& pair : AnimeDatabase.items) {
-    int score = pair.second.GetMyScore();
-    if (score > 0) {
-      score_count[score]++;
-      score_distribution[score]++;
-      extreme_value = std::max(score_distribution[score], extreme_value);
-    }
+void Statistics::UpdateResults() {
+  life_planned_to_watch = seconds_planned_ > 0 ?
+      ToDateString(static_cast<time_t>(seconds_planned_)) : L"None";
+  life_spent_watching = seconds_watched_ > 0 ?
+      ToDateString(static_cast<time_t>(seconds_watched_)) : L"None";
+
+  int items_scored = 0;
+  int extreme_value = 1;
+  for (const auto& value : score_count) {
+    items_scored += value;
+    extreme_value = std::max(value, extreme_value);
   }
 
-  for (auto& value : score_distribution)
-    value = value / extreme_value;
+  if (items_scored > 0) {
+    const double mean = static_cast<double>(score_sum_) / items_scored;
+    const double variance =
+        static_cast<double>(score_sum_squares_) / items_scored - mean * mean;
+    score_mean = static_cast<float>(mean);
+    score_deviation = static_cast<float>(std::sqrt(std::max(0.0, variance)));
+  } else {
+    score_mean = 0.0f;
+    score_deviation = 0.0f;
+  }
 
-  return score_distribution;
+  for (size_t i = 0; i < score_count.size(); ++i)
+    score_distribution[i] = static_cast<float>(score_count[i]) / extreme_value;
 }
 
-}  // namespace taiga
\ No newline at end of file
+}  // namespace taiga
@@ -19,24 +19,36 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+namespace anime {
+class Item;
+}
+
 namespace taiga {
 
+// Library statistics are kept up to date as items change, so that displaying
+// them doesn't require going through the whole library. Local data is only
+// recalculated after the relevant directories have changed.
 class Statistics {
 public:
   Statistics();
   ~Statistics() {}
 
+  // Recalculates everything from scratch
   void CalculateAll();
-  int CalculateAnimeCount();
-  int CalculateEpisodeCount();
-  const std::wstring& CalculateLifePlannedToWatch();
-  const std::wstring& CalculateLifeSpentWatching();
+  // Recalculates only what has been invalidated since the last call
+  void Update();
+
+  void CalculateLibrary();
   void CalculateLocalData();
-  float CalculateMeanScore();
-  float CalculateScoreDeviation();
-  const std::vector<float>& CalculateScoreDistribution();
+
+  // Called whenever an item, or a queued value that overrides its list
+  // values, changes. Bulk changes should invalidate the library instead.
+  void UpdateItem(int anime_id);
+  void InvalidateLibrary();
+  void InvalidateLocalData();
 
 public:
   int anime_count;
@@ -55,6 +67,28 @@ public:
   unsigned int torrent_count;
   unsigned long long torrent_size;
   int uptime;
+
+private:
+  // Contribution of a single item to the totals
+  struct ItemStats {
+    bool in_list = false;
+    int episodes = 0;
+    int score = 0;
+    long long seconds_planned = 0;
+    long long seconds_watched = 0;
+  };
+
+  ItemStats GetItemStats(const anime::Item& item) const;
+  void AddItemStats(const ItemStats& stats, int sign);
+  void UpdateResults();
+
+  std::unordered_map<int, ItemStats> items_;
+  long long score_sum_;
+  long long score_sum_squares_;
+  long long seconds_planned_;
+  long long seconds_watched_;
+  bool library_valid_;
+  bool local_data_valid_;
 };
 
 }  // namespace taiga
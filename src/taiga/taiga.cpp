@@ -26,11 +26,14 @@
 #include "library/history.h"
 #include "taiga/announce.h"
 #include "taiga/dummy.h"
+#include "taiga/persistence.h"
 #include "taiga/resource.h"
 #include "taiga/settings.h"
 #include "taiga/taiga.h"
 #include "taiga/version.h"
 #include "track/media.h"
+#include "track/recognition.h"
+#include "track/search.h"
 #include "ui/dialog.h"
 #include "ui/menu.h"
 #include "ui/theme.h"
@@ -114,6 +117,7 @@ void App::Uninitialize() {
   ::Announcer.Clear(kAnnounceToSkype);
 
   // Cleanup
+  ShutdownScanAvailableEpisodes();
   ConnectionManager.Shutdown();
   ui::taskbar.Destroy();
   ui::taskbar_list.Release();
@@ -121,7 +125,10 @@ void App::Uninitialize() {
   // Save
   Settings.Save();
   AnimeDatabase.SaveDatabase();
+  AnimeDatabase.CompactList();
+  Meow.SaveIndex();
   Aggregator.SaveArchive();
+  Persistence.Shutdown();
 
   // Exit
   PostQuitMessage();
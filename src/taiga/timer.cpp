@@ -95,7 +95,7 @@ void Timer::OnTimeout() {
       break;
 
     case kTimerStats:
-      Stats.CalculateAll();
+      Stats.Update();
       break;
 
     case kTimerTorrents:
@@ -29,7 +29,9 @@
 #include "library/anime_util.h"
 #include "taiga/http.h"
 #include "taiga/path.h"
+#include "taiga/persistence.h"
 #include "taiga/settings.h"
+#include "taiga/stats.h"
 #include "track/feed.h"
 #include "track/recognition.h"
 #include "ui/dialog.h"
@@ -85,7 +87,10 @@ bool Aggregator::CheckFeed(FeedCategory category, const std::wstring& source,
 }
 
 void Aggregator::ExamineData(Feed& feed) {
-  for (auto& feed_item : feed.items) {
+  std::vector<std::wstring> titles;
+  titles.reserve(feed.items.size());
+
+  for (const auto& feed_item : feed.items) {
     auto title = feed_item.title;
     switch (feed.source) {
       case FeedSource::AnimeBytes: {
@@ -102,20 +107,23 @@ void Aggregator::ExamineData(Feed& feed) {
         break;
       }
     }
+    titles.push_back(title);
+  }
 
-    auto& episode_data = feed_item.episode_data;
-
-    // Examine title and compare with anime list items
-    static track::recognition::ParseOptions parse_options;
-    parse_options.parse_path = false;
-    parse_options.streaming_media = false;
-    Meow.Parse(title, parse_options, episode_data);
-    static track::recognition::MatchOptions match_options;
-    match_options.allow_sequels = true;
-    match_options.check_airing_date = true;
-    match_options.check_anime_type = true;
-    match_options.check_episode_number = true;
-    Meow.Identify(episode_data, false, match_options);
+  // Examine titles and compare with anime list items
+  track::recognition::ParseOptions parse_options;
+  parse_options.parse_path = false;
+  parse_options.streaming_media = false;
+  track::recognition::MatchOptions match_options;
+  match_options.allow_sequels = true;
+  match_options.check_airing_date = true;
+  match_options.check_anime_type = true;
+  match_options.check_episode_number = true;
+  auto episodes = Meow.IdentifyBatch(titles, parse_options, match_options);
+
+  for (size_t i = 0; i < feed.items.size(); ++i) {
+    auto& episode_data = feed.items[i].episode_data;
+    episode_data = std::move(episodes[i]);
 
     // Update last aired episode number
     if (anime::IsValidId(episode_data.anime_id)) {
@@ -272,6 +280,7 @@ void Aggregator::HandleFeedDownload(Feed& feed, const std::string& data) {
     file = feed.GetDataPath() + file + L".torrent";
 
     SaveToFile(data, file);
+    Stats.InvalidateLocalData();
 
     if (!FileExists(file)) {
       ui::OnFeedDownload(false, L"Torrent file doesn't exist");
@@ -586,7 +595,8 @@ bool Aggregator::SaveArchive() const {
   }
 
   std::wstring path = taiga::GetPath(taiga::Path::FeedHistory);
-  return XmlWriteDocumentToFile(document, path);
+  Persistence.Save(path, XmlWriteDocumentToString(document));
+  return true;
 }
 
 void Aggregator::AddToArchive(const std::wstring& file) {
@@ -343,21 +343,23 @@ void ProcessMediaPlayerTitle(const MediaPlayer& media_player) {
 
     // Examine title and compare it with list items
     bool ignore_file = false;
-    static track::recognition::ParseOptions parse_options;
+    track::recognition::ParseOptions parse_options;
     parse_options.parse_path = true;
     parse_options.streaming_media = media_player.type == anisthesia::PlayerType::WebBrowser;
+    track::recognition::MatchOptions match_options;
+    match_options.allow_sequels = true;
+    match_options.check_airing_date = true;
+    match_options.check_anime_type = true;
+    match_options.check_episode_number = true;
     if (Meow.Parse(MediaPlayers.current_title(), parse_options, CurrentEpisode)) {
       bool is_inside_library_folders = true;
       if (Settings.GetBool(taiga::kSync_Update_OutOfRoot))
         if (!CurrentEpisode.folder.empty() && !Settings.library_folders.empty())
           is_inside_library_folders = anime::IsInsideLibraryFolders(CurrentEpisode.folder);
       if (is_inside_library_folders) {
-        static track::recognition::MatchOptions match_options;
-        match_options.allow_sequels = true;
-        match_options.check_airing_date = true;
-        match_options.check_anime_type = true;
-        match_options.check_episode_number = true;
-        auto anime_id = Meow.Identify(CurrentEpisode, true, match_options);
+        auto anime_id = Meow.IdentifyParsed(MediaPlayers.current_title(),
+                                            parse_options, match_options,
+                                            CurrentEpisode);
         if (anime::IsValidId(anime_id)) {
           // Recognized
           anime_item = AnimeDatabase.FindItem(anime_id);
@@ -377,8 +379,15 @@ void ProcessMediaPlayerTitle(const MediaPlayer& media_player) {
     }
     // Not recognized
     CurrentEpisode.Set(anime::ID_NOTINLIST);
-    if (!ignore_file)
-      ui::OnRecognitionFail();
+    if (!ignore_file) {
+      // Scores of similar titles are not cached, so they're calculated again
+      // for the titles that could not be recognized
+      track::recognition::sorted_scores_t scores;
+      anime::Episode episode;
+      if (Meow.Parse(MediaPlayers.current_title(), parse_options, episode))
+        Meow.Identify(episode, true, match_options, &scores);
+      ui::OnRecognitionFail(scores);
+    }
 
   } else {
     if (MediaPlayers.title_changed()) {
@@ -76,7 +76,7 @@ void FolderMonitor::HandleChangeNotification(
 static anime::Item* FindAnimeItem(const DirectoryChangeNotification& notification,
                                   anime::Episode& episode) {
   std::wstring path;
-  static track::recognition::ParseOptions parse_options;
+  track::recognition::ParseOptions parse_options;
   switch (notification.type) {
     case DirectoryChangeNotification::Type::Directory:
       path = GetFileName(notification.filename.first);
@@ -91,10 +91,7 @@ static anime::Item* FindAnimeItem(const DirectoryChangeNotification& notificatio
       break;
   }
 
-  if (!Meow.Parse(path, parse_options, episode))
-    return nullptr;
-
-  static track::recognition::MatchOptions match_options;
+  track::recognition::MatchOptions match_options;
   switch (notification.type) {
     case DirectoryChangeNotification::Type::Directory:
       match_options.allow_sequels = false;
@@ -111,9 +108,10 @@ static anime::Item* FindAnimeItem(const DirectoryChangeNotification& notificatio
       break;
   }
 
-  auto anime_id = Meow.Identify(episode, false, match_options);
+  if (!Meow.ParseAndIdentify(path, parse_options, match_options, episode))
+    return nullptr;
 
-  return AnimeDatabase.FindItem(anime_id);
+  return AnimeDatabase.FindItem(episode.anime_id);
 }
 
 void FolderMonitor::OnDirectory(const DirectoryChangeNotification& notification) const {
@@ -16,6 +16,8 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+
 #include <anitomy/anitomy/anitomy.h>
 #include <anitomy/anitomy/keyword.h>
 
@@ -71,11 +73,18 @@ bool Engine::Parse(std::wstring filename, const ParseOptions& parse_options,
 }
 
 int Engine::Identify(anime::Episode& episode, bool give_score,
-                     const MatchOptions& match_options) {
+                     const MatchOptions& match_options,
+                     sorted_scores_t* scores) {
   std::set<int> anime_ids;
+  sorted_scores_t local_scores;
+  if (!scores)
+    scores = &local_scores;
+  scores->clear();
 
   InitializeTitles();
 
+  std::shared_lock<std::shared_mutex> lock(titles_mutex_);
+
   auto valide_ids = [&](anime::Episode& episode) {
     for (auto it = anime_ids.begin(); it != anime_ids.end(); ) {
       if (!ValidateOptions(episode, *it, match_options, true)) {
@@ -153,9 +162,9 @@ int Engine::Identify(anime::Episode& episode, bool give_score,
   } else if (anime_ids.size() == 1) {
     episode.anime_id = *anime_ids.begin();
   } else if (anime_ids.size() > 1) {
-    episode.anime_id = ScoreTitle(episode, anime_ids, match_options);
+    episode.anime_id = ScoreTitle(episode, anime_ids, match_options, *scores);
   } else if (anime_ids.empty() && give_score) {
-    ScoreTitle(episode, anime_ids, match_options);
+    ScoreTitle(episode, anime_ids, match_options, *scores);
   }
 
   // Post-processing
@@ -178,18 +187,41 @@ int Engine::Identify(anime::Episode& episode, bool give_score,
   return episode.anime_id;
 }
 
+std::vector<anime::Episode> Engine::IdentifyBatch(
+    const std::vector<std::wstring>& titles, const ParseOptions& parse_options,
+    const MatchOptions& match_options) {
+  std::vector<anime::Episode> episodes(titles.size());
+
+  // Titles must be ready before the workers start, so that they only have to
+  // wait on each other for reading
+  InitializeTitles();
+
+  // Threads are reused between batches, as library scans go through a lot of
+  // them. Results are written to their own slots.
+  batch_pool_.ParallelFor(titles.size(), [&](size_t index) {
+    ParseAndIdentify(titles[index], parse_options, match_options,
+                     episodes[index]);
+  });
+
+  return episodes;
+}
+
 bool Engine::Search(const std::wstring& title, std::vector<int>& anime_ids) {
   anime::Episode episode;
   episode.set_anime_title(title);
 
   std::set<int> empty_set;
   track::recognition::MatchOptions default_options;
+  sorted_scores_t scores;
 
   InitializeTitles();
 
-  ScoreTitle(episode, empty_set, default_options);
+  {
+    std::shared_lock<std::shared_mutex> lock(titles_mutex_);
+    ScoreTitle(episode, empty_set, default_options, scores);
+  }
 
-  for (const auto& score : scores_) {
+  for (const auto& score : scores) {
     anime_ids.push_back(score.first);
   }
 
@@ -199,84 +231,199 @@ bool Engine::Search(const std::wstring& title, std::vector<int>& anime_ids) {
 ////////////////////////////////////////////////////////////////////////////////
 
 void Engine::InitializeTitles() {
-  static bool initialized = false;
+  if (titles_initialized_)
+    return;
 
-  if (!initialized) {
-    initialized = true;
-    for (const auto& it : AnimeDatabase.items) {
-      UpdateTitles(it.second);
-    }
+  std::unique_lock<std::shared_mutex> lock(titles_mutex_);
+
+  // Another thread might have initialized the titles while we were waiting
+  if (titles_initialized_)
+    return;
 
-    ReadRelations();
+  // Titles are normalized only for items that were modified since the index
+  // was last saved
+  std::map<int, ScoreStore> stores;
+  LoadIndex(stores);
+
+  for (const auto& it : AnimeDatabase.items) {
+    auto store = stores.find(it.first);
+    if (store != stores.end() &&
+        store->second.last_modified == it.second.GetLastModified() &&
+        store->second.checksum == GetTitleChecksum(it.second)) {
+      InsertTitles(it.first, store->second);
+    } else {
+      IndexTitles(it.second, false);
+    }
   }
+
+  // Relations are read before other threads are let in, so that they can
+  // redirect episodes from the start
+  ReadRelations();
+
+  titles_initialized_ = true;
+
+  if (stores.size() != AnimeDatabase.items.size())
+    index_modified_ = true;
+  WriteIndex();
 }
 
 void Engine::UpdateTitles(const anime::Item& anime_item, bool erase_ids) {
-  const int anime_id = anime_item.GetId();
+  {
+    std::unique_lock<std::shared_mutex> lock(titles_mutex_);
+    IndexTitles(anime_item, erase_ids);
+  }
 
-  db_[anime_id].normal_titles.clear();
-  db_[anime_id].trigrams.clear();
+  InvalidateCache();
+}
+
+void Engine::IndexTitles(const anime::Item& anime_item, bool erase_ids) {
+  const int anime_id = anime_item.GetId();
 
   if (erase_ids) {
-    auto erase_id = [&anime_id](Titles::container_t& titles) {
-      for (auto& title : titles) {
-        title.second.erase(anime_id);
+    auto keys = title_keys_.find(anime_id);
+    if (keys != title_keys_.end()) {
+      for (const auto& key : keys->second) {
+        auto it = key.container->find(key.title);
+        if (it != key.container->end()) {
+          it->second.erase(anime_id);
+          if (it->second.empty())
+            key.container->erase(it);
+        }
       }
-    };
-    erase_id(titles_.alternative);
-    erase_id(titles_.main);
-    erase_id(titles_.user);
-    erase_id(normal_titles_.alternative);
-    erase_id(normal_titles_.main);
-    erase_id(normal_titles_.user);
+      title_keys_.erase(keys);
+    }
   }
 
-  auto update_title = [&](std::wstring title,
-                          Titles::container_t& titles,
-                          Titles::container_t& normal_titles) {
+  ScoreStore store;
+  store.last_modified = anime_item.GetLastModified();
+  store.checksum = GetTitleChecksum(anime_item);
+
+  auto update_title = [&](std::wstring title, TitleType type) {
     if (!title.empty()) {
+      store.title_types.push_back(type);
+
       Normalize(title, kNormalizeForTrigrams, false);
-      trigram_container_t trigrams;
-      GetTrigrams(title, trigrams);
-      db_[anime_id].trigrams.push_back(trigrams);
-      db_[anime_id].normal_titles.push_back(title);
+      store.normal_titles.push_back(title);
 
       Normalize(title, kNormalizeForLookup, true);
-      titles[title].insert(anime_id);
+      store.lookup_titles.push_back(title);
 
       Normalize(title, kNormalizeFull, true);
-      normal_titles[title].insert(anime_id);
+      store.full_titles.push_back(title);
     }
   };
 
-  update_title(anime_item.GetTitle(), titles_.main, normal_titles_.main);
-  update_title(anime_item.GetEnglishTitle(), titles_.main, normal_titles_.main);
-  update_title(anime_item.GetJapaneseTitle(), titles_.main, normal_titles_.main);
+  update_title(anime_item.GetTitle(), kTitleMain);
+  update_title(anime_item.GetEnglishTitle(), kTitleMain);
+  update_title(anime_item.GetJapaneseTitle(), kTitleMain);
 
   const auto& date = anime_item.GetDateStart();
   if (anime::IsValidDate(date)) {
     std::wstring year = ToWstr(date.year());
     if (anime_item.GetTitle().find(year) == std::wstring::npos) {
       update_title(anime_item.GetTitle() + L" (" + year + L")",
-                   titles_.alternative, normal_titles_.alternative);
+                   kTitleAlternative);
     }
   }
 
   for (const auto& synonym : anime_item.GetSynonyms()) {
-    update_title(synonym, titles_.alternative, normal_titles_.alternative);
+    update_title(synonym, kTitleAlternative);
   }
   for (const auto& synonym : anime_item.GetUserSynonyms()) {
-    update_title(synonym, titles_.user, normal_titles_.user);
+    update_title(synonym, kTitleUser);
+  }
+
+  InsertTitles(anime_id, store);
+  index_modified_ = true;
+}
+
+void Engine::InsertTitles(int anime_id, ScoreStore& store) {
+  RemoveFromTrigramIndex(anime_id);
+
+  auto get_titles = [](Titles& titles, unsigned char type) -> Titles::container_t& {
+    switch (type) {
+      default:
+      case kTitleMain: return titles.main;
+      case kTitleAlternative: return titles.alternative;
+      case kTitleUser: return titles.user;
+    }
+  };
+
+  auto& keys = title_keys_[anime_id];
+  auto insert_title = [&](Titles::container_t& titles,
+                          const std::wstring& title) {
+    if (titles[title].insert(anime_id))
+      keys.push_back({&titles, title});
+  };
+
+  store.trigrams.resize(store.normal_titles.size());
+
+  for (size_t i = 0; i < store.normal_titles.size(); ++i) {
+    GetTrigrams(store.normal_titles[i], store.trigrams[i]);
+    insert_title(get_titles(titles_, store.title_types[i]),
+                 store.lookup_titles[i]);
+    insert_title(get_titles(normal_titles_, store.title_types[i]),
+                 store.full_titles[i]);
+  }
+
+  db_[anime_id] = std::move(store);
+
+  AddToTrigramIndex(anime_id);
+}
+
+const int* Engine::IdList::begin() const {
+  return size_ <= kInlineCapacity ? inline_ : heap_.data();
+}
+
+const int* Engine::IdList::end() const {
+  return begin() + size_;
+}
+
+bool Engine::IdList::insert(int id) {
+  if (std::find(begin(), end(), id) != end())
+    return false;
+
+  if (size_ < kInlineCapacity) {
+    inline_[size_] = id;
+  } else {
+    if (size_ == kInlineCapacity)
+      heap_.assign(inline_, inline_ + kInlineCapacity);
+    heap_.push_back(id);
+  }
+
+  ++size_;
+  return true;
+}
+
+bool Engine::IdList::erase(int id) {
+  const auto it = std::find(begin(), end(), id);
+  if (it == end())
+    return false;
+
+  if (size_ > kInlineCapacity) {
+    heap_.erase(heap_.begin() + (it - begin()));
+    if (heap_.size() == kInlineCapacity) {
+      std::copy(heap_.begin(), heap_.end(), inline_);
+      heap_.clear();
+      heap_.shrink_to_fit();
+    }
+  } else {
+    std::copy(it + 1, end(), inline_ + (it - begin()));
   }
+
+  --size_;
+  return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
 int Engine::LookUpTitle(std::wstring title, std::set<int>& anime_ids) const {
   int anime_id = anime::ID_UNKNOWN;
 
   auto find_title = [&](const std::wstring& title,
                         const Titles::container_t& container) {
     if (!anime::IsValidId(anime_id)) {
-      auto it = container.find(title.c_str());
+      auto it = container.find(title);
       if (it != container.end()) {
         anime_ids.insert(it->second.begin(), it->second.end());
         if (anime_ids.size() == 1)
@@ -341,7 +488,7 @@ void Engine::ExtendAnimeTitle(anime::Episode& episode) const {
   }
 }
 
-bool Engine::GetTitleFromPath(anime::Episode& episode) {
+bool Engine::GetTitleFromPath(anime::Episode& episode) const {
   if (episode.folder.empty())
     return false;
 
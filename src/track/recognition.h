@@ -18,12 +18,17 @@
 
 #pragma once
 
+#include <atomic>
 #include <map>
+#include <mutex>
 #include <set>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "base/string.h"
+#include "base/thread_pool.h"
 
 namespace anime {
 class Episode;
@@ -48,16 +53,44 @@ struct MatchOptions {
   bool check_episode_number = false;
 };
 
+struct CacheStats {
+  size_t hits = 0;
+  size_t misses = 0;
+};
+
+// Identify, IdentifyBatch and Search can be called from multiple threads at
+// the same time. Titles are indexed from AnimeDatabase, which must not be
+// modified while a call is in progress; use UpdateTitles afterwards.
 class Engine {
 public:
+  // Must be increased whenever Normalize gives different results, so that
+  // titles in the saved index are normalized again
+  static constexpr unsigned int kNormalizationVersion = 1;
+
   bool Parse(std::wstring filename, const ParseOptions& parse_options, anime::Episode& episode) const;
-  int Identify(anime::Episode& episode, bool give_score, const MatchOptions& match_options);
+  int Identify(anime::Episode& episode, bool give_score, const MatchOptions& match_options, sorted_scores_t* scores = nullptr);
+  std::vector<anime::Episode> IdentifyBatch(const std::vector<std::wstring>& titles, const ParseOptions& parse_options, const MatchOptions& match_options);
   bool Search(const std::wstring& title, std::vector<int>& anime_ids);
 
+  // Same as Parse followed by Identify, except that results of recent inputs
+  // are remembered. The cache must be invalidated whenever something that
+  // affects the results changes (e.g. titles, relations, settings).
+  bool ParseAndIdentify(const std::wstring& input, const ParseOptions& parse_options, const MatchOptions& match_options, anime::Episode& episode);
+  // Same as Identify, for an episode that has just been parsed from the input.
+  // Shares its results with ParseAndIdentify.
+  int IdentifyParsed(const std::wstring& input, const ParseOptions& parse_options, const MatchOptions& match_options, anime::Episode& episode);
+  void InvalidateCache();
+  CacheStats GetCacheStats() const;
+
   void InitializeTitles();
   void UpdateTitles(const anime::Item& anime_item, bool erase_ids = false);
+  bool SaveIndex();
 
-  sorted_scores_t GetScores() const;
+  // Changes whenever the same input could be identified differently, except
+  // for metadata that is only used to validate results (e.g. episode count)
+  unsigned int GetIndexChecksum() const;
+
+  void NormalizeTitle(std::wstring& title) const;
 
   bool IsBatchRelease(const anime::Episode& episode) const;
   bool IsValidAnimeType(const anime::Episode& episode) const;
@@ -65,9 +98,14 @@ public:
   bool IsValidFileExtension(const anime::Episode& episode) const;
   bool IsValidFileExtension(const std::wstring& extension) const;
 
+  // Checks the episode against the options for the given anime, and moves it
+  // to a sequel if redirect is set and the episode number calls for it
+  bool ValidateOptions(anime::Episode& episode, int anime_id, const MatchOptions& match_options, bool redirect) const;
+
   bool ReadRelations();
   bool ReadRelations(const std::string& document);
   bool SearchEpisodeRedirection(int id, const std::pair<int, int>& range, int& destination_id, std::pair<int, int>& destination_range) const;
+  unsigned int GetRelationsChecksum() const;
 
 private:
   enum NormalizationType {
@@ -77,39 +115,102 @@ private:
     kNormalizeFull,
   };
 
-  bool ValidateOptions(anime::Episode& episode, int anime_id, const MatchOptions& match_options, bool redirect) const;
+  enum TitleType {
+    kTitleMain,
+    kTitleAlternative,
+    kTitleUser,
+  };
+
   bool ValidateOptions(anime::Episode& episode, const anime::Item& anime_item, const MatchOptions& match_options, bool redirect) const;
   bool ValidateEpisodeNumber(anime::Episode& episode, const anime::Item& anime_item, const MatchOptions& match_options, bool redirect) const;
 
   int LookUpTitle(std::wstring title, std::set<int>& anime_ids) const;
-  bool GetTitleFromPath(anime::Episode& episode);
+  bool GetTitleFromPath(anime::Episode& episode) const;
   void ExtendAnimeTitle(anime::Episode& episode) const;
 
-  int ScoreTitle(anime::Episode& episode, const std::set<int>& anime_ids, const MatchOptions& match_options);
-  int ScoreTitle(const std::wstring& str, const anime::Episode& episode, const scores_t& trigram_results);
+  int ScoreTitle(anime::Episode& episode, const std::set<int>& anime_ids, const MatchOptions& match_options, sorted_scores_t& scores) const;
+  int ScoreTitle(const std::wstring& str, const anime::Episode& episode, const scores_t& trigram_results, sorted_scores_t& scores) const;
+
+  void AddToTrigramIndex(int anime_id);
+  void RemoveFromTrigramIndex(int anime_id);
+  void FindTrigramCandidates(const trigram_container_t& trigrams, scores_t& trigram_results) const;
 
   void Normalize(std::wstring& title, int type, bool normalized_before) const;
   void NormalizeUnicode(std::wstring& str) const;
   void ErasePunctuation(std::wstring& str, int type, bool modified_tail) const;
-  void EraseUnnecessary(std::wstring& str) const;
-  void ConvertOrdinalNumbers(std::wstring& str) const;
-  void ConvertRomanNumbers(std::wstring& str) const;
-  void ConvertSeasonNumbers(std::wstring& str) const;
-  void Transliterate(std::wstring& str) const;
+  void ReplaceWords(const std::wstring& str, std::wstring& output) const;
+  void Transliterate(const std::wstring& str, std::wstring& output) const;
+
+  // Nearly every title belongs to a single anime, so a couple of IDs are kept
+  // inline and the rest go to the heap
+  class IdList {
+  public:
+    const int* begin() const;
+    const int* end() const;
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    bool insert(int id);
+    bool erase(int id);
+
+  private:
+    static constexpr size_t kInlineCapacity = 2;
+    size_t size_ = 0;
+    int inline_[kInlineCapacity] = {};
+    std::vector<int> heap_;
+  };
 
   struct Titles {
-    typedef std::map<std::wstring, std::set<int>> container_t;
+    typedef std::unordered_map<std::wstring, IdList> container_t;
     container_t alternative;
     container_t main;
     container_t user;
   } normal_titles_, titles_;
 
+  // Keys that each anime was inserted under, so that its IDs can be erased
+  // without going through every title
+  struct TitleKey {
+    Titles::container_t* container;
+    std::wstring title;
+  };
+  std::unordered_map<int, std::vector<TitleKey>> title_keys_;
+
+  // Titles of an item, normalized for each purpose. Everything except for
+  // trigrams is saved to the index file.
   struct ScoreStore {
+    time_t last_modified = 0;
+    unsigned int checksum = 0;
+    std::vector<unsigned char> title_types;
     std::vector<std::wstring> normal_titles;
+    std::vector<std::wstring> lookup_titles;
+    std::vector<std::wstring> full_titles;
     std::vector<trigram_container_t> trigrams;
   };
   std::map<int, ScoreStore> db_;
-  sorted_scores_t scores_;
+  bool index_modified_ = false;
+  std::atomic<bool> titles_initialized_{false};
+
+  // Held shared while looking up and scoring titles, and exclusively while
+  // the titles are being modified
+  mutable std::shared_mutex titles_mutex_;
+
+  // Identifies the titles of IdentifyBatch in parallel
+  ThreadPool batch_pool_;
+
+  void IndexTitles(const anime::Item& anime_item, bool erase_ids);
+  void InsertTitles(int anime_id, ScoreStore& store);
+  bool LoadIndex(std::map<int, ScoreStore>& stores) const;
+  bool WriteIndex();
+  static unsigned int GetTitleChecksum(const anime::Item& anime_item);
+
+  // Maps each trigram to the titles that contain it, so that we don't have to
+  // compare against every title in the database
+  struct TrigramPosting {
+    int id;
+    unsigned short title_index;
+    unsigned short count;
+  };
+  std::unordered_map<trigram_t, std::vector<TrigramPosting>> trigram_index_;
 };
 
 }  // namespace recognition
@@ -0,0 +1,197 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "library/anime_episode.h"
+#include "track/recognition.h"
+
+namespace track {
+namespace recognition {
+
+// Keeps the results of the most recently recognized inputs. Library scans,
+// folder monitor notifications and feed refreshes keep coming across the same
+// file names, and there's no need to parse and identify them over and over.
+class ResultCache {
+public:
+  struct Result {
+    bool parsed = false;
+    anime::Episode episode;
+  };
+
+  bool Find(const std::wstring& key, unsigned int generation, Result& result);
+  void Insert(const std::wstring& key, unsigned int generation, const Result& result);
+  void Clear();
+
+  static constexpr size_t kCapacity = 2000;
+
+private:
+  struct Entry {
+    std::wstring key;
+    unsigned int generation;
+    Result result;
+  };
+
+  // Most recently used entries are at the front
+  std::list<Entry> entries_;
+  std::unordered_map<std::wstring, std::list<Entry>::iterator> index_;
+};
+
+static ResultCache cache;
+static std::mutex cache_mutex;
+static unsigned int cache_generation = 0;
+static CacheStats cache_stats;
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ResultCache::Find(const std::wstring& key, unsigned int generation,
+                       Result& result) {
+  auto it = index_.find(key);
+  if (it == index_.end())
+    return false;
+
+  if (it->second->generation != generation) {
+    entries_.erase(it->second);
+    index_.erase(it);
+    return false;
+  }
+
+  entries_.splice(entries_.begin(), entries_, it->second);
+  result = it->second->result;
+  return true;
+}
+
+void ResultCache::Insert(const std::wstring& key, unsigned int generation,
+                         const Result& result) {
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    entries_.erase(it->second);
+    index_.erase(it);
+  }
+
+  if (entries_.size() >= kCapacity) {
+    index_.erase(entries_.back().key);
+    entries_.pop_back();
+  }
+
+  entries_.push_front({key, generation, result});
+  index_[key] = entries_.begin();
+}
+
+void ResultCache::Clear() {
+  entries_.clear();
+  index_.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static std::wstring GetCacheKey(const std::wstring& input,
+                                const ParseOptions& parse_options,
+                                const MatchOptions& match_options) {
+  const int options =
+      (parse_options.parse_path ? 0x01 : 0) |
+      (parse_options.streaming_media ? 0x02 : 0) |
+      (match_options.allow_sequels ? 0x04 : 0) |
+      (match_options.check_airing_date ? 0x08 : 0) |
+      (match_options.check_anime_type ? 0x10 : 0) |
+      (match_options.check_episode_number ? 0x20 : 0);
+
+  std::wstring key;
+  key.reserve(input.size() + 1);
+  key.push_back(static_cast<wchar_t>(L'A' + options));
+  key.append(input);
+  return key;
+}
+
+static bool FindResult(const std::wstring& key, unsigned int& generation,
+                       ResultCache::Result& result) {
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  generation = cache_generation;
+  if (cache.Find(key, generation, result)) {
+    ++cache_stats.hits;
+    return true;
+  }
+  ++cache_stats.misses;
+  return false;
+}
+
+static void InsertResult(const std::wstring& key, unsigned int generation,
+                         const ResultCache::Result& result) {
+  // Titles or relations might have changed while we were busy, in which case
+  // the result is not worth keeping
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  if (generation == cache_generation)
+    cache.Insert(key, generation, result);
+}
+
+bool Engine::ParseAndIdentify(const std::wstring& input,
+                              const ParseOptions& parse_options,
+                              const MatchOptions& match_options,
+                              anime::Episode& episode) {
+  const auto key = GetCacheKey(input, parse_options, match_options);
+  ResultCache::Result result;
+  unsigned int generation = 0;
+
+  if (!FindResult(key, generation, result)) {
+    result.parsed = Parse(input, parse_options, result.episode);
+    if (result.parsed)
+      Identify(result.episode, false, match_options);
+    InsertResult(key, generation, result);
+  }
+
+  episode = std::move(result.episode);
+  return result.parsed;
+}
+
+int Engine::IdentifyParsed(const std::wstring& input,
+                           const ParseOptions& parse_options,
+                           const MatchOptions& match_options,
+                           anime::Episode& episode) {
+  const auto key = GetCacheKey(input, parse_options, match_options);
+  ResultCache::Result result;
+  unsigned int generation = 0;
+
+  if (FindResult(key, generation, result) && result.parsed) {
+    episode = std::move(result.episode);
+    return episode.anime_id;
+  }
+
+  const int anime_id = Identify(episode, false, match_options);
+
+  result.parsed = true;
+  result.episode = episode;
+  InsertResult(key, generation, result);
+
+  return anime_id;
+}
+
+void Engine::InvalidateCache() {
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  ++cache_generation;
+  cache.Clear();
+}
+
+CacheStats Engine::GetCacheStats() const {
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  return cache_stats;
+}
+
+}  // namespace recognition
+}  // namespace track
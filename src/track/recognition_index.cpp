@@ -0,0 +1,234 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "base/binary.h"
+#include "base/file.h"
+#include "base/log.h"
+#include "base/string.h"
+#include "library/anime_db.h"
+#include "library/anime_item.h"
+#include "library/anime_util.h"
+#include "taiga/path.h"
+#include "taiga/settings.h"
+#include "track/recognition.h"
+
+namespace track {
+namespace recognition {
+
+// Index file layout:
+//   header: magic, format version, normalization version, wchar_t size,
+//           service ID
+//   entries: ID, last modified time, title checksum, titles
+//   title: type, normalized for trigrams, for lookup, and fully normalized
+
+static const uint32_t kIndexMagic = 0x58444954;  // "TIDX"
+static const uint32_t kIndexFormatVersion = 2;
+
+static void WriteIndexHeader(BinaryWriter& writer) {
+  writer.Write(kIndexMagic);
+  writer.Write(kIndexFormatVersion);
+  writer.Write(static_cast<uint32_t>(Engine::kNormalizationVersion));
+  writer.Write(static_cast<uint32_t>(sizeof(wchar_t)));
+  writer.Write(static_cast<uint32_t>(taiga::GetCurrentServiceId()));
+}
+
+static bool ReadIndexHeader(BinaryReader& reader) {
+  uint32_t magic = 0;
+  uint32_t format_version = 0;
+  uint32_t normalization_version = 0;
+  uint32_t char_size = 0;
+  uint32_t service_id = 0;
+
+  if (!reader.Read(magic) || !reader.Read(format_version) ||
+      !reader.Read(normalization_version) || !reader.Read(char_size) ||
+      !reader.Read(service_id))
+    return false;
+
+  return magic == kIndexMagic &&
+         format_version == kIndexFormatVersion &&
+         normalization_version == Engine::kNormalizationVersion &&
+         char_size == sizeof(wchar_t) &&
+         service_id == static_cast<uint32_t>(taiga::GetCurrentServiceId());
+}
+
+bool Engine::LoadIndex(std::map<int, ScoreStore>& stores) const {
+  const auto path = taiga::GetPath(taiga::Path::DatabaseRecognition);
+  std::string data;
+
+  if (!ReadFromFile(path, data))
+    return false;
+
+  BinaryReader reader(data);
+
+  if (!ReadIndexHeader(reader)) {
+    LOGD(L"Recognition index is outdated.");
+    return false;
+  }
+
+  uint32_t entry_count = 0;
+  if (!reader.Read(entry_count))
+    return false;
+
+  for (uint32_t i = 0; i < entry_count; ++i) {
+    int32_t id = 0;
+    int64_t last_modified = 0;
+    uint32_t checksum = 0;
+    uint32_t title_count = 0;
+
+    if (!reader.Read(id) || !reader.Read(last_modified) ||
+        !reader.Read(checksum) || !reader.Read(title_count))
+      break;
+
+    ScoreStore store;
+    store.last_modified = static_cast<time_t>(last_modified);
+    store.checksum = checksum;
+
+    bool valid = true;
+    for (uint32_t j = 0; j < title_count && valid; ++j) {
+      unsigned char type = 0;
+      std::wstring normal_title, lookup_title, full_title;
+      valid = reader.Read(type) &&
+              reader.ReadString(normal_title) &&
+              reader.ReadString(lookup_title) &&
+              reader.ReadString(full_title);
+      if (valid) {
+        store.title_types.push_back(type);
+        store.normal_titles.push_back(std::move(normal_title));
+        store.lookup_titles.push_back(std::move(lookup_title));
+        store.full_titles.push_back(std::move(full_title));
+      }
+    }
+    if (!valid) {
+      LOGW(L"Recognition index is corrupted.");
+      break;
+    }
+
+    stores[id] = std::move(store);
+  }
+
+  return true;
+}
+
+bool Engine::SaveIndex() {
+  std::unique_lock<std::shared_mutex> lock(titles_mutex_);
+  return WriteIndex();
+}
+
+bool Engine::WriteIndex() {
+  if (!titles_initialized_ || !index_modified_)
+    return true;
+
+  BinaryWriter writer;
+  WriteIndexHeader(writer);
+
+  std::vector<int> ids;
+  for (const auto& it : db_)
+    if (AnimeDatabase.FindItem(it.first, false))
+      ids.push_back(it.first);
+
+  writer.Write(static_cast<uint32_t>(ids.size()));
+
+  for (const auto& id : ids) {
+    const auto& store = db_.at(id);
+    writer.Write(static_cast<int32_t>(id));
+    writer.Write(static_cast<int64_t>(store.last_modified));
+    writer.Write(static_cast<uint32_t>(store.checksum));
+    writer.Write(static_cast<uint32_t>(store.normal_titles.size()));
+    for (size_t i = 0; i < store.normal_titles.size(); ++i) {
+      writer.Write(store.title_types[i]);
+      writer.WriteString(store.normal_titles[i]);
+      writer.WriteString(store.lookup_titles[i]);
+      writer.WriteString(store.full_titles[i]);
+    }
+  }
+
+  const auto path = taiga::GetPath(taiga::Path::DatabaseRecognition);
+
+  if (!SaveToFile(writer.data(), path)) {
+    LOGW(L"Could not save recognition index.");
+    return false;
+  }
+
+  index_modified_ = false;
+  return true;
+}
+
+unsigned int Engine::GetIndexChecksum() const {
+  unsigned int hash = 2166136261u;
+
+  auto add_value = [&hash](unsigned int value) {
+    hash ^= value;
+    hash *= 16777619u;
+  };
+  auto add_string = [&add_value](const std::wstring& str) {
+    for (const auto c : str)
+      add_value(static_cast<unsigned int>(c));
+    add_value(0xFFFFu);  // separator
+  };
+
+  add_value(kNormalizationVersion);
+
+  {
+    std::shared_lock<std::shared_mutex> lock(titles_mutex_);
+    for (const auto& it : db_) {
+      add_value(static_cast<unsigned int>(it.first));
+      add_value(it.second.checksum);
+    }
+  }
+
+  add_value(GetRelationsChecksum());
+
+  // Settings that are used while parsing and identifying
+  add_string(Settings[taiga::kRecognition_IgnoredStrings]);
+  add_value(Settings.GetBool(taiga::kRecognition_LookupParentDirectories));
+  for (const auto& library_folder : Settings.library_folders)
+    add_string(library_folder);
+
+  return hash;
+}
+
+unsigned int Engine::GetTitleChecksum(const anime::Item& anime_item) {
+  // FNV-1a over every string that UpdateTitles depends on. Last modified time
+  // doesn't cover user synonyms, which are not part of the metadata.
+  unsigned int hash = 2166136261u;
+
+  auto add_string = [&hash](const std::wstring& str) {
+    for (const auto c : str) {
+      hash ^= static_cast<unsigned int>(c);
+      hash *= 16777619u;
+    }
+    hash ^= 0xFFFFu;  // separator
+    hash *= 16777619u;
+  };
+
+  add_string(anime_item.GetTitle());
+  add_string(anime_item.GetEnglishTitle());
+  add_string(anime_item.GetJapaneseTitle());
+  add_string(anime::IsValidDate(anime_item.GetDateStart()) ?
+             ToWstr(anime_item.GetDateStart().year()) : EmptyString());
+  for (const auto& synonym : anime_item.GetSynonyms())
+    add_string(synonym);
+  add_string(EmptyString());
+  for (const auto& synonym : anime_item.GetUserSynonyms())
+    add_string(synonym);
+
+  return hash;
+}
+
+}  // namespace recognition
+}  // namespace track
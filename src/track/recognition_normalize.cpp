@@ -17,27 +17,141 @@
 */
 
 #include <algorithm>
+#include <climits>
+#include <cwctype>
 
 #include <utf8proc/utf8proc.h>
 
+#include "base/string.h"
 #include "track/recognition.h"
 
 namespace track {
 namespace recognition {
 
+// Replaces whole words (i.e. strings that are surrounded by word boundaries),
+// giving the same results as applying each rule with ReplaceString in order.
+//
+// Most rules don't occur in a given string, so applying all of them would
+// mostly be wasted work. Rules are looked up in a trie instead, and only the
+// next rule that occurs in the string is applied. As a replacement can create
+// an occurrence of a later rule (e.g. "second season" -> "2nd season" -> "2"),
+// the string is scanned again after each one.
+class WordReplacer {
+public:
+  typedef std::pair<std::wstring, std::wstring> rule_t;
+
+  WordReplacer(const std::vector<rule_t>& rules);
+
+  void Replace(const std::wstring& input, std::wstring& output) const;
+
+private:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  struct Node {
+    std::vector<std::pair<wchar_t, size_t>> children;  // sorted by character
+    std::vector<int> rules;  // rules that end here, in order
+  };
+
+  size_t FindChild(size_t node, wchar_t c) const;
+  int FindNextRule(const std::wstring& str, int first_rule) const;
+
+  std::vector<Node> nodes_;
+  std::vector<rule_t> rules_;
+};
+
+// Same as the boundaries of whole words in ReplaceString
+static inline bool IsWordBoundary(const wchar_t c) {
+  if (c < 0x80) {
+    if (c <= L' ')
+      return c == L' ' || (c >= L'\t' && c <= L'\r');
+    return c < 0x7F &&
+           !(c >= L'0' && c <= L'9') &&
+           !(c >= L'A' && c <= L'Z') &&
+           !(c >= L'a' && c <= L'z');
+  }
+  return iswspace(c) || iswpunct(c);
+}
+
+WordReplacer::WordReplacer(const std::vector<rule_t>& rules)
+    : rules_(rules) {
+  nodes_.resize(1);
+
+  for (size_t i = 0; i < rules.size(); ++i) {
+    size_t node = 0;
+    for (const auto c : rules[i].first) {
+      auto& children = nodes_[node].children;
+      auto it = std::lower_bound(children.begin(), children.end(),
+                                 std::make_pair(c, size_t{0}));
+      if (it == children.end() || it->first != c) {
+        it = children.insert(it, std::make_pair(c, nodes_.size()));
+        nodes_.emplace_back();
+      }
+      node = it->second;
+    }
+    nodes_[node].rules.push_back(static_cast<int>(i));
+  }
+}
+
+size_t WordReplacer::FindChild(size_t node, wchar_t c) const {
+  const auto& children = nodes_[node].children;
+  auto it = std::lower_bound(children.begin(), children.end(),
+                             std::make_pair(c, size_t{0}));
+  return it != children.end() && it->first == c ? it->second : npos;
+}
+
+// Returns the first rule, starting from the given one, whose string occurs
+// anywhere in the given string. Rules that don't occur are no-ops for
+// ReplaceString, so they can be skipped. Occurrences that are not whole words
+// are not skipped here, as ReplaceString decides what counts as one.
+int WordReplacer::FindNextRule(const std::wstring& str, int first_rule) const {
+  int next_rule = INT_MAX;
+
+  for (size_t pos = 0; pos < str.size(); ++pos) {
+    size_t node = 0;
+    for (size_t i = pos; i < str.size(); ++i) {
+      node = FindChild(node, str[i]);
+      if (node == npos)
+        break;
+      const auto& rules = nodes_[node].rules;
+      auto rule = std::lower_bound(rules.begin(), rules.end(), first_rule);
+      if (rule != rules.end() && *rule < next_rule)
+        next_rule = *rule;
+    }
+    if (next_rule == first_rule)
+      break;
+  }
+
+  return next_rule < INT_MAX ? next_rule : -1;
+}
+
+void WordReplacer::Replace(const std::wstring& input,
+                           std::wstring& output) const {
+  output = input;
+
+  for (int rule = FindNextRule(output, 0); rule > -1;
+       rule = FindNextRule(output, rule + 1)) {
+    ReplaceString(output, 0, rules_[rule].first, rules_[rule].second,
+                  true, true);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void Engine::Normalize(std::wstring& title, int type,
                        bool normalized_before) const {
   bool modified_tail = false;
 
   if (!normalized_before) {
+    // Reused between calls to avoid allocations
+    static thread_local std::wstring buffer;
+
     const auto unmodified_title = title;
 
-    ConvertRomanNumbers(title);
-    Transliterate(title);
+    Transliterate(title, buffer);
+    title.swap(buffer);
     NormalizeUnicode(title);  // Title is lower case after this point, due to UTF8PROC_CASEFOLD
-    ConvertOrdinalNumbers(title);
-    ConvertSeasonNumbers(title);
-    EraseUnnecessary(title);
+    ReplaceWords(title, buffer);
+    title.swap(buffer);
     Trim(title);
 
     if (title.size() != unmodified_title.size() &&
@@ -60,70 +174,223 @@ void Engine::Normalize(std::wstring& title, int type,
     while (ReplaceString(title, 0, L"  ", L" ", false, true));
 }
 
-/////////////////////////////////////////////////////////////////////////////////
+void Engine::NormalizeTitle(std::wstring& title) const {
+  Normalize(title, kNormalizeMinimal, false);
+}
 
-void Engine::ConvertOrdinalNumbers(std::wstring& str) const {
-  static const std::vector<std::pair<std::wstring, std::wstring>> ordinals{
-    {L"1st", L"first"}, {L"2nd", L"second"}, {L"3rd", L"third"},
-    {L"4th", L"fourth"}, {L"5th", L"fifth"}, {L"6th", L"sixth"},
-    {L"7th", L"seventh"}, {L"8th", L"eighth"}, {L"9th", L"ninth"},
-  };
+/////////////////////////////////////////////////////////////////////////////////
 
-  for (const auto& ordinal : ordinals)
-    ReplaceString(str, 0, ordinal.second, ordinal.first, true, true);
+void Engine::ReplaceWords(const std::wstring& str, std::wstring& output) const {
+  // Rules are ordered by priority:
+  // - Ordinal numbers come first, so that they can be converted again as a
+  //   part of season numbers (e.g. "second season" -> "2nd season" -> "2")
+  // - Season numbers work considerably faster than regular expressions
+  // - Unnecessary words are erased or replaced with a common form
+  static const WordReplacer replacer({
+    {L"first", L"1st"}, {L"second", L"2nd"}, {L"third", L"3rd"},
+    {L"fourth", L"4th"}, {L"fifth", L"5th"}, {L"sixth", L"6th"},
+    {L"seventh", L"7th"}, {L"eighth", L"8th"}, {L"ninth", L"9th"},
+
+    {L"1st season", L"1"}, {L"season 1", L"1"}, {L"series 1", L"1"}, {L"s1", L"1"},
+    {L"2nd season", L"2"}, {L"season 2", L"2"}, {L"series 2", L"2"}, {L"s2", L"2"},
+    {L"3rd season", L"3"}, {L"season 3", L"3"}, {L"series 3", L"3"}, {L"s3", L"3"},
+    {L"4th season", L"4"}, {L"season 4", L"4"}, {L"series 4", L"4"}, {L"s4", L"4"},
+    {L"5th season", L"5"}, {L"season 5", L"5"}, {L"series 5", L"5"}, {L"s5", L"5"},
+    {L"6th season", L"6"}, {L"season 6", L"6"}, {L"series 6", L"6"}, {L"s6", L"6"},
+
+    {L"&", L"and"},
+    {L"the animation", L""},
+    {L"the", L""},
+    {L"episode", L""},
+    {L"oad", L"ova"},
+    {L"oav", L"ova"},
+    {L"specials", L"sp"},
+    {L"special", L"sp"},
+    {L"(tv)", L""},
+  });
+
+  replacer.Replace(str, output);
 }
 
-void Engine::ConvertRomanNumbers(std::wstring& str) const {
+void Engine::Transliterate(const std::wstring& str,
+                           std::wstring& output) const {
   // We skip 1 and 10 to avoid matching "I" and "X", as they're unlikely to be
   // used as Roman numerals. Any number above "XIII" is rarely used in anime
   // titles, which is why we don't need an actual Roman-to-Arabic number
   // conversion algorithm.
   static const std::vector<std::pair<std::wstring, std::wstring>> numerals{
-    {L"2", L"II"}, {L"3", L"III"}, {L"4", L"IV"}, {L"5", L"V"},
-    {L"6", L"VI"}, {L"7", L"VII"}, {L"8", L"VIII"}, {L"9", L"IX"},
-    {L"11", L"XI"}, {L"12", L"XII"}, {L"13", L"XIII"},
+    {L"II", L"2"}, {L"III", L"3"}, {L"IV", L"4"}, {L"V", L"5"},
+    {L"VI", L"6"}, {L"VII", L"7"}, {L"VIII", L"8"}, {L"IX", L"9"},
+    {L"XI", L"11"}, {L"XII", L"12"}, {L"XIII", L"13"},
   };
 
-  for (const auto& numeral : numerals)
-    ReplaceString(str, 0, numeral.second, numeral.first, true, true);
-}
+  // Romanizations (Hepburn to Wapuro)
+  static const std::vector<std::pair<std::wstring, std::wstring>> romanizations{
+    {L"wa", L"ha"}, {L"e", L"he"}, {L"o", L"wo"},
+  };
 
-void Engine::ConvertSeasonNumbers(std::wstring& str) const {
-  // This works considerably faster than regular expressions.
-  typedef std::vector<std::wstring> season_t;
-  static const std::vector<std::pair<std::wstring, season_t>> values{
-    {L"1", {L"1st season", L"season 1", L"series 1", L"s1"}},
-    {L"2", {L"2nd season", L"season 2", L"series 2", L"s2"}},
-    {L"3", {L"3rd season", L"season 3", L"series 3", L"s3"}},
-    {L"4", {L"4th season", L"season 4", L"series 4", L"s4"}},
-    {L"5", {L"5th season", L"season 5", L"series 5", L"s5"}},
-    {L"6", {L"6th season", L"season 6", L"series 6", L"s6"}},
+  output.clear();
+
+  // Romanizations are matched against the words of the output, as characters
+  // can become (or stop being) word boundaries after being transliterated
+  size_t word_pos = 0;
+  auto end_word = [&]() {
+    const size_t length = output.size() - word_pos;
+    for (const auto& romanization : romanizations) {
+      if (romanization.first.size() == length &&
+          output.compare(word_pos, length, romanization.first) == 0) {
+        output.replace(word_pos, length, romanization.second);
+        break;
+      }
+    }
+  };
+  auto append = [&](const wchar_t c) {
+    if (IsWordBoundary(c)) {
+      end_word();
+      output.push_back(c);
+      word_pos = output.size();
+    } else {
+      output.push_back(c);
+    }
   };
 
-  for (const auto& value : values)
-    for (const auto& season : value.second)
-      ReplaceString(str, 0, season, value.first, true, true);
-}
+  for (size_t i = 0; i < str.size(); ) {
+    // Roman numerals are matched against the words of the original string
+    if ((str[i] == L'I' || str[i] == L'V' || str[i] == L'X') &&
+        (i == 0 || IsWordBoundary(str[i - 1]))) {
+      size_t length = 1;
+      while (i + length < str.size() && !IsWordBoundary(str[i + length]))
+        ++length;
+      auto numeral = std::find_if(numerals.begin(), numerals.end(),
+          [&](const std::pair<std::wstring, std::wstring>& numeral) {
+            return numeral.first.size() == length &&
+                   str.compare(i, length, numeral.first) == 0;
+          });
+      if (numeral != numerals.end()) {
+        output.append(numeral->second);
+        i += length;
+        continue;
+      }
+    }
 
-void Engine::Transliterate(std::wstring& str) const {
-  for (size_t i = 0; i < str.size(); ++i) {
-    auto& c = str[i];
+    const auto c = str[i++];
     switch (c) {
       // Character equivalencies that are not included in UTF8PROC_LUMP
-      case L'@': c = L'a'; break;  // e.g. "iDOLM@STER" (doesn't make a difference for "GJ-bu@" or "Sasami-san@Ganbaranai")
-      case L'\u00D7': c = L'x'; break;  // multiplication sign (e.g. "Tasogare Otome x Amnesia")
-      case L'\uA789': c = L':'; break;  // modifier letter colon (e.g. "Nisekoi:")
+      case L'@': append(L'a'); break;  // e.g. "iDOLM@STER" (doesn't make a difference for "GJ-bu@" or "Sasami-san@Ganbaranai")
+      case L'\u00D7': append(L'x'); break;  // multiplication sign (e.g. "Tasogare Otome x Amnesia")
+      case L'\uA789': append(L':'); break;  // modifier letter colon (e.g. "Nisekoi:")
       // A few common always-equivalent romanizations
-      case L'\u014C': str.replace(i, 1, L"ou"); break;  // latin capital letter o with macron
-      case L'\u014D': str.replace(i, 1, L"ou"); break;  // latin small letter o with macron
-      case L'\u016B': str.replace(i, 1, L"uu"); break;  // latin small letter u with macron
+      case L'\u014C': append(L'o'); append(L'u'); break;  // latin capital letter o with macron
+      case L'\u014D': append(L'o'); append(L'u'); break;  // latin small letter o with macron
+      case L'\u016B': append(L'u'); append(L'u'); break;  // latin small letter u with macron
+      default: append(c); break;
     }
   }
 
-  // Romanizations (Hepburn to Wapuro)
-  ReplaceString(str, 0, L"wa", L"ha", true, true);
-  ReplaceString(str, 0, L"e", L"he", true, true);
-  ReplaceString(str, 0, L"o", L"wo", true, true);
+  end_word();
+}
+
+// Gives the same result as utf8proc_map for ASCII-only strings, where the
+// options come down to stripping control characters and case folding
+static void NormalizeAscii(std::wstring& str) {
+  size_t length = 0;
+
+  for (size_t i = 0; i < str.size(); ++i) {
+    auto c = str[i];
+    if (c >= L'A' && c <= L'Z') {
+      c += L'a' - L'A';
+    } else if (c < 0x20 || c == 0x7F) {
+      switch (c) {
+        case L'\r':
+          if (i + 1 < str.size() && str[i + 1] == L'\n')
+            ++i;  // CRLF counts as a single line break
+          [[fallthrough]];
+        case L'\t':
+        case L'\n':
+        case L'\v':
+        case L'\f':
+          c = L' ';
+          break;
+        default:
+          continue;
+      }
+    }
+    str[length++] = c;
+  }
+
+  str.resize(length);
+}
+
+// Does what utf8proc_map does, without converting the string to and from UTF-8
+static bool NormalizeCodepoints(std::wstring& str, utf8proc_option_t options) {
+  // Reused between calls to avoid allocations
+  static thread_local std::vector<utf8proc_int32_t> buffer;
+  if (buffer.size() < str.size() * 2)
+    buffer.resize(str.size() * 2);
+
+  utf8proc_ssize_t length = 0;
+  int boundclass = UTF8PROC_BOUNDCLASS_START;
+
+  for (size_t i = 0; i < str.size(); ++i) {
+    utf8proc_int32_t uc = str[i];
+    if (sizeof(wchar_t) == 2 && uc >= 0xD800 && uc <= 0xDFFF) {
+      if (uc <= 0xDBFF && i + 1 < str.size() &&
+          str[i + 1] >= 0xDC00 && str[i + 1] <= 0xDFFF) {
+        uc = 0x10000 + ((uc - 0xD800) << 10) + (str[++i] - 0xDC00);
+      } else {
+        uc = 0xFFFD;  // as replaced by WideCharToMultiByte
+      }
+    }
+
+    while (true) {
+      const auto available = static_cast<utf8proc_ssize_t>(buffer.size()) - length;
+      int next_boundclass = boundclass;
+      const auto result = utf8proc_decompose_char(
+          uc, buffer.data() + length, available, options, &next_boundclass);
+      if (result < 0)
+        return false;
+      if (result <= available) {
+        length += result;
+        boundclass = next_boundclass;
+        break;
+      }
+      buffer.resize(buffer.size() * 2 + result);
+    }
+  }
+
+  // Canonical ordering of combining characters, as in utf8proc_decompose
+  for (utf8proc_ssize_t pos = 0; pos < length - 1; ) {
+    const auto class1 = utf8proc_get_property(buffer[pos])->combining_class;
+    const auto class2 = utf8proc_get_property(buffer[pos + 1])->combining_class;
+    if (class1 > class2 && class2 > 0) {
+      std::swap(buffer[pos], buffer[pos + 1]);
+      if (pos > 0) {
+        --pos;
+      } else {
+        ++pos;
+      }
+    } else {
+      ++pos;
+    }
+  }
+
+  length = utf8proc_normalize_utf32(buffer.data(), length, options);
+  if (length < 0)
+    return false;
+
+  str.clear();
+  for (utf8proc_ssize_t i = 0; i < length; ++i) {
+    auto uc = buffer[i];
+    if (sizeof(wchar_t) == 2 && uc > 0xFFFF) {
+      uc -= 0x10000;
+      str.push_back(static_cast<wchar_t>(0xD800 + (uc >> 10)));
+      str.push_back(static_cast<wchar_t>(0xDC00 + (uc & 0x3FF)));
+    } else {
+      str.push_back(static_cast<wchar_t>(uc));
+    }
+  }
+
+  return true;
 }
 
 void Engine::NormalizeUnicode(std::wstring& str) const {
@@ -138,34 +405,19 @@ void Engine::NormalizeUnicode(std::wstring& str) const {
       // Perform unicode case folding for case-insensitive comparison
       UTF8PROC_CASEFOLD;
 
-  char* buffer = nullptr;
-  std::string temp = WstrToStr(str);
-
-  int length = utf8proc_map(
-      reinterpret_cast<const utf8proc_uint8_t*>(temp.data()), temp.length(),
-      reinterpret_cast<utf8proc_uint8_t**>(&buffer),
-      static_cast<utf8proc_option_t>(options));
+  // Conversion to UTF-8 used to stop at the first null character
+  const auto null_pos = str.find(L'\0');
+  if (null_pos != str.npos)
+    str.resize(null_pos);
 
-  if (length >= 0) {
-    temp.assign(buffer, length);
-    str = StrToWstr(temp);
+  // Most titles and filenames are ASCII-only
+  if (std::all_of(str.begin(), str.end(),
+                  [](const wchar_t c) { return c < 0x80; })) {
+    NormalizeAscii(str);
+    return;
   }
 
-  if (buffer)
-    free(buffer);
-}
-
-// TODO: Rename
-void Engine::EraseUnnecessary(std::wstring& str) const {
-  ReplaceString(str, 0, L"&", L"and", true, true);
-  ReplaceString(str, 0, L"the animation", L"", true, true);
-  ReplaceString(str, 0, L"the", L"", true, true);
-  ReplaceString(str, 0, L"episode", L"", true, true);
-  ReplaceString(str, 0, L"oad", L"ova", true, true);
-  ReplaceString(str, 0, L"oav", L"ova", true, true);
-  ReplaceString(str, 0, L"specials", L"sp", true, true);
-  ReplaceString(str, 0, L"special", L"sp", true, true);
-  ReplaceString(str, 0, L"(tv)", L"", true, true);
+  NormalizeCodepoints(str, static_cast<utf8proc_option_t>(options));
 }
 
 void Engine::ErasePunctuation(std::wstring& str, int type,
@@ -16,7 +16,10 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <regex>
+#include <algorithm>
+#include <climits>
+#include <mutex>
+#include <shared_mutex>
 
 #include <semaver/semaver/version.h>
 
@@ -27,133 +30,250 @@
 #include "taiga/settings.h"
 #include "taiga/taiga.h"
 #include "track/recognition.h"
+#include "track/recognition_relations.h"
 
 namespace track {
 namespace recognition {
 
-class Relation {
-public:
-  typedef std::pair<int, int> int_pair_t;
+Relations relations;
+std::shared_mutex relations_mutex;
 
-  void AddRange(int id, int_pair_t r1, int_pair_t r2);
-  bool FindRange(int episode_number, int_pair_t& result) const;
-
-private:
-  struct Range {
-    int id;
-    int_pair_t r0;
-    int_pair_t r1;
-  };
+////////////////////////////////////////////////////////////////////////////////
 
-  std::vector<Range> ranges_;
-};
+void Relations::AddRange(int source_id, int destination_id,
+                         int_pair_t r0, int_pair_t r1) {
+  ranges_.push_back({source_id, destination_id, r0, r1, 0, ranges_.size()});
+}
 
-std::map<int, Relation> relations;
+void Relations::Build() {
+  std::sort(ranges_.begin(), ranges_.end(),
+      [](const Range& a, const Range& b) {
+        if (a.source_id != b.source_id)
+          return a.source_id < b.source_id;
+        if (a.r0.first != b.r0.first)
+          return a.r0.first < b.r0.first;
+        return a.order < b.order;
+      });
+
+  for (size_t i = 0; i < ranges_.size(); ++i) {
+    auto& range = ranges_[i];
+    range.max_last_episode = range.r0.second;
+    if (i > 0 && ranges_[i - 1].source_id == range.source_id)
+      range.max_last_episode = std::max(range.max_last_episode,
+                                        ranges_[i - 1].max_last_episode);
+  }
 
-////////////////////////////////////////////////////////////////////////////////
+  ranges_.shrink_to_fit();
+}
 
-void Relation::AddRange(int id, int_pair_t r1, int_pair_t r2) {
-  ranges_.push_back({id, r1, r2});
-}
-
-bool Relation::FindRange(int episode_number, int_pair_t& result) const {
-  for (const auto& it : ranges_) {
-    int distance = episode_number - it.r0.first;
-    if (distance >= 0) {
-      if (it.r0.second - episode_number >= 0) {
-        int destination = it.r1.first;
-        if (it.r1.first != it.r1.second)
-          destination += distance;
-        if (destination <= it.r1.second) {
-          result.first = it.id;
-          result.second = destination;
-          return true;
-        }
-      }
+bool Relations::FindRange(int source_id, int episode_number,
+                          int_pair_t& result) const {
+  const auto first = std::lower_bound(ranges_.begin(), ranges_.end(), source_id,
+      [](const Range& range, int id) {
+        return range.source_id < id;
+      });
+
+  // First range of the same source that begins after the episode
+  auto it = std::upper_bound(first, ranges_.end(),
+      std::make_pair(source_id, episode_number),
+      [](const std::pair<int, int>& value, const Range& range) {
+        if (value.first != range.source_id)
+          return value.first < range.source_id;
+        return value.second < range.r0.first;
+      });
+
+  const Range* found = nullptr;
+  int found_destination = 0;
+
+  // Ranges may overlap, so we go back until none of the remaining ones can
+  // contain the episode
+  while (it != first) {
+    --it;
+    if (it->max_last_episode < episode_number)
+      break;
+    if (it->r0.second < episode_number)
+      continue;
+    int destination = it->r1.first;
+    if (it->r1.first != it->r1.second)
+      destination += episode_number - it->r0.first;
+    if (destination <= it->r1.second &&
+        (!found || it->order < found->order)) {
+      found = &*it;
+      found_destination = destination;
     }
   }
 
-  return false;
+  if (!found)
+    return false;
+
+  result.first = found->destination_id;
+  result.second = found_destination;
+  return true;
+}
+
+unsigned int Relations::GetChecksum() const {
+  unsigned int hash = 2166136261u;
+
+  auto add_value = [&hash](int value) {
+    hash ^= static_cast<unsigned int>(value);
+    hash *= 16777619u;
+  };
+
+  for (const auto& range : ranges_) {
+    add_value(range.source_id);
+    add_value(range.destination_id);
+    add_value(range.r0.first);
+    add_value(range.r0.second);
+    add_value(range.r1.first);
+    add_value(range.r1.second);
+  }
+
+  return hash;
+}
+
+bool Relations::empty() const {
+  return ranges_.empty();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-static bool ParseRule(const std::wstring& rule) {
-  static std::wstring id_pattern = L"(\\d+|[?~])";
-  static std::wstring episode_pattern = L"(\\d+)(?:-(\\d+|\\?))?";
-  static const std::wregex pattern(
-      id_pattern + L"\\|" + id_pattern + L":" + episode_pattern + L" -> " +
-      id_pattern + L"\\|" + id_pattern + L":" + episode_pattern + L"(!)?");
-
-  std::match_results<std::wstring::const_iterator> match_results;
-
-  if (std::regex_match(rule, match_results, pattern)) {
-    auto get_id = [&](size_t first, size_t second) {
-      switch (taiga::GetCurrentServiceId()) {
-        case sync::kMyAnimeList:
-          return ToInt(match_results[first].str());
-        case sync::kKitsu:
-          return ToInt(match_results[second].str());
-        default:
-          return 0;
-      }
-    };
-
-    auto get_range = [&](size_t first, size_t second) {
-      std::pair<int, int> range;
-      range.first = ToInt(match_results[first].str());
-      if (match_results[second].matched) {
-        if (IsNumericString(match_results[second].str())) {
-          range.second = ToInt(match_results[second].str());
-        } else {
-          range.second = INT_MAX;
-        }
-      } else {
-        range.second = range.first;
-      }
-      return range;
-    };
+// Rules are parsed directly from the UTF-8 document. The grammar is:
+//   rule  = id "|" id ":" range " -> " id "|" id ":" range ["!"]
+//   id    = number | "?" | "~"
+//   range = number ["-" (number | "?")]
 
-    int id0 = get_id(1, 2);
-    if (!id0)
-      return false;
-    auto r0 = get_range(3, 4);
+static bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
 
-    int id1 = get_id(5, 6);
-    if (!id1)
-      id1 = id0;
-    auto r1 = get_range(7, 8);
+static bool ParseNumber(const char*& it, const char* end, int& value) {
+  if (it == end || !IsDigit(*it))
+    return false;
 
-    relations[id0].AddRange(id1, r0, r1);
+  value = 0;
+  for (; it != end && IsDigit(*it); ++it) {
+    const int digit = *it - '0';
+    value = value > (INT_MAX - digit) / 10 ? INT_MAX : value * 10 + digit;
+  }
 
-    if (match_results[9].matched)
-      relations[id1].AddRange(id1, r0, r1);
+  return true;
+}
 
+static bool ParseId(const char*& it, const char* end, int& value) {
+  if (it != end && (*it == '?' || *it == '~')) {
+    value = 0;
+    ++it;
     return true;
   }
-
-  return false;
+  return ParseNumber(it, end, value);
 }
 
-bool Engine::ReadRelations() {
-  std::wstring path = taiga::GetPath(taiga::Path::DatabaseAnimeRelations);
-  std::string document;
+static bool ParseIds(const char*& it, const char* end, int& value) {
+  std::pair<int, int> ids;
 
-  if (!ReadFromFile(path, document)) {
-    LOGW(L"Could not read anime relations data.");
-    Settings.Set(taiga::kRecognition_RelationsLastModified, std::wstring());
+  if (!ParseId(it, end, ids.first) || it == end || *it++ != '|' ||
+      !ParseId(it, end, ids.second))
     return false;
+
+  switch (taiga::GetCurrentServiceId()) {
+    case sync::kMyAnimeList:
+      value = ids.first;
+      break;
+    case sync::kKitsu:
+      value = ids.second;
+      break;
+    default:
+      value = 0;
+      break;
   }
 
-  return ReadRelations(document);
+  return true;
 }
 
-bool Engine::ReadRelations(const std::string& document) {
-  relations.clear();
+static bool ParseRange(const char*& it, const char* end,
+                       std::pair<int, int>& range) {
+  if (!ParseNumber(it, end, range.first))
+    return false;
+
+  range.second = range.first;
+
+  if (it != end && *it == '-') {
+    ++it;
+    if (it != end && *it == '?') {
+      range.second = INT_MAX;
+      ++it;
+    } else if (!ParseNumber(it, end, range.second)) {
+      return false;
+    }
+  }
 
-  std::vector<std::wstring> lines;
-  Split(StrToWstr(document), L"\n", lines);
+  return true;
+}
+
+static bool ParseRule(const char* begin, const char* end,
+                      Relations& relations) {
+  static const std::string separator = " -> ";
+
+  auto it = begin;
+  int id0 = 0;
+  int id1 = 0;
+  std::pair<int, int> r0;
+  std::pair<int, int> r1;
+
+  if (!ParseIds(it, end, id0) || it == end || *it++ != ':' ||
+      !ParseRange(it, end, r0))
+    return false;
 
+  if (static_cast<size_t>(end - it) < separator.size() ||
+      !std::equal(separator.begin(), separator.end(), it))
+    return false;
+  it += separator.size();
+
+  if (!ParseIds(it, end, id1) || it == end || *it++ != ':' ||
+      !ParseRange(it, end, r1))
+    return false;
+
+  const bool is_self_redirection = it != end && *it == '!';
+  if (is_self_redirection)
+    ++it;
+
+  if (it != end)
+    return false;
+
+  if (!id0)
+    return false;
+  if (!id1)
+    id1 = id0;
+
+  relations.AddRange(id0, id1, r0, r1);
+
+  if (is_self_redirection)
+    relations.AddRange(id1, id1, r0, r1);
+
+  return true;
+}
+
+static bool ParseMeta(const char* begin, const char* end,
+                      std::string& name, std::string& value) {
+  auto it = begin;
+  while (it != end && ((*it >= 'a' && *it <= 'z') || *it == '_'))
+    ++it;
+
+  if (it == begin || end - it < 3 || it[0] != ':' || it[1] != ' ')
+    return false;
+
+  // Value can be anything but a line break
+  const auto value_begin = it + 2;
+  if (std::find(value_begin, end, '\r') != end)
+    return false;
+
+  name.assign(begin, it);
+  value.assign(value_begin, end);
+  return true;
+}
+
+void ParseRelations(const std::string& document, Relations& relations,
+                    std::string& last_modified) {
   enum class FileSection {
     Unknown,
     Meta,
@@ -161,19 +281,33 @@ bool Engine::ReadRelations(const std::string& document) {
   };
   auto current_section = FileSection::Unknown;
 
-  for (auto& line : lines) {
-    Trim(line, L"\r ");
+  auto is_trim_char = [](char c) { return c == '\r' || c == ' '; };
+
+  const char* const document_end = document.data() + document.size();
+
+  for (const char* line_begin = document.data(); line_begin < document_end; ) {
+    const char* line_end = std::find(line_begin, document_end, '\n');
+    const char* next_line = line_end + 1;
 
-    if (line.empty())
+    while (line_begin != line_end && is_trim_char(*line_begin))
+      ++line_begin;
+    while (line_end != line_begin && is_trim_char(*(line_end - 1)))
+      --line_end;
+
+    const auto begin = line_begin;
+    const auto end = line_end;
+    line_begin = next_line;
+
+    if (begin == end)
       continue;
-    if (line.front() == L'#')  // comment
+    if (*begin == '#')  // comment
       continue;
 
-    if (StartsWith(line, L"::")) {
-      auto section = line.substr(2);
-      if (section == L"meta") {
+    if (end - begin >= 2 && begin[0] == ':' && begin[1] == ':') {
+      const std::string section(begin + 2, end);
+      if (section == "meta") {
         current_section = FileSection::Meta;
-      } else if (section == L"rules") {
+      } else if (section == "rules") {
         current_section = FileSection::Rules;
       } else {
         current_section = FileSection::Unknown;
@@ -181,56 +315,89 @@ bool Engine::ReadRelations(const std::string& document) {
       continue;
     }
 
+    auto content = begin;
+    while (content != end && (*content == '-' || *content == ' '))
+      ++content;
+
     switch (current_section) {
       case FileSection::Meta: {
-        TrimLeft(line, L"- ");
-        static const std::wregex pattern(L"([a-z_]+): (.+)");
-        std::match_results<std::wstring::const_iterator> match_results;
-        if (std::regex_match(line, match_results, pattern)) {
-          auto name = match_results[1].str();
-          auto value = match_results[2].str();
-          if (name == L"version") {
-            semaver::Version version(WstrToStr(value));
+        std::string name;
+        std::string value;
+        if (ParseMeta(content, end, name, value)) {
+          if (name == "version") {
+            semaver::Version version(value);
             if (version > Taiga.version)
               LOGD(L"Anime relations version is larger than application version.");
-          } else if (name == L"last_modified") {
-            Settings.Set(taiga::kRecognition_RelationsLastModified, value);
+          } else if (name == "last_modified") {
+            last_modified = value;
           }
         }
         break;
       }
       case FileSection::Rules: {
-        TrimLeft(line, L"- ");
-        if (!ParseRule(line))
-          LOGW(L"Could not parse rule: " + line);
+        if (!ParseRule(content, end, relations))
+          LOGW(L"Could not parse rule: " +
+               StrToWstr(std::string(content, end)));
         break;
       }
     }
   }
 
-  return !relations.empty();
+  relations.Build();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool Engine::SearchEpisodeRedirection(
-    int id, const std::pair<int, int>& range,
-    int& destination_id, std::pair<int, int>& destination_range) const {
-
-  auto it = relations.find(id);
+bool Engine::ReadRelations() {
+  std::wstring path = taiga::GetPath(taiga::Path::DatabaseAnimeRelations);
+  std::string document;
 
-  if (it == relations.end())
+  if (!ReadFromFile(path, document)) {
+    LOGW(L"Could not read anime relations data.");
+    Settings.Set(taiga::kRecognition_RelationsLastModified, std::wstring());
     return false;
+  }
 
-  const auto& relation = it->second;
+  return ReadRelations(document);
+}
+
+bool Engine::ReadRelations(const std::string& document) {
+  // Rules are read into a separate container, so that episodes can still be
+  // redirected while we're parsing the file
+  Relations new_relations;
+  std::string last_modified;
+  ParseRelations(document, new_relations, last_modified);
+
+  if (!last_modified.empty())
+    Settings.Set(taiga::kRecognition_RelationsLastModified,
+                 StrToWstr(last_modified));
+
+  bool result = false;
+  {
+    std::unique_lock<std::shared_mutex> lock(relations_mutex);
+    relations = std::move(new_relations);
+    result = !relations.empty();
+  }
+
+  InvalidateCache();
+
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Engine::SearchEpisodeRedirection(
+    int id, const std::pair<int, int>& range,
+    int& destination_id, std::pair<int, int>& destination_range) const {
+  std::shared_lock<std::shared_mutex> lock(relations_mutex);
 
   std::pair<std::pair<int, int>, std::pair<int, int>> results;
 
-  if (!relation.FindRange(range.first, results.first))
+  if (!relations.FindRange(id, range.first, results.first))
     return false;
 
   if (range.first != range.second) {
-    if (!relation.FindRange(range.second, results.second))
+    if (!relations.FindRange(id, range.second, results.second))
       return false;
     if (results.first.first != results.second.first)
       return false;
@@ -243,5 +410,10 @@ bool Engine::SearchEpisodeRedirection(
   return true;
 }
 
+unsigned int Engine::GetRelationsChecksum() const {
+  std::shared_lock<std::shared_mutex> lock(relations_mutex);
+  return relations.GetChecksum();
+}
+
 }  // namespace recognition
 }  // namespace track
\ No newline at end of file
@@ -0,0 +1,60 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace track {
+namespace recognition {
+
+// Episode ranges of every anime are kept in a single vector, sorted by source
+// ID and the first episode number, so that a redirection can be found with a
+// binary search rather than going through each rule.
+class Relations {
+public:
+  typedef std::pair<int, int> int_pair_t;
+
+  void AddRange(int source_id, int destination_id, int_pair_t r0, int_pair_t r1);
+  void Build();
+  bool FindRange(int source_id, int episode_number, int_pair_t& result) const;
+  unsigned int GetChecksum() const;
+  bool empty() const;
+
+private:
+  struct Range {
+    int source_id;
+    int destination_id;
+    int_pair_t r0;
+    int_pair_t r1;
+    int max_last_episode;  // highest r0.second up to here, for the same source
+    size_t order;          // rules that come first in the file take precedence
+  };
+
+  std::vector<Range> ranges_;
+};
+
+// Reads the rules of an anime-relations document. Nothing else is modified,
+// so that the result can be checked before it's used.
+void ParseRelations(const std::string& document, Relations& relations,
+                    std::string& last_modified);
+
+}  // namespace recognition
+}  // namespace track
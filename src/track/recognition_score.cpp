@@ -17,6 +17,9 @@
 */
 
 #include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
 
 #include "base/string.h"
 #include "library/anime_db.h"
@@ -27,12 +30,9 @@
 namespace track {
 namespace recognition {
 
-sorted_scores_t Engine::GetScores() const {
-  return scores_;
-}
-
 int Engine::ScoreTitle(anime::Episode& episode, const std::set<int>& anime_ids,
-                       const MatchOptions& match_options) {
+                       const MatchOptions& match_options,
+                       sorted_scores_t& scores) const {
   scores_t trigram_results;
 
   auto normal_title = episode.anime_title();
@@ -42,7 +42,10 @@ int Engine::ScoreTitle(anime::Episode& episode, const std::set<int>& anime_ids,
   GetTrigrams(normal_title, t1);
 
   auto calculate_trigram_results = [&](int anime_id) {
-    for (const auto& t2 : db_[anime_id].trigrams) {
+    auto it = db_.find(anime_id);
+    if (it == db_.end())
+      return;
+    for (const auto& t2 : it->second.trigrams) {
       double result = CompareTrigrams(t1, t2);
       if (result > 0.1) {
         auto& target = trigram_results[anime_id];
@@ -56,13 +59,93 @@ int Engine::ScoreTitle(anime::Episode& episode, const std::set<int>& anime_ids,
       calculate_trigram_results(id);
     }
   } else {
-    for (const auto& it : AnimeDatabase.items) {
-      if (ValidateOptions(episode, it.second, match_options, false))
-        calculate_trigram_results(it.first);
+    FindTrigramCandidates(t1, trigram_results);
+    for (auto it = trigram_results.begin(); it != trigram_results.end(); ) {
+      if (!ValidateOptions(episode, it->first, match_options, false)) {
+        it = trigram_results.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  return ScoreTitle(normal_title, episode, trigram_results, scores);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Engine::AddToTrigramIndex(int anime_id) {
+  const auto& trigrams = db_[anime_id].trigrams;
+
+  for (size_t i = 0; i < trigrams.size(); ++i) {
+    const auto& t = trigrams[i];
+    // Trigrams are sorted, so equal values are adjacent
+    for (auto it = t.begin(); it != t.end(); ) {
+      auto it_end = std::upper_bound(it, t.end(), *it);
+      TrigramPosting posting;
+      posting.id = anime_id;
+      posting.title_index = static_cast<unsigned short>(i);
+      posting.count = static_cast<unsigned short>(it_end - it);
+      trigram_index_[*it].push_back(posting);
+      it = it_end;
+    }
+  }
+}
+
+void Engine::RemoveFromTrigramIndex(int anime_id) {
+  auto store = db_.find(anime_id);
+  if (store == db_.end())
+    return;
+
+  for (const auto& t : store->second.trigrams) {
+    for (const auto& trigram : t) {
+      auto it = trigram_index_.find(trigram);
+      if (it == trigram_index_.end())
+        continue;  // Already removed via a previous occurrence
+      auto& postings = it->second;
+      postings.erase(std::remove_if(postings.begin(), postings.end(),
+          [&anime_id](const TrigramPosting& posting) {
+            return posting.id == anime_id;
+          }), postings.end());
+      if (postings.empty())
+        trigram_index_.erase(it);
+    }
+  }
+}
+
+void Engine::FindTrigramCandidates(const trigram_container_t& trigrams,
+                                   scores_t& trigram_results) const {
+  // Number of shared trigrams for each (ID, title index) pair. This is the
+  // same value that CompareTrigrams would give us for the intersection.
+  std::unordered_map<unsigned long long, size_t> intersections;
+
+  for (auto it = trigrams.begin(); it != trigrams.end(); ) {
+    auto it_end = std::upper_bound(it, trigrams.end(), *it);
+    const size_t count = it_end - it;
+    auto postings = trigram_index_.find(*it);
+    if (postings != trigram_index_.end()) {
+      for (const auto& posting : postings->second) {
+        const auto key =
+            (static_cast<unsigned long long>(posting.id) << 16) |
+            posting.title_index;
+        intersections[key] += std::min<size_t>(count, posting.count);
+      }
     }
+    it = it_end;
   }
 
-  return ScoreTitle(normal_title, episode, trigram_results);
+  for (const auto& intersection : intersections) {
+    const int id = static_cast<int>(intersection.first >> 16);
+    const size_t title_index = intersection.first & 0xFFFF;
+    const auto& store = db_.at(id);
+    const double result = static_cast<double>(intersection.second) /
+        static_cast<double>(std::max(trigrams.size(),
+                                     store.trigrams[title_index].size()));
+    if (result > 0.1) {
+      auto& target = trigram_results[id];
+      target = std::max(target, result);
+    }
+  }
 }
 
 static double CustomScore(const std::wstring& title, const std::wstring& str) {
@@ -112,47 +195,132 @@ static double BonusScore(const anime::Episode& episode, int id) {
   return score;
 };
 
+// Upper bounds for the individual scores of a title, derived from nothing but
+// string lengths. These are used to skip the expensive calculations for
+// candidates that can't make it into the results.
+struct ScoreBounds {
+  double jaro_winkler = 0.0;
+  double levenshtein = 0.0;
+  double custom = 0.0;
+};
+
+static void UpdateScoreBounds(const std::wstring& title, const std::wstring& str,
+                              ScoreBounds& bounds) {
+  const double length_min = std::min(title.size(), str.size());
+  const double length_max = std::max(title.size(), str.size());
+  const double length_ratio = length_max > 0.0 ? length_min / length_max : 1.0;
+
+  // Jaro distance is at its highest when every character of the shorter
+  // string is matched without transpositions, and the Winkler bonus is at its
+  // highest with a common prefix of 4 characters.
+  double jaro = 1.0;
+  if (!title.empty() && !str.empty())
+    jaro = ((length_min / title.size()) + (length_min / str.size()) + 1.0) / 3.0;
+  const double jaro_winkler = jaro + (4 * 0.1 * (1.0 - jaro));
+
+  // Edit distance can't be lower than the difference in length, and neither
+  // prefix, substring nor subsequence matches can be longer than the shorter
+  // string (see CustomScore).
+  bounds.jaro_winkler = std::max(bounds.jaro_winkler, jaro_winkler);
+  bounds.levenshtein = std::max(bounds.levenshtein, length_ratio);
+  bounds.custom = std::max(bounds.custom, std::max(length_ratio, 0.7));
+}
+
 int Engine::ScoreTitle(const std::wstring& str, const anime::Episode& episode,
-                       const scores_t& trigram_results) {
-  scores_t jaro_winkler, levenshtein, custom, bonus;
+                       const scores_t& trigram_results,
+                       sorted_scores_t& scores) const {
+  const double score_threshold = 0.3;
+  const size_t max_result_count = 20;
+  // Guards against rounding differences between bounds and actual scores
+  const double bound_tolerance = 1e-9;
+
+  // Lowest score among the best results so far. Candidates are processed in
+  // ID order and sorting is stable, so a candidate that can't score higher
+  // than this would not make it into the results.
+  std::priority_queue<double, std::vector<double>, std::greater<double>>
+      best_scores;
 
-  scores_.clear();
+  auto calculate_score = [](double jaro_winkler, double custom,
+                            double levenshtein, double trigram,
+                            double bonus) {
+    return (((1.0 * jaro_winkler) +
+             (0.5 * std::pow(custom, 0.66)) +
+             (0.3 * std::pow(levenshtein, 0.8)) +
+             (0.2 * std::pow(trigram, 0.8))) / 2.0) + bonus;
+  };
+
+  auto can_be_accepted = [&](double score_bound) {
+    score_bound += bound_tolerance;
+    if (score_bound < score_threshold)
+      return false;
+    if (best_scores.size() >= max_result_count &&
+        score_bound <= best_scores.top())
+      return false;
+    return true;
+  };
+
+  scores.clear();
 
   for (const auto& trigram_result : trigram_results) {
-    int id = trigram_result.first;
+    const int id = trigram_result.first;
+    const double trigram = trigram_result.second;
+    const auto& titles = db_.at(id).normal_titles;
 
-    // Calculate individual scores for all titles
-    for (auto& title : db_[id].normal_titles) {
-      jaro_winkler[id] = std::max(jaro_winkler[id], JaroWinklerDistance(title, str));
-      levenshtein[id] = std::max(levenshtein[id], LevenshteinDistance(title, str));
-      custom[id] = std::max(custom[id], CustomScore(title, str));
-    }
-    bonus[id] = BonusScore(episode, id);
+    // Cheap bounds come first
+    ScoreBounds bounds;
+    for (const auto& title : titles)
+      UpdateScoreBounds(title, str, bounds);
+    const double bonus = BonusScore(episode, id);
+
+    if (!can_be_accepted(calculate_score(bounds.jaro_winkler, bounds.custom,
+                                         bounds.levenshtein, trigram, bonus)))
+      continue;
+
+    // Then we calculate the individual scores for all titles, from the
+    // cheapest to the most expensive, and check again after each step
+    double jaro_winkler = 0.0;
+    for (const auto& title : titles)
+      jaro_winkler = std::max(jaro_winkler, JaroWinklerDistance(title, str));
+    if (!can_be_accepted(calculate_score(jaro_winkler, bounds.custom,
+                                         bounds.levenshtein, trigram, bonus)))
+      continue;
+
+    double levenshtein = 0.0;
+    for (const auto& title : titles)
+      levenshtein = std::max(levenshtein, LevenshteinDistance(title, str));
+    if (!can_be_accepted(calculate_score(jaro_winkler, bounds.custom,
+                                         levenshtein, trigram, bonus)))
+      continue;
+
+    double custom = 0.0;
+    for (const auto& title : titles)
+      custom = std::max(custom, CustomScore(title, str));
 
     // Calculate the average score for the ID
-    double score =
-        (((1.0 * jaro_winkler[id]) +
-          (0.5 * std::pow(custom[id], 0.66)) +
-          (0.3 * std::pow(levenshtein[id], 0.8)) +
-          (0.2 * std::pow(trigram_result.second, 0.8))) / 2.0) + bonus[id];
-    if (score >= 0.3)
-      scores_.push_back(std::make_pair(id, score));
+    const double score =
+        calculate_score(jaro_winkler, custom, levenshtein, trigram, bonus);
+    if (score >= score_threshold) {
+      scores.push_back(std::make_pair(id, score));
+      best_scores.push(score);
+      if (best_scores.size() > max_result_count)
+        best_scores.pop();
+    }
   }
 
   // Sort scores in descending order, then limit the results
-  std::stable_sort(scores_.begin(), scores_.end(),
+  std::stable_sort(scores.begin(), scores.end(),
       [&](const std::pair<int, double>& a,
           const std::pair<int, double>& b) {
         return a.second > b.second;
       });
-  if (scores_.size() > 20)
-    scores_.resize(20);
+  if (scores.size() > max_result_count)
+    scores.resize(max_result_count);
 
-  double score_1st = scores_.size() > 0 ? scores_.at(0).second : 0.0;
-  double score_2nd = scores_.size() > 1 ? scores_.at(1).second : 0.0;
+  double score_1st = scores.size() > 0 ? scores.at(0).second : 0.0;
+  double score_2nd = scores.size() > 1 ? scores.at(1).second : 0.0;
 
   if (score_1st >= 1.0 && score_1st != score_2nd)
-    return scores_.front().first;
+    return scores.front().first;
 
   return anime::ID_UNKNOWN;
 }
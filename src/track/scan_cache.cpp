@@ -0,0 +1,337 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <mutex>
+
+#include "base/binary.h"
+#include "base/file.h"
+#include "base/log.h"
+#include "library/anime_db.h"
+#include "library/anime_util.h"
+#include "taiga/path.h"
+#include "taiga/persistence.h"
+#include "taiga/settings.h"
+#include "track/scan_cache.h"
+
+track::ScanCache LibraryScanCache;
+
+namespace track {
+
+// Cache file layout:
+//   header: magic, format version, wchar_t size, service ID
+//   directories: path, last modified time, entries
+//   directory entry: name, is directory, size, last modified time
+//   entries: path, size, last modified time, index checksum, anime ID,
+//            episode count, aired, parse elements (category, value)
+//
+// Anime IDs depend on the active service, and episode ranges are kept in the
+// parse elements.
+
+static const uint32_t kCacheMagic = 0x43534154;  // "TASC"
+static const uint32_t kCacheFormatVersion = 2;
+
+static void WriteCacheHeader(BinaryWriter& writer) {
+  writer.Write(kCacheMagic);
+  writer.Write(kCacheFormatVersion);
+  writer.Write(static_cast<uint32_t>(sizeof(wchar_t)));
+  writer.Write(static_cast<uint32_t>(taiga::GetCurrentServiceId()));
+}
+
+static bool ReadCacheHeader(BinaryReader& reader) {
+  uint32_t magic = 0;
+  uint32_t format_version = 0;
+  uint32_t char_size = 0;
+  uint32_t service_id = 0;
+
+  if (!reader.Read(magic) || !reader.Read(format_version) ||
+      !reader.Read(char_size) || !reader.Read(service_id))
+    return false;
+
+  return magic == kCacheMagic &&
+         format_version == kCacheFormatVersion &&
+         char_size == sizeof(wchar_t) &&
+         service_id == static_cast<uint32_t>(taiga::GetCurrentServiceId());
+}
+
+bool ScanCache::Load() {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+
+  if (loaded_)
+    return true;
+  loaded_ = true;
+
+  const auto path = taiga::GetPath(taiga::Path::DatabaseScanCache);
+  std::string data;
+
+  if (!ReadFromFile(path, data))
+    return false;
+
+  BinaryReader reader(data);
+
+  if (!ReadCacheHeader(reader)) {
+    LOGD(L"Scan cache is outdated.");
+    return false;
+  }
+
+  auto corrupted = [this]() {
+    LOGW(L"Scan cache is corrupted.");
+    directories_.clear();
+    entries_.clear();
+    return false;
+  };
+
+  uint32_t directory_count = 0;
+  if (!reader.Read(directory_count))
+    return corrupted();
+
+  for (uint32_t i = 0; i < directory_count; ++i) {
+    std::wstring directory_path;
+    DirectoryRecord record;
+    uint32_t entry_count = 0;
+
+    if (!reader.ReadString(directory_path) ||
+        !reader.Read(record.last_modified) || !reader.Read(entry_count))
+      return corrupted();
+
+    record.entries.resize(entry_count);
+    for (auto& entry : record.entries) {
+      uint8_t directory = 0;
+      if (!reader.ReadString(entry.name) || !reader.Read(directory) ||
+          !reader.Read(entry.size) || !reader.Read(entry.last_modified))
+        return corrupted();
+      entry.directory = directory != 0;
+    }
+
+    directories_[directory_path] = std::move(record);
+  }
+
+  uint32_t entry_count = 0;
+  if (!reader.Read(entry_count))
+    return corrupted();
+
+  for (uint32_t i = 0; i < entry_count; ++i) {
+    std::wstring entry_path;
+    EntryRecord record;
+    uint32_t index_checksum = 0;
+    int32_t anime_id = 0;
+    int32_t episode_count = 0;
+    uint8_t aired = 0;
+    uint32_t element_count = 0;
+
+    if (!reader.ReadString(entry_path) || !reader.Read(record.size) ||
+        !reader.Read(record.last_modified) || !reader.Read(index_checksum) ||
+        !reader.Read(anime_id) || !reader.Read(episode_count) ||
+        !reader.Read(aired) || !reader.Read(element_count))
+      return corrupted();
+
+    record.index_checksum = index_checksum;
+    record.episode.anime_id = anime_id;
+    record.episode_count = episode_count;
+    record.aired = aired != 0;
+
+    for (uint32_t j = 0; j < element_count; ++j) {
+      uint32_t category = 0;
+      std::wstring value;
+      if (!reader.Read(category) || !reader.ReadString(value))
+        return corrupted();
+      record.episode.elements().insert(
+          static_cast<anitomy::ElementCategory>(category), value);
+    }
+
+    entries_[entry_path] = std::move(record);
+  }
+
+  return true;
+}
+
+bool ScanCache::Save() {
+  BinaryWriter writer;
+
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    if (!modified_)
+      return true;
+
+    WriteCacheHeader(writer);
+
+    writer.Write(static_cast<uint32_t>(directories_.size()));
+    for (const auto& it : directories_) {
+      const auto& record = it.second;
+      writer.WriteString(it.first);
+      writer.Write(record.last_modified);
+      writer.Write(static_cast<uint32_t>(record.entries.size()));
+      for (const auto& entry : record.entries) {
+        writer.WriteString(entry.name);
+        writer.Write(static_cast<uint8_t>(entry.directory));
+        writer.Write(entry.size);
+        writer.Write(entry.last_modified);
+      }
+    }
+
+    writer.Write(static_cast<uint32_t>(entries_.size()));
+    for (const auto& it : entries_) {
+      const auto& record = it.second;
+      writer.WriteString(it.first);
+      writer.Write(record.size);
+      writer.Write(record.last_modified);
+      writer.Write(static_cast<uint32_t>(record.index_checksum));
+      writer.Write(static_cast<int32_t>(record.episode.anime_id));
+      writer.Write(static_cast<int32_t>(record.episode_count));
+      writer.Write(static_cast<uint8_t>(record.aired));
+      writer.Write(static_cast<uint32_t>(record.episode.elements().size()));
+      for (const auto& element : record.episode.elements()) {
+        writer.Write(static_cast<uint32_t>(element.first));
+        writer.WriteString(element.second);
+      }
+    }
+  }
+
+  {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    modified_ = false;
+  }
+
+  const auto path = taiga::GetPath(taiga::Path::DatabaseScanCache);
+  Persistence.Save(path, writer.data());
+
+  return true;
+}
+
+void ScanCache::Clear() {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+
+  directories_.clear();
+  entries_.clear();
+  modified_ = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ScanCache::FindDirectory(const std::wstring& path, int64_t last_modified,
+                              std::vector<DirectoryEntry>& entries) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+
+  auto it = directories_.find(path);
+  if (it == directories_.end() || it->second.last_modified != last_modified)
+    return false;
+
+  entries = it->second.entries;
+  return true;
+}
+
+void ScanCache::UpdateDirectory(const std::wstring& path,
+                                int64_t last_modified,
+                                const std::vector<DirectoryEntry>& entries) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+
+  auto& record = directories_[path];
+
+  // Forget about entries that are gone, along with everything under them
+  for (const auto& previous_entry : record.entries) {
+    auto it = std::find_if(entries.begin(), entries.end(),
+        [&previous_entry](const DirectoryEntry& entry) {
+          return entry.name == previous_entry.name &&
+                 entry.directory == previous_entry.directory;
+        });
+    if (it == entries.end())
+      ErasePath(JoinPath(path, previous_entry.name));
+  }
+
+  record.last_modified = last_modified;
+  record.entries = entries;
+  modified_ = true;
+}
+
+bool ScanCache::FindEntry(const ScanEntry& entry, unsigned int index_checksum,
+                          anime::Episode& episode) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+
+  auto it = entries_.find(entry.path);
+  if (it == entries_.end())
+    return false;
+
+  // Directories are recognized by their names alone, which are a part of
+  // their paths
+  const auto& record = it->second;
+  if (record.index_checksum != index_checksum)
+    return false;
+  if (!entry.directory && (record.size != entry.size ||
+                           record.last_modified != entry.last_modified))
+    return false;
+
+  // Only the anime that the file was identified as is checked, so that changes
+  // to other items don't invalidate the whole cache
+  if (!entry.directory && anime::IsValidId(record.episode.anime_id)) {
+    auto anime_item = AnimeDatabase.FindItem(record.episode.anime_id, false);
+    if (!anime_item ||
+        anime_item->GetEpisodeCount() != record.episode_count ||
+        anime::IsAiredYet(*anime_item) != record.aired)
+      return false;
+  }
+
+  episode = record.episode;
+  return true;
+}
+
+void ScanCache::UpdateEntry(const ScanEntry& entry,
+                            unsigned int index_checksum) {
+  int episode_count = 0;
+  bool aired = false;
+
+  if (!entry.directory && anime::IsValidId(entry.episode.anime_id)) {
+    auto anime_item = AnimeDatabase.FindItem(entry.episode.anime_id, false);
+    if (anime_item) {
+      episode_count = anime_item->GetEpisodeCount();
+      aired = anime::IsAiredYet(*anime_item);
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+
+  auto& record = entries_[entry.path];
+  record.size = entry.size;
+  record.last_modified = entry.last_modified;
+  record.index_checksum = index_checksum;
+  record.episode = entry.episode;
+  record.episode_count = episode_count;
+  record.aired = aired;
+  modified_ = true;
+}
+
+void ScanCache::ErasePath(const std::wstring& path) {
+  directories_.erase(path);
+  entries_.erase(path);
+
+  // Joining an empty name gives us the path with a trailing separator
+  const auto prefix = JoinPath(path, std::wstring());
+
+  auto erase_prefix = [&prefix](auto& records) {
+    auto it = records.lower_bound(prefix);
+    while (it != records.end() &&
+           it->first.compare(0, prefix.size(), prefix) == 0) {
+      it = records.erase(it);
+    }
+  };
+
+  erase_prefix(directories_);
+  erase_prefix(entries_);
+}
+
+}  // namespace track
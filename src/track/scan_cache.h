@@ -0,0 +1,91 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "library/anime_episode.h"
+#include "track/scanner.h"
+
+namespace track {
+
+// Remembers the contents of scanned directories and the recognition results of
+// the entries in them, so that scans of an unchanged library only have to
+// check last modified times.
+//
+// Directory listings are valid as long as the directory's last modified time
+// doesn't change. Files are recognized again if their size or last modified
+// time changes, which is only noticed when their directory is read again (a
+// file that is overwritten in place keeps its previous results until then).
+// Every entry is recognized again if the recognition index checksum changes
+// (e.g. titles, relations or settings were modified). Files that were
+// identified are also recognized again if the episode count or airing state of
+// their anime changes, as results are validated against them. Files that were
+// not identified are cached under the index checksum alone.
+class ScanCache {
+public:
+  bool Load();
+  bool Save();
+  void Clear();
+
+  // Can be called from scanner threads. Entries are validated against the
+  // anime items they were identified as.
+  bool FindDirectory(const std::wstring& path, int64_t last_modified,
+                     std::vector<DirectoryEntry>& entries) const;
+  void UpdateDirectory(const std::wstring& path, int64_t last_modified,
+                       const std::vector<DirectoryEntry>& entries);
+
+  bool FindEntry(const ScanEntry& entry, unsigned int index_checksum,
+                 anime::Episode& episode) const;
+  void UpdateEntry(const ScanEntry& entry, unsigned int index_checksum);
+
+private:
+  struct DirectoryRecord {
+    int64_t last_modified = 0;
+    std::vector<DirectoryEntry> entries;
+  };
+
+  struct EntryRecord {
+    uint64_t size = 0;
+    int64_t last_modified = 0;
+    unsigned int index_checksum = 0;
+    anime::Episode episode;
+    // State of the identified anime at the time, for files
+    int episode_count = 0;
+    bool aired = false;
+  };
+
+  void ErasePath(const std::wstring& path);
+
+  // Sorted by path, so that everything under a directory can be erased at once
+  std::map<std::wstring, DirectoryRecord> directories_;
+  std::map<std::wstring, EntryRecord> entries_;
+
+  bool loaded_ = false;
+  bool modified_ = false;
+  mutable std::shared_mutex mutex_;
+};
+
+}  // namespace track
+
+extern track::ScanCache LibraryScanCache;
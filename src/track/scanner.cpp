@@ -0,0 +1,458 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <windows.h>
+
+#include <windows/win/error.h>
+
+#include "base/file.h"
+#include "base/log.h"
+#include "base/string.h"
+#include "library/anime_util.h"
+#include "track/recognition.h"
+#include "track/scan_cache.h"
+#include "track/scanner.h"
+
+namespace track {
+
+// Recognition results are merged after each batch, which is also when
+// progress is reported and the stop function is checked. If there is a stop
+// function, a batch is recognized as soon as enough entries are found.
+constexpr size_t kRecognitionBatchSize = 512;
+constexpr auto kProgressInterval = std::chrono::milliseconds(100);
+
+static int64_t GetFileTime(const FILETIME& file_time) {
+  return (static_cast<int64_t>(file_time.dwHighDateTime) << 32) |
+         file_time.dwLowDateTime;
+}
+
+static int64_t GetLastModified(const std::wstring& path) {
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (!::GetFileAttributesEx(GetExtendedLengthPath(path).c_str(),
+                             GetFileExInfoStandard, &data))
+    return 0;
+  return GetFileTime(data.ftLastWriteTime);
+}
+
+// Hidden and system files are skipped, as they were by FileSearchHelper
+static bool ReadDirectory(const std::wstring& path,
+                          std::vector<DirectoryEntry>& entries,
+                          std::wstring& error) {
+  // FindExInfoBasic skips short names, and large fetches save round trips on
+  // network drives
+  const std::wstring pattern =
+      AddTrailingSlash(GetExtendedLengthPath(path)) + L"*";
+  WIN32_FIND_DATA data;
+  HANDLE handle = ::FindFirstFileEx(pattern.c_str(), FindExInfoBasic, &data,
+                                    FindExSearchNameMatch, nullptr,
+                                    FIND_FIRST_EX_LARGE_FETCH);
+
+  if (handle == INVALID_HANDLE_VALUE) {
+    error = win::FormatError(GetLastError());
+    TrimRight(error, L"\r\n");
+    return false;
+  }
+
+  do {
+    if (IsSystemFile(data) || IsHiddenFile(data))
+      continue;
+    const int64_t last_modified = GetFileTime(data.ftLastWriteTime);
+    if (IsDirectory(data)) {
+      if (IsValidDirectory(data))
+        entries.push_back({data.cFileName, true, 0, last_modified});
+    } else {
+      const uint64_t size =
+          (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+      entries.push_back({data.cFileName, false, size, last_modified});
+    }
+  } while (::FindNextFile(handle, &data));
+
+  ::FindClose(handle);
+  return true;
+}
+
+std::wstring JoinPath(const std::wstring& root, const std::wstring& name) {
+  return AddTrailingSlash(root) + name;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Scanner::Scan(const std::vector<std::wstring>& roots,
+                   const ScanOptions& options,
+                   std::vector<ScanEntry>& entries) {
+  stopped_ = false;
+  directory_count_ = 0;
+  file_count_ = 0;
+  recognized_count_ = 0;
+  total_count_ = 0;
+  last_report_ = std::chrono::steady_clock::now();
+
+  entries.clear();
+
+  if (roots.empty())
+    return true;
+  if (options.skip_directories && options.skip_files)
+    return true;
+
+  // Titles must be indexed before the checksum is of any use
+  index_checksum_ = 0;
+  if (cache_) {
+    Meow.InitializeTitles();
+    index_checksum_ = Meow.GetIndexChecksum();
+  }
+
+  // Entries that were recognized while walking come first
+  Traverse(roots, options, entries);
+
+  if (!cancelled_ && !stopped_) {
+    std::sort(entries.begin() + recognized_count_, entries.end(), ComparePaths);
+    total_count_ = entries.size();
+    Recognize(entries);
+  }
+
+  entries.resize(recognized_count_);
+  std::sort(entries.begin(), entries.end(), ComparePaths);
+
+  const bool completed = !cancelled_;
+  ReportProgress(true);
+
+  return completed;
+}
+
+void Scanner::Traverse(const std::vector<std::wstring>& roots,
+                       const ScanOptions& options,
+                       std::vector<ScanEntry>& entries) {
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<std::wstring> directories;
+    std::vector<ScanEntry> entries;
+  };
+
+  const size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<WorkQueue> queues(thread_count);
+  std::vector<std::vector<std::wstring>> errors(thread_count);
+
+  // Directories that are either queued or being read. Workers are done when
+  // this drops to zero, as only a directory that is being read can add more.
+  std::atomic<size_t> pending_count{roots.size()};
+  // Directories that are queued, which idle workers wait for
+  std::atomic<size_t> queued_count{roots.size()};
+  // Entries that were found since they were last collected
+  std::atomic<size_t> found_count{0};
+
+  for (size_t i = 0; i < roots.size(); ++i)
+    queues[i % thread_count].directories.push_back(roots[i]);
+
+  auto notify_workers = [this]() {
+    { std::lock_guard<std::mutex> lock(idle_mutex_); }
+    idle_condition_.notify_all();
+  };
+
+  auto pop = [&](size_t index, std::wstring& path) {
+    // Own queue is used as a stack, which keeps the walk mostly depth-first
+    {
+      auto& queue = queues[index];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.directories.empty()) {
+        path = std::move(queue.directories.back());
+        queue.directories.pop_back();
+        --queued_count;
+        return true;
+      }
+    }
+    // Other queues are stolen from the front, where the directories closest to
+    // their roots (and thus with the most work under them) are
+    for (size_t i = 1; i < thread_count; ++i) {
+      auto& queue = queues[(index + i) % thread_count];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.directories.empty()) {
+        path = std::move(queue.directories.front());
+        queue.directories.pop_front();
+        --queued_count;
+        return true;
+      }
+    }
+    return false;
+  };
+
+  auto collect = [&]() {
+    found_count = 0;
+    for (auto& queue : queues) {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      std::move(queue.entries.begin(), queue.entries.end(),
+                std::back_inserter(entries));
+      queue.entries.clear();
+    }
+  };
+
+  // If there is a stop function, entries are recognized on this thread while
+  // the others keep walking, so that the walk can stop as soon as possible
+  auto recognize = [&]() {
+    collect();
+    std::sort(entries.begin() + recognized_count_, entries.end(), ComparePaths);
+    total_count_ = entries.size();
+    if (!Recognize(entries) || cancelled_)
+      notify_workers();
+  };
+
+  auto worker = [&](size_t index) {
+    std::vector<DirectoryEntry> directory_entries;
+    std::wstring path;
+    std::wstring error;
+
+    while (!cancelled_ && !stopped_) {
+      // Progress is reported and entries are recognized only on the thread
+      // that started the scan
+      if (index == 0) {
+        ReportProgress(false);
+        if (stop_function_ && found_count >= kRecognitionBatchSize) {
+          recognize();
+          continue;
+        }
+      }
+
+      if (!pop(index, path)) {
+        if (pending_count == 0)
+          break;
+        std::unique_lock<std::mutex> lock(idle_mutex_);
+        auto has_work = [&]() {
+          return queued_count > 0 || pending_count == 0 ||
+                 cancelled_ || stopped_;
+        };
+        if (index == 0) {
+          idle_condition_.wait_for(lock, kProgressInterval, has_work);
+        } else {
+          idle_condition_.wait(lock, has_work);
+        }
+        continue;
+      }
+
+      directory_entries.clear();
+
+      // A directory's last modified time changes whenever an entry is added,
+      // removed or renamed, so an unchanged directory can be listed from the
+      // cache. Its time is checked before reading, so that changes made while
+      // we're reading are caught next time.
+      const int64_t last_modified = cache_ ? GetLastModified(path) : 0;
+      if (!last_modified || !options.check_directory_times ||
+          !cache_->FindDirectory(path, last_modified, directory_entries)) {
+        if (ReadDirectory(path, directory_entries, error)) {
+          if (last_modified)
+            cache_->UpdateDirectory(path, last_modified, directory_entries);
+        } else {
+          errors[index].push_back(error + L"\nPath: " + path);
+        }
+      }
+
+      // Subdirectories are counted before this directory is done, so that the
+      // pending count can't drop to zero in between
+      bool queued_subdirectories = false;
+      {
+        auto& queue = queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        for (auto& directory_entry : directory_entries) {
+          ScanEntry entry;
+          entry.path = JoinPath(path, directory_entry.name);
+          entry.name = std::move(directory_entry.name);
+          entry.directory = directory_entry.directory;
+          entry.size = directory_entry.size;
+          entry.last_modified = directory_entry.last_modified;
+
+          if (entry.directory) {
+            ++directory_count_;
+            if (!options.skip_subdirectories) {
+              ++pending_count;
+              ++queued_count;
+              queue.directories.push_back(entry.path);
+              queued_subdirectories = true;
+            }
+            if (!options.skip_directories) {
+              queue.entries.push_back(std::move(entry));
+              ++found_count;
+            }
+          } else {
+            if (options.skip_files || entry.size < options.minimum_file_size)
+              continue;
+            ++file_count_;
+            queue.entries.push_back(std::move(entry));
+            ++found_count;
+          }
+        }
+      }
+
+      if (--pending_count == 0 || queued_subdirectories)
+        notify_workers();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_count; ++i)
+    threads.emplace_back(worker, i);
+  worker(0);
+  if (cancelled_ || stopped_)
+    notify_workers();
+  for (auto& thread : threads)
+    thread.join();
+
+  collect();
+
+  for (const auto& worker_errors : errors)
+    for (const auto& error : worker_errors)
+      LOGE(error);
+}
+
+bool Scanner::ComparePaths(const ScanEntry& entry1, const ScanEntry& entry2) {
+  return entry1.path < entry2.path;
+}
+
+bool Scanner::Recognize(std::vector<ScanEntry>& entries) {
+  recognition::ParseOptions directory_parse_options;
+  directory_parse_options.parse_path = false;
+  directory_parse_options.streaming_media = false;
+
+  recognition::MatchOptions directory_match_options;
+  directory_match_options.allow_sequels = false;
+  directory_match_options.check_airing_date = false;
+  directory_match_options.check_anime_type = false;
+  directory_match_options.check_episode_number = false;
+
+  recognition::ParseOptions file_parse_options;
+  file_parse_options.parse_path = true;
+  file_parse_options.streaming_media = false;
+
+  recognition::MatchOptions file_match_options;
+  file_match_options.allow_sequels = true;
+  file_match_options.check_airing_date = true;
+  file_match_options.check_anime_type = true;
+  file_match_options.check_episode_number = true;
+
+  std::vector<size_t> directory_indexes;
+  std::vector<size_t> file_indexes;
+  std::vector<std::wstring> directory_names;
+  std::vector<std::wstring> file_paths;
+
+  for (size_t begin = recognized_count_; begin < entries.size() && !cancelled_;
+       begin += kRecognitionBatchSize) {
+    const size_t end = std::min(begin + kRecognitionBatchSize, entries.size());
+
+    directory_indexes.clear();
+    file_indexes.clear();
+    directory_names.clear();
+    file_paths.clear();
+
+    // Directories are identified by their names, and files by their full paths
+    for (size_t i = begin; i < end; ++i) {
+      if (cache_ &&
+          cache_->FindEntry(entries[i], index_checksum_, entries[i].episode))
+        continue;
+      if (entries[i].directory) {
+        directory_indexes.push_back(i);
+        directory_names.push_back(entries[i].name);
+      } else {
+        file_indexes.push_back(i);
+        file_paths.push_back(entries[i].path);
+      }
+    }
+
+    auto directory_episodes = Meow.IdentifyBatch(
+        directory_names, directory_parse_options, directory_match_options);
+    for (size_t i = 0; i < directory_indexes.size(); ++i)
+      entries[directory_indexes[i]].episode = std::move(directory_episodes[i]);
+
+    auto file_episodes = Meow.IdentifyBatch(
+        file_paths, file_parse_options, file_match_options);
+    for (size_t i = 0; i < file_indexes.size(); ++i)
+      entries[file_indexes[i]].episode = std::move(file_episodes[i]);
+
+    if (cache_) {
+      for (const auto i : directory_indexes)
+        cache_->UpdateEntry(entries[i], index_checksum_);
+      for (const auto i : file_indexes)
+        cache_->UpdateEntry(entries[i], index_checksum_);
+    }
+
+    recognized_count_ = end;
+    ReportProgress(false);
+
+    if (stop_function_ &&
+        std::any_of(entries.begin() + begin, entries.begin() + end,
+                    stop_function_)) {
+      stopped_ = true;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void Scanner::ReportProgress(bool force) {
+  if (!progress_function_)
+    return;
+
+  const auto now = std::chrono::steady_clock::now();
+  if (!force && now - last_report_ < kProgressInterval)
+    return;
+  last_report_ = now;
+
+  ScanProgress progress;
+  progress.directory_count = directory_count_;
+  progress.file_count = file_count_;
+  progress.recognized_count = recognized_count_;
+  progress.total_count = total_count_;
+
+  progress_function_(progress);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Scanner::Cancel() {
+  cancelled_ = true;
+
+  // Wakes up idle workers, so that they can see that the scan is cancelled
+  { std::lock_guard<std::mutex> lock(idle_mutex_); }
+  idle_condition_.notify_all();
+}
+
+void Scanner::Reset() {
+  cancelled_ = false;
+}
+
+bool Scanner::cancelled() const {
+  return cancelled_;
+}
+
+void Scanner::set_progress_function(progress_function_t progress_function) {
+  progress_function_ = progress_function;
+}
+
+void Scanner::set_stop_function(stop_function_t stop_function) {
+  stop_function_ = stop_function;
+}
+
+void Scanner::set_cache(ScanCache* cache) {
+  cache_ = cache;
+}
+
+}  // namespace track
@@ -0,0 +1,136 @@
+/*
+** Taiga
+** Copyright (C) 2010-2017, Eren Okka
+** 
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "library/anime_episode.h"
+
+namespace track {
+
+class ScanCache;
+
+struct ScanOptions {
+  bool skip_directories = false;
+  bool skip_files = false;
+  bool skip_subdirectories = false;
+  uint64_t minimum_file_size = 0;
+  // Directories whose last modified time is unchanged are listed from the
+  // cache. Some file systems (e.g. FAT, exFAT and a few network shares) don't
+  // update these times reliably, so a scan that must not miss any change can
+  // read every directory again.
+  bool check_directory_times = true;
+};
+
+// Last modified times are in native file time units, and are only meant to be
+// compared with each other
+struct DirectoryEntry {
+  std::wstring name;
+  bool directory = false;
+  uint64_t size = 0;
+  int64_t last_modified = 0;
+};
+
+struct ScanEntry {
+  std::wstring path;
+  std::wstring name;
+  bool directory = false;
+  uint64_t size = 0;
+  int64_t last_modified = 0;
+  anime::Episode episode;
+};
+
+struct ScanProgress {
+  size_t directory_count = 0;
+  size_t file_count = 0;
+  size_t recognized_count = 0;
+  size_t total_count = 0;  // Known after all directories are walked
+};
+
+// Walks directory trees with a pool of threads, each of which takes
+// directories from its own queue and steals from the others when it runs out.
+// Entries that were found are then recognized in batches. Nothing is applied
+// to anime items here, so that the caller can merge the results on its own
+// thread.
+class Scanner {
+public:
+  typedef std::function<void(const ScanProgress&)> progress_function_t;
+  typedef std::function<bool(const ScanEntry&)> stop_function_t;
+
+  // Entries are sorted by path, so that the results don't depend on the order
+  // in which directories were walked. If the scan is stopped or cancelled,
+  // only the entries that were recognized are returned. Entries are
+  // recognized while walking if there is a stop function, in which case the
+  // walk can stop early, and the entries that are returned do depend on it.
+  bool Scan(const std::vector<std::wstring>& roots, const ScanOptions& options,
+            std::vector<ScanEntry>& entries);
+
+  // Can be called from any thread. A cancelled scanner stays cancelled until
+  // it's reset, so that a scan can be cancelled before its thread gets to it.
+  void Cancel();
+  void Reset();
+  bool cancelled() const;
+
+  // Both functions are called on the thread that started the scan. The scan
+  // stops after the batch in which an entry satisfies the stop function.
+  void set_progress_function(progress_function_t progress_function);
+  void set_stop_function(stop_function_t stop_function);
+
+  // Directories and files that haven't changed since they were cached are
+  // neither read nor recognized again
+  void set_cache(ScanCache* cache);
+
+private:
+  void Traverse(const std::vector<std::wstring>& roots,
+                const ScanOptions& options, std::vector<ScanEntry>& entries);
+  // Recognizes the entries that follow the ones already recognized, and
+  // returns false if the scan is stopped
+  bool Recognize(std::vector<ScanEntry>& entries);
+  void ReportProgress(bool force);
+
+  static bool ComparePaths(const ScanEntry& entry1, const ScanEntry& entry2);
+
+  std::atomic<bool> cancelled_{false};
+  std::atomic<bool> stopped_{false};
+  std::atomic<size_t> directory_count_{0};
+  std::atomic<size_t> file_count_{0};
+  size_t recognized_count_ = 0;
+  size_t total_count_ = 0;
+  std::chrono::steady_clock::time_point last_report_;
+  unsigned int index_checksum_ = 0;
+
+  // Idle workers wait for directories to be queued, or for the scan to end
+  std::mutex idle_mutex_;
+  std::condition_variable idle_condition_;
+
+  ScanCache* cache_ = nullptr;
+  progress_function_t progress_function_;
+  stop_function_t stop_function_;
+};
+
+std::wstring JoinPath(const std::wstring& root, const std::wstring& name);
+
+}  // namespace track
@@ -16,8 +16,11 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <deque>
+#include <set>
+#include <thread>
+
 #include "base/file.h"
-#include "base/foreach.h"
 #include "base/log.h"
 #include "base/string.h"
 #include "library/anime_db.h"
@@ -25,238 +28,478 @@
 #include "taiga/settings.h"
 #include "taiga/taiga.h"
 #include "track/recognition.h"
+#include "track/scan_cache.h"
 #include "track/search.h"
+#include "ui/dialog.h"
 #include "ui/ui.h"
 
-TaigaFileSearchHelper file_search_helper;
+static track::Scanner library_scanner;
+
+static std::wstring path_found;
 
-TaigaFileSearchHelper::TaigaFileSearchHelper()
-    : anime_id_(anime::ID_UNKNOWN),
-      episode_number_(0) {
+const std::wstring& GetScannedEpisodePath() {
+  return path_found;
 }
 
-bool TaigaFileSearchHelper::OnDirectory(const std::wstring& root,
-                                        const std::wstring& name,
-                                        const WIN32_FIND_DATA& data) {
-  static track::recognition::ParseOptions parse_options;
-  parse_options.parse_path = false;
-  parse_options.streaming_media = false;
+////////////////////////////////////////////////////////////////////////////////
+
+// Doesn't read the anime item, so that it can be called while scanning
+static bool GetEpisodeBounds(const track::ScanEntry& entry, int episode_count,
+                             int& lower_bound, int& upper_bound,
+                             bool log_errors) {
+  const auto& episode = entry.episode;
+
+  if (!Meow.IsValidAnimeType(episode) || !Meow.IsValidFileExtension(episode))
+    return false;
+
+  upper_bound = anime::GetEpisodeHigh(episode);
+  lower_bound = anime::GetEpisodeLow(episode);
 
-  if (!Meow.Parse(name, parse_options, episode_)) {
-    LOGD(L"Could not parse directory: " + name);
+  if (!anime::IsValidEpisodeNumber(upper_bound, episode_count) ||
+      !anime::IsValidEpisodeNumber(lower_bound, episode_count)) {
+    if (log_errors) {
+      std::wstring episode_number = anime::GetEpisodeRange(episode);
+      LOGD(L"Invalid episode number: " + episode_number + L"\n"
+           L"File: " + entry.path);
+    }
     return false;
   }
 
-  static track::recognition::MatchOptions match_options;
-  match_options.allow_sequels = false;
-  match_options.check_airing_date = false;
-  match_options.check_anime_type = false;
-  match_options.check_episode_number = false;
+  return true;
+}
+
+static anime::Item* FindEpisodeItem(const track::ScanEntry& entry,
+                                    int& lower_bound, int& upper_bound,
+                                    bool log_errors) {
+  anime::Item* anime_item = AnimeDatabase.FindItem(entry.episode.anime_id);
+
+  if (!anime_item ||
+      !GetEpisodeBounds(entry, anime_item->GetEpisodeCount(),
+                        lower_bound, upper_bound, log_errors))
+    return nullptr;
+
+  return anime_item;
+}
+
+static bool IsEpisodeFound(const track::ScanEntry& entry, int anime_id,
+                           int episode_number, int episode_count) {
+  if (entry.directory || episode_number <= 0 ||
+      entry.episode.anime_id != anime_id)
+    return false;
+
+  int lower_bound = 0;
+  int upper_bound = 0;
 
-  Meow.Identify(episode_, false, match_options);
+  return GetEpisodeBounds(entry, episode_count, lower_bound, upper_bound,
+                          false) &&
+         episode_number >= lower_bound && episode_number <= upper_bound;
+}
 
-  anime::Item* anime_item = AnimeDatabase.FindItem(episode_.anime_id);
+static bool ApplyDirectory(const track::ScanEntry& entry, int anime_id) {
+  anime::Item* anime_item = AnimeDatabase.FindItem(entry.episode.anime_id);
 
-  if (anime_item && Meow.IsValidAnimeType(episode_)) {
+  if (anime_item && Meow.IsValidAnimeType(entry.episode)) {
     if (anime_item->GetFolder().empty())
-      anime_item->SetFolder(AddTrailingSlash(root) + name);
+      anime_item->SetFolder(entry.path);
+
+    if (anime::IsValidId(anime_id) && anime_id == anime_item->GetId())
+      path_found = entry.path;
+  }
+
+  return false;
+}
 
-    if (anime::IsValidId(anime_id_) && anime_id_ == anime_item->GetId()) {
-      path_found_ = AddTrailingSlash(root) + name;
-      if (skip_files_)
-        return true;
+static bool ApplyFile(const track::ScanEntry& entry,
+                      int anime_id, int episode_number) {
+  int lower_bound = 0;
+  int upper_bound = 0;
+  auto anime_item = FindEpisodeItem(entry, lower_bound, upper_bound, true);
+
+  if (!anime_item)
+    return false;
+
+  for (int i = lower_bound; i <= upper_bound; ++i)
+    anime_item->SetEpisodeAvailability(i, true, entry.path);
+
+  if (anime::IsValidId(anime_id) && anime_id == anime_item->GetId()) {
+    // Check if we've found the episode we were looking for
+    if (episode_number > 0 &&
+        episode_number >= lower_bound && episode_number <= upper_bound) {
+      path_found = entry.path;
+      return true;
+    }
+    // Check if all episodes are available
+    if (episode_number == 0 && IsAllEpisodesAvailable(*anime_item)) {
+      return true;
     }
   }
 
   return false;
 }
 
-bool TaigaFileSearchHelper::OnFile(const std::wstring& root,
-                                   const std::wstring& name,
-                                   const WIN32_FIND_DATA& data) {
-  auto path = AddTrailingSlash(root) + name;
+////////////////////////////////////////////////////////////////////////////////
 
-  static track::recognition::ParseOptions parse_options;
-  parse_options.parse_path = true;
-  parse_options.streaming_media = false;
+namespace {
+
+// A full scan looks for the episode in the anime folder first, then in the
+// folder of the next episode, and then in library folders. Each stage is
+// scanned on its own, as the results of one decide whether the next is needed.
+enum class ScanStage {
+  AnimeFolder,
+  NextEpisodeFolder,
+  LibraryFolders,
+  Finished,
+};
+
+struct ScanRequest {
+  bool silent = true;
+  bool quick = false;
+  int anime_id = anime::ID_UNKNOWN;
+  int episode_number = 0;
+  bool check_directory_times = true;
+  scan_callback_t on_finished;
+};
+
+}  // namespace
+
+// The first request is the one in progress, if scanning is set
+static std::deque<ScanRequest> scan_requests;
+static bool scanning = false;
+static ScanStage scan_stage = ScanStage::Finished;
+static bool scan_found = false;
+
+// Entries are only accessed by the thread while it's running, and by the main
+// thread once it's joined
+static std::thread scan_thread;
+static std::vector<track::ScanEntry> scan_entries;
+
+static track::ScanOptions GetScanOptions(bool skip_directories,
+                                         bool skip_subdirectories,
+                                         bool check_directory_times) {
+  track::ScanOptions options;
+  options.skip_directories = skip_directories;
+  options.skip_files = false;
+  options.skip_subdirectories = skip_subdirectories;
+  options.check_directory_times = check_directory_times;
+  options.minimum_file_size =
+      Settings.GetInt(taiga::kLibrary_FileSizeThreshold);
+  return options;
+}
 
-  if (!Meow.Parse(path, parse_options, episode_)) {
-    LOGD(L"Could not parse filename: " + name);
-    return false;
+// Walks and recognizes on another thread, so that the main window stays
+// responsive. Anime items are only changed once the results are posted back.
+static void StartSearch(const std::vector<std::wstring>& roots,
+                        const track::ScanOptions& options) {
+  const auto& request = scan_requests.front();
+
+  // The episode count is read here, as the stop function is called on the
+  // scanning thread
+  const auto anime_item = AnimeDatabase.FindItem(request.anime_id);
+  if (anime_item && request.episode_number > 0) {
+    const int anime_id = request.anime_id;
+    const int episode_number = request.episode_number;
+    const int episode_count = anime_item->GetEpisodeCount();
+    library_scanner.set_stop_function(
+        [anime_id, episode_number, episode_count](const track::ScanEntry& entry) {
+          return IsEpisodeFound(entry, anime_id, episode_number, episode_count);
+        });
+  } else {
+    library_scanner.set_stop_function(nullptr);
   }
 
-  static track::recognition::MatchOptions match_options;
-  match_options.allow_sequels = true;
-  match_options.check_airing_date = true;
-  match_options.check_anime_type = true;
-  match_options.check_episode_number = true;
+  const HWND hwnd = ui::GetWindowHandle(ui::Dialog::Main);
+  if (request.silent) {
+    library_scanner.set_progress_function(nullptr);
+  } else {
+    library_scanner.set_progress_function(
+        [hwnd](const track::ScanProgress& progress) {
+          ::PostMessage(hwnd, WM_SCANPROGRESS, progress.recognized_count,
+                        progress.total_count);
+        });
+  }
 
-  Meow.Identify(episode_, false, match_options);
+  LibraryScanCache.Load();
+  library_scanner.set_cache(&LibraryScanCache);
 
-  anime::Item* anime_item = AnimeDatabase.FindItem(episode_.anime_id);
+  scan_entries.clear();
+  scan_thread = std::thread([roots, options, hwnd]() {
+    library_scanner.Scan(roots, options, scan_entries);
+    ::PostMessage(hwnd, WM_SCANFINISHED, 0, 0);
+  });
+}
 
-  if (anime_item && Meow.IsValidAnimeType(episode_) &&
-                    Meow.IsValidFileExtension(episode_)) {
-    int upper_bound = anime::GetEpisodeHigh(episode_);
-    int lower_bound = anime::GetEpisodeLow(episode_);
+// Applies the results to anime items in a single pass. Returns true if the
+// episode that we were looking for was found, in which case the remaining
+// entries are skipped.
+static bool ApplySearchResults(const std::vector<track::ScanEntry>& entries) {
+  const auto& request = scan_requests.front();
+
+  for (const auto& entry : entries) {
+    if (entry.directory ?
+            ApplyDirectory(entry, request.anime_id) :
+            ApplyFile(entry, request.anime_id, request.episode_number))
+      return true;
+  }
 
-    if (!anime::IsValidEpisodeNumber(upper_bound, anime_item->GetEpisodeCount()) ||
-        !anime::IsValidEpisodeNumber(lower_bound, anime_item->GetEpisodeCount())) {
-      std::wstring episode_number = anime::GetEpisodeRange(episode_);
-      LOGD(L"Invalid episode number: " + episode_number + L"\n"
-           L"File: " + path);
+  return false;
+}
+
+// Returns false if there is nothing to search at this stage
+static bool GetSearchRoots(const ScanRequest& request, ScanStage stage,
+                           std::vector<std::wstring>& roots,
+                           track::ScanOptions& options) {
+  auto anime_item = AnimeDatabase.FindItem(request.anime_id);
+
+  if (request.quick) {
+    if (stage != ScanStage::AnimeFolder)
       return false;
+    // Anime folders are scanned together, so that they can be walked in
+    // parallel. Folders that are shared by several anime are scanned once.
+    std::set<std::wstring> folders;
+    for (const auto& pair : AnimeDatabase.items) {
+      const anime::Item& item = pair.second;
+      if (request.anime_id != anime::ID_UNKNOWN &&
+          item.GetId() != request.anime_id)
+        continue;
+      if (item.GetFolder().empty())
+        continue;
+      if (!FolderExists(item.GetFolder()))
+        continue;
+      folders.insert(item.GetFolder());
     }
+    roots.assign(folders.begin(), folders.end());
+    options = GetScanOptions(true, false, true);
+    return !roots.empty();
+  }
 
-    for (int i = lower_bound; i <= upper_bound; ++i)
-      anime_item->SetEpisodeAvailability(i, true, path);
+  switch (stage) {
+    // Search the anime folder for available episodes
+    case ScanStage::AnimeFolder:
+      if (!anime_item || anime_item->GetFolder().empty())
+        return false;
+      roots.push_back(anime_item->GetFolder());
+      options = GetScanOptions(true, false, request.check_directory_times);
+      return true;
 
-    if (anime::IsValidId(anime_id_) && anime_id_ == anime_item->GetId()) {
-      // Check if we've found the episode we were looking for
-      if (episode_number_ > 0 &&
-          episode_number_ >= lower_bound && episode_number_ <= upper_bound) {
-        path_found_ = path;
-        return true;
-      }
-      // Check if all episodes are available
-      if (episode_number_ == 0 &&
-          IsAllEpisodesAvailable(*anime_item)) {
-        return true;
+    // Search the cached episode path
+    case ScanStage::NextEpisodeFolder: {
+      if (!anime_item || anime_item->GetNextEpisodePath().empty())
+        return false;
+      std::wstring next_episode_path =
+          GetPathOnly(anime_item->GetNextEpisodePath());
+      if (IsEqual(next_episode_path, anime_item->GetFolder()))
+        return false;
+      roots.push_back(next_episode_path);
+      options = GetScanOptions(true, true, request.check_directory_times);
+      return true;
+    }
+
+    // Search library folders for available episodes
+    case ScanStage::LibraryFolders: {
+      for (const auto& folder : Settings.library_folders) {
+        if (FolderExists(folder))  // Might be a disconnected external drive
+          roots.push_back(folder);
       }
+      bool skip_directories = false;
+      if (anime_item && !anime_item->GetFolder().empty())
+        skip_directories = true;
+      options = GetScanOptions(skip_directories, false,
+                               request.check_directory_times);
+      return !roots.empty();
     }
   }
 
   return false;
 }
 
-////////////////////////////////////////////////////////////////////////////////
+static void FinishScan();
+
+// Starts the search for the next stage that applies, or finishes the scan if
+// there is none left
+static void ContinueScan() {
+  while (scan_stage != ScanStage::Finished && !scan_found &&
+         !library_scanner.cancelled()) {
+    const auto stage = scan_stage;
+    scan_stage = static_cast<ScanStage>(static_cast<int>(stage) + 1);
+
+    std::vector<std::wstring> roots;
+    track::ScanOptions options;
+    if (GetSearchRoots(scan_requests.front(), stage, roots, options)) {
+      StartSearch(roots, options);
+      return;
+    }
+  }
 
-const std::wstring& TaigaFileSearchHelper::path_found() const {
-  return path_found_;
+  FinishScan();
 }
 
-void TaigaFileSearchHelper::set_anime_id(int anime_id) {
-  anime_id_ = anime_id;
+static void StartScan() {
+  const auto& request = scan_requests.front();
+
+  scanning = true;
+  scan_stage = ScanStage::AnimeFolder;
+  scan_found = false;
+  library_scanner.Reset();
+  path_found.clear();
+
+  if (!request.silent) {
+    ui::taskbar_list.SetProgressState(TBPF_INDETERMINATE);
+    ui::SetSharedCursor(IDC_APPSTARTING);
+    ui::ChangeStatusText(L"Scanning available episodes... "
+                         L"(Press Esc to cancel)");
+  }
+
+  // Check if the anime folder still exists
+  auto anime_item = AnimeDatabase.FindItem(request.anime_id);
+  if (anime_item && !request.quick)
+    anime::ValidateFolder(*anime_item);
+
+  ContinueScan();
 }
 
-void TaigaFileSearchHelper::set_episode_number(int episode_number) {
-  episode_number_ = episode_number;
+static void FinishScan() {
+  auto request = std::move(scan_requests.front());
+  scan_requests.pop_front();
+  scanning = false;
+
+  if (!request.silent) {
+    ui::taskbar_list.SetProgressState(TBPF_NOPROGRESS);
+    ui::SetSharedCursor(IDC_ARROW);
+    if (library_scanner.cancelled()) {
+      ui::ChangeStatusText(L"Scanning available episodes was cancelled.");
+    } else {
+      ui::ClearStatusText();
+    }
+  }
+
+  ui::OnScanAvailableEpisodesFinished();
+
+  if (request.on_finished)
+    request.on_finished();
+
+  // The callback might have started another scan already
+  if (!scanning && !scan_requests.empty())
+    StartScan();
 }
 
-void TaigaFileSearchHelper::set_path_found(const std::wstring& path_found) {
-  path_found_ = path_found;
+static void RequestScan(ScanRequest request) {
+  // Periodic scans don't need to pile up behind a long one
+  if (!request.on_finished) {
+    for (size_t i = scanning ? 1 : 0; i < scan_requests.size(); ++i) {
+      const auto& pending_request = scan_requests[i];
+      if (!pending_request.on_finished &&
+          pending_request.silent == request.silent &&
+          pending_request.quick == request.quick &&
+          pending_request.anime_id == request.anime_id &&
+          pending_request.episode_number == request.episode_number &&
+          pending_request.check_directory_times ==
+              request.check_directory_times)
+        return;
+    }
+  }
+
+  scan_requests.push_back(std::move(request));
+
+  if (!scanning)
+    StartScan();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
+static void ScanAvailableEpisodes(bool silent, int anime_id,
+                                  int episode_number,
+                                  bool check_directory_times,
+                                  scan_callback_t on_finished);
+
 void ScanAvailableEpisodes(bool silent) {
   for (auto& pair : AnimeDatabase.items) {
     anime::ValidateFolder(pair.second);
   }
 
-  ScanAvailableEpisodes(silent, anime::ID_UNKNOWN, 0);
+  // A full scan that is started by the user reads every directory again, as
+  // last modified times can't be trusted on every file system
+  ScanAvailableEpisodes(silent, anime::ID_UNKNOWN, 0, silent, nullptr);
 }
 
-void ScanAvailableEpisodes(bool silent, int anime_id, int episode_number) {
+void ScanAvailableEpisodes(bool silent, int anime_id, int episode_number,
+                           scan_callback_t on_finished) {
+  ScanAvailableEpisodes(silent, anime_id, episode_number, true, on_finished);
+}
+
+static void ScanAvailableEpisodes(bool silent, int anime_id,
+                                  int episode_number,
+                                  bool check_directory_times,
+                                  scan_callback_t on_finished) {
   // Check if any library folder is available
   if (!silent && Settings.library_folders.empty()) {
     ui::OnSettingsLibraryFoldersEmpty();
+    if (on_finished)
+      on_finished();
     return;
   }
 
-  if (!silent) {
-    ui::taskbar_list.SetProgressState(TBPF_INDETERMINATE);
-    ui::SetSharedCursor(IDC_WAIT);
-    ui::ChangeStatusText(L"Scanning available episodes...");
-  }
+  ScanRequest request;
+  request.silent = silent;
+  request.anime_id = anime_id;
+  request.episode_number = episode_number;
+  request.check_directory_times = check_directory_times;
+  request.on_finished = on_finished;
+  RequestScan(std::move(request));
+}
 
-  file_search_helper.set_anime_id(anime_id);
-  file_search_helper.set_episode_number(episode_number);
-  // Casting file size threshold to int shouldn't be a problem, as the value
-  // is never supposed to exceed INT_MAX (i.e. ~2GB).
-  file_search_helper.set_minimum_file_size(
-      Settings.GetInt(taiga::kLibrary_FileSizeThreshold));
-  file_search_helper.set_path_found(L"");
+void ScanAvailableEpisodesQuick() {
+  ScanAvailableEpisodesQuick(anime::ID_UNKNOWN);
+}
 
-  auto anime_item = AnimeDatabase.FindItem(anime_id);
-  bool found = false;
+void ScanAvailableEpisodesQuick(int anime_id, scan_callback_t on_finished) {
+  ScanRequest request;
+  request.quick = true;
+  request.anime_id = anime_id;
+  request.on_finished = on_finished;
+  RequestScan(std::move(request));
+}
 
-  if (anime_item) {
-    // Check if the anime folder still exists
-    anime::ValidateFolder(*anime_item);
+bool CancelScanAvailableEpisodes() {
+  if (!scanning || scan_requests.front().silent)
+    return false;
 
-    // Search the anime folder for available episodes
-    if (!anime_item->GetFolder().empty()) {
-      file_search_helper.set_skip_directories(true);
-      file_search_helper.set_skip_files(false);
-      file_search_helper.set_skip_subdirectories(false);
-      found = file_search_helper.Search(anime_item->GetFolder());
-    }
+  library_scanner.Cancel();
+  return true;
+}
 
-    // Search the cached episode path
-    if (!found && !anime_item->GetNextEpisodePath().empty()) {
-      std::wstring next_episode_path = GetPathOnly(anime_item->GetNextEpisodePath());
-      if (!IsEqual(next_episode_path, anime_item->GetFolder())) {
-        file_search_helper.set_skip_directories(true);
-        file_search_helper.set_skip_files(false);
-        file_search_helper.set_skip_subdirectories(true);
-        found = file_search_helper.Search(next_episode_path);
-      }
-    }
-  }
+void ShutdownScanAvailableEpisodes() {
+  scan_requests.clear();
+  scanning = false;
 
-  if (!found) {
-    // Search library folders for available episodes
-    for (const auto& folder : Settings.library_folders) {
-      if (!FolderExists(folder))
-        continue;  // Might be a disconnected external drive
-      bool skip_directories = false;
-      if (anime_item && !anime_item->GetFolder().empty())
-        skip_directories = true;
-      file_search_helper.set_skip_directories(skip_directories);
-      file_search_helper.set_skip_files(false);
-      file_search_helper.set_skip_subdirectories(false);
-      if (file_search_helper.Search(folder)) {
-        found = true;
-        break;
-      }
-    }
+  if (scan_thread.joinable()) {
+    library_scanner.Cancel();
+    scan_thread.join();
+    LibraryScanCache.Save();
   }
+}
 
-  if (!silent) {
-    ui::taskbar_list.SetProgressState(TBPF_NOPROGRESS);
-    ui::SetSharedCursor(IDC_ARROW);
-    ui::ClearStatusText();
-  }
+void OnScanAvailableEpisodesProgress(size_t recognized_count,
+                                     size_t total_count) {
+  if (!scanning || scan_requests.front().silent)
+    return;
 
-  ui::OnScanAvailableEpisodesFinished();
+  if (total_count > 0) {
+    ui::taskbar_list.SetProgressState(TBPF_NORMAL);
+    ui::taskbar_list.SetProgressValue(recognized_count, total_count);
+  }
 }
 
-void ScanAvailableEpisodesQuick() {
-  ScanAvailableEpisodesQuick(anime::ID_UNKNOWN);
-}
+void OnScanAvailableEpisodesResults() {
+  // The scan might have been shut down after the message was posted
+  if (!scan_thread.joinable())
+    return;
 
-void ScanAvailableEpisodesQuick(int anime_id) {
-  foreach_r_(it, AnimeDatabase.items) {
-    anime::Item& anime_item = it->second;
-
-    if (anime_id != anime::ID_UNKNOWN && anime_item.GetId() != anime_id)
-      continue;
-    if (anime_item.GetFolder().empty())
-      continue;
-    if (!FolderExists(anime_item.GetFolder()))
-      continue;
-
-    file_search_helper.set_anime_id(anime_item.GetId());
-    file_search_helper.set_episode_number(0);
-    file_search_helper.set_minimum_file_size(
-        Settings.GetInt(taiga::kLibrary_FileSizeThreshold));
-    file_search_helper.set_skip_directories(true);
-    file_search_helper.set_skip_files(false);
-    file_search_helper.set_skip_subdirectories(false);
-
-    file_search_helper.Search(anime_item.GetFolder());
-  }
+  scan_thread.join();
+  LibraryScanCache.Save();
 
-  ui::OnScanAvailableEpisodesFinished();
-}
\ No newline at end of file
+  if (ApplySearchResults(scan_entries))
+    scan_found = true;
+  scan_entries.clear();
+
+  ContinueScan();
+}
@@ -18,35 +18,39 @@
 
 #pragma once
 
+#include <functional>
 #include <string>
 
-#include "base/file.h"
-#include "library/anime_episode.h"
+#include "track/scanner.h"
 
-class TaigaFileSearchHelper : public FileSearchHelper {
-public:
-  TaigaFileSearchHelper();
-  ~TaigaFileSearchHelper() {}
+// Posted to the main window by the thread that runs the scan
+#define WM_SCANPROGRESS (WM_APP + 0x33)
+#define WM_SCANFINISHED (WM_APP + 0x34)
 
-  bool OnDirectory(const std::wstring& root, const std::wstring& name, const WIN32_FIND_DATA& data);
-  bool OnFile(const std::wstring& root, const std::wstring& name, const WIN32_FIND_DATA& data);
+// Path of the episode that was found by the last scan for a specific episode
+const std::wstring& GetScannedEpisodePath();
 
-  const std::wstring& path_found() const;
-
-  void set_anime_id(int anime_id);
-  void set_episode_number(int episode_number);
-  void set_path_found(const std::wstring& path_found);
-
-private:
-  int anime_id_;
-  anime::Episode episode_;
-  int episode_number_;
-  std::wstring path_found_;
-};
-
-extern TaigaFileSearchHelper file_search_helper;
+// Folders are scanned on a background thread, and the results are applied to
+// anime items on the main thread. Scans that are requested while another one
+// is in progress are started after it. on_finished is called on the main
+// thread once the results are applied, or right away if the scan can't start.
+typedef std::function<void()> scan_callback_t;
 
 void ScanAvailableEpisodes(bool silent);
-void ScanAvailableEpisodes(bool silent, int anime_id, int episode_number);
+void ScanAvailableEpisodes(bool silent, int anime_id, int episode_number,
+                           scan_callback_t on_finished = nullptr);
 void ScanAvailableEpisodesQuick();
-void ScanAvailableEpisodesQuick(int anime_id);
+void ScanAvailableEpisodesQuick(int anime_id,
+                                scan_callback_t on_finished = nullptr);
+
+// Cancels a scan that was started by the user, and returns false if there is
+// no such scan in progress
+bool CancelScanAvailableEpisodes();
+// Cancels every scan and waits for the thread to exit; must be called before
+// exiting
+void ShutdownScanAvailableEpisodes();
+
+// Called by the main window for the messages above
+void OnScanAvailableEpisodesProgress(size_t recognized_count,
+                                     size_t total_count);
+void OnScanAvailableEpisodesResults();
@@ -20,6 +20,7 @@
 
 #include "base/string.h"
 #include "library/anime_db.h"
+#include "library/anime_text_index.h"
 #include "library/anime_util.h"
 #include "library/history.h"
 #include "sync/sync.h"
@@ -506,6 +507,7 @@ bool PageMyInfo::Save() {
   anime_item->SetUserSynonyms(GetDlgItemText(IDC_EDIT_ANIME_ALT));
   anime_item->SetUseAlternative(IsDlgButtonChecked(IDC_CHECK_ANIME_ALT) == TRUE);
   Meow.UpdateTitles(*anime_item, true);
+  AnimeTextIndex.UpdateItem(anime_item->GetId());
 
   // Folder
   anime_item->SetFolder(GetDlgItemText(IDC_EDIT_ANIME_FOLDER));
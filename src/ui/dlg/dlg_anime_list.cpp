@@ -58,7 +58,7 @@ enum AnimeListTooltips {
 AnimeListDialog DlgAnimeList;
 
 AnimeListDialog::AnimeListDialog()
-    : current_status_(anime::kWatching) {
+    : current_status_(anime::kWatching), group_view_(false) {
 }
 
 BOOL AnimeListDialog::OnInitDialog() {
@@ -438,6 +438,10 @@ int AnimeListDialog::ListView::GetSortType(AnimeListColumn column) {
       return ui::kListSortSeason;
     case kColumnAnimeStatus:
       return ui::kListSortStatus;
+    case kColumnAnimeTitle:
+      return ui::kListSortTitle;
+    case kColumnAnimeType:
+      return ui::kListSortType;
     default:
       return ui::kListSortDefault;
   }
@@ -710,6 +714,7 @@ LRESULT AnimeListDialog::OnListNotify(LPARAM lParam) {
       RebuildIdCache();
       Settings.Set(taiga::kApp_List_SortColumn, listview.columns[column_type].key);
       Settings.Set(taiga::kApp_List_SortOrder, order);
+      SortListModel();
       break;
     }
 
@@ -1302,6 +1307,7 @@ void AnimeListDialog::RefreshList(int index) {
 
   bool group_view = !DlgMain.search_bar.filters.text[kSidebarItemAnimeList].empty() &&
                     win::GetVersion() > win::kVersionXp;
+  group_view_ = group_view;
 
   // Remember current position
   int current_position = -1;
@@ -1322,36 +1328,44 @@ void AnimeListDialog::RefreshList(int index) {
   // Enable group view
   listview.EnableGroupView(group_view);
 
-  // Add items to list
-  std::vector<int> group_count(anime::kMyStatusLast);
-  int group_index = -1;
-  int i = 0;
-  for (const auto& pair : AnimeDatabase.items) {
-    const anime::Item& anime_item = pair.second;
-
+  // Filter and sort items. In group view, items are listed under their own
+  // status, otherwise rewatched items are listed under Watching.
+  list_model_.Clear();
+  list_model_.SetFindFunction([](int anime_id) {
+    return static_cast<const anime::Item*>(
+        AnimeDatabase.FindItem(anime_id, false));
+  });
+  list_model_.SetStatusFunction([group_view](const anime::Item& anime_item) {
     if (!anime_item.IsInList())
-      continue;
+      return static_cast<int>(anime::kNotInList);
     if (IsDeletedFromList(anime_item))
+      return static_cast<int>(anime::kNotInList);
+    if (!DlgMain.search_bar.filters.CheckItem(anime_item, kSidebarItemAnimeList))
+      return static_cast<int>(anime::kNotInList);
+    if (!group_view && anime_item.GetMyRewatching())
+      return static_cast<int>(anime::kWatching);
+    return anime_item.GetMyStatus();
+  });
+  SortListModel();
+  std::vector<int> anime_ids;
+  anime_ids.reserve(AnimeDatabase.items.size());
+  for (const auto& pair : AnimeDatabase.items)
+    anime_ids.push_back(pair.first);
+  list_model_.Rebuild(anime_ids);
+
+  // Add items to list
+  std::vector<int> group_count(anime::kMyStatusLast);
+  for (int status = anime::kMyStatusFirst; status < anime::kMyStatusLast; status++) {
+    if (!group_view && status != current_status_)
       continue;
-    if (!group_view) {
-      if (anime_item.GetMyRewatching()) {
-        if (current_status_ != anime::kWatching)
-          continue;
-      } else if (current_status_ != anime_item.GetMyStatus()) {
+    for (const auto anime_id : list_model_.GetItems(status)) {
+      auto anime_item = AnimeDatabase.FindItem(anime_id);
+      if (!anime_item)
         continue;
-      }
+      group_count.at(anime_item->GetMyStatus())++;
+      InsertListItem(listview.GetItemCount(), group_view ? status : -1,
+                     *anime_item);
     }
-    if (!DlgMain.search_bar.filters.CheckItem(anime_item, kSidebarItemAnimeList))
-      continue;
-
-    group_count.at(anime_item.GetMyStatus())++;
-    group_index = group_view ? anime_item.GetMyStatus() : -1;
-    i = listview.GetItemCount();
-
-    listview.InsertItem(i, group_index, -1,
-                        0, nullptr, LPSTR_TEXTCALLBACK,
-                        static_cast<LPARAM>(anime_item.GetId()));
-    RefreshListItemColumns(i, anime_item);
   }
 
   auto timer = taiga::timers.timer(taiga::kTimerAnimeList);
@@ -1382,6 +1396,85 @@ void AnimeListDialog::RefreshList(int index) {
                         RDW_ERASE | RDW_FRAME | RDW_INVALIDATE | RDW_ALLCHILDREN);
 }
 
+void AnimeListDialog::UpdateListItem(int anime_id) {
+  if (!IsWindow())
+    return;
+
+  // Rows are not in the same order as the model in group view
+  if (group_view_ || !list_model_.built()) {
+    RefreshList();
+    RefreshTabs();
+    return;
+  }
+
+  std::vector<anime::ListChange> changes;
+  list_model_.UpdateItem(anime_id, changes);
+
+  auto anime_item = AnimeDatabase.FindItem(anime_id, false);
+  bool status_changed = false;
+
+  for (const auto& change : changes) {
+    if (change.type != anime::ListChange::Type::Update)
+      status_changed = true;
+    if (change.status != current_status_)
+      continue;
+
+    switch (change.type) {
+      case anime::ListChange::Type::Insert:
+        if (anime_item)
+          InsertListItem(change.new_index, -1, *anime_item);
+        break;
+      case anime::ListChange::Type::Remove:
+        listview.DeleteItem(change.old_index);
+        break;
+      case anime::ListChange::Type::Move: {
+        const auto state = ListView_GetItemState(listview.GetWindowHandle(),
+            change.old_index, LVIS_FOCUSED | LVIS_SELECTED);
+        listview.DeleteItem(change.old_index);
+        if (anime_item) {
+          InsertListItem(change.new_index, -1, *anime_item);
+          ListView_SetItemState(listview.GetWindowHandle(), change.new_index,
+                                state, LVIS_FOCUSED | LVIS_SELECTED);
+        }
+        break;
+      }
+      case anime::ListChange::Type::Update:
+        break;
+    }
+  }
+
+  RebuildIdCache();
+  RefreshListItem(anime_id);
+
+  if (status_changed)
+    RefreshTabs();
+}
+
+void AnimeListDialog::InsertListItem(int index, int group_index,
+                                     const anime::Item& anime_item) {
+  listview.InsertItem(index, group_index, -1,
+                      0, nullptr, LPSTR_TEXTCALLBACK,
+                      static_cast<LPARAM>(anime_item.GetId()));
+  RefreshListItemColumns(index, anime_item);
+}
+
+void AnimeListDialog::SortListModel() {
+  auto sort_column = listview.TranslateColumnName(
+      Settings[taiga::kApp_List_SortColumn]);
+  if (sort_column == kColumnUnknown)
+    sort_column = kColumnAnimeTitle;
+
+  const int sort_type = listview.GetSortType(sort_column);
+  const int order = Settings.GetInt(taiga::kApp_List_SortOrder);
+
+  list_model_.SetLessFunction(
+      [sort_type, order](const anime::Item& item1, const anime::Item& item2) {
+        return CompareAnimeListItems(item1, item2, sort_type, order) < 0;
+      });
+  if (list_model_.built())
+    list_model_.Sort();
+}
+
 void AnimeListDialog::RefreshListItem(int anime_id) {
   int index = GetListIndex(anime_id);
 
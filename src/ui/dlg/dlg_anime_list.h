@@ -22,6 +22,8 @@
 #include <windows/win/dialog.h>
 #include <windows/win/gdi.h>
 
+#include "library/anime_list_model.h"
+
 namespace anime {
 class Item;
 }
@@ -74,6 +76,7 @@ public:
   void RefreshListItem(int anime_id);
   void RefreshListItemColumns(int index, const anime::Item& anime_item);
   void RefreshTabs(int index = -1);
+  void UpdateListItem(int anime_id);
 
   void GoToPreviousTab();
   void GoToNextTab();
@@ -136,7 +139,12 @@ public:
   win::Tab tab;
 
 private:
+  void InsertListItem(int index, int group_index, const anime::Item& anime_item);
+  void SortListModel();
+
   int current_status_;
+  bool group_view_;
+  anime::ListModel list_model_;
 };
 
 extern AnimeListDialog DlgAnimeList;
@@ -294,6 +294,16 @@ INT_PTR MainDialog::DialogProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lPara
       return TRUE;
     }
 
+    // Scan available episodes
+    case WM_SCANPROGRESS: {
+      OnScanAvailableEpisodesProgress(wParam, lParam);
+      return TRUE;
+    }
+    case WM_SCANFINISHED: {
+      OnScanAvailableEpisodesResults();
+      return TRUE;
+    }
+
     // Show menu
     case WM_TAIGA_SHOWMENU: {
       toolbar_wm.ShowMenu();
@@ -365,8 +375,11 @@ BOOL MainDialog::PreTranslateMessage(MSG* pMsg) {
       }
 
       switch (pMsg->wParam) {
-        // Clear search text
         case VK_ESCAPE: {
+          // Cancel scanning available episodes
+          if (CancelScanAvailableEpisodes())
+            return TRUE;
+          // Clear search text
           if (::GetFocus() == edit.GetWindowHandle()) {
             edit.SetText(L"");
             return TRUE;
@@ -481,7 +481,7 @@ int SettingsDialog::AddTorrentFilterToList(HWND hwnd_list, const FeedFilter& fil
 
 void SettingsDialog::RefreshCache() {
   std::wstring text;
-  Stats.CalculateLocalData();
+  Stats.Update();
   SettingsPage& page = pages[kSettingsPageLibraryCache];
 
   // History
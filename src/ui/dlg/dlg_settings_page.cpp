@@ -36,6 +36,7 @@
 #include "taiga/resource.h"
 #include "taiga/script.h"
 #include "taiga/settings.h"
+#include "taiga/stats.h"
 #include "taiga/taiga.h"
 #include "track/media.h"
 #include "ui/dlg/dlg_feed_filter.h"
@@ -541,6 +542,7 @@ BOOL SettingsPage::OnCommand(WPARAM wParam, LPARAM lParam) {
           if (IsDlgButtonChecked(IDC_CHECK_CACHE3)) {
             std::wstring path = taiga::GetPath(taiga::Path::Feed);
             DeleteFolder(path);
+            Stats.InvalidateLocalData();
             CheckDlgButton(IDC_CHECK_CACHE3, FALSE);
           }
           parent->RefreshCache();
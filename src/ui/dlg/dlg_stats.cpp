@@ -44,7 +44,7 @@ BOOL StatsDialog::OnInitDialog() {
   }
 
   // Calculate and display statistics
-  Stats.CalculateAll();
+  Stats.Update();
   Refresh();
 
   return TRUE;
@@ -32,6 +32,8 @@
 
 namespace ui {
 
+SortKeyCache SortKeys;
+
 template<class T>
 static int CompareValues(const T& first, const T& second) {
   if (first != second)
@@ -209,6 +211,11 @@ int SortListByTitle(const anime::Item& item1, const anime::Item& item2) {
   }
 }
 
+int SortListByType(const anime::Item& item1, const anime::Item& item2) {
+  return CompareStrings(anime::TranslateType(item1.GetType()),
+                        anime::TranslateType(item2.GetType()));
+}
+
 int SortListBySeason(const anime::Item& item1, const anime::Item& item2,
                      int order) {
   anime::Season season1(item1.GetDateStart());
@@ -243,36 +250,157 @@ int SortList(int type, LPCWSTR str1, LPCWSTR str2) {
   return base::kEqualTo;
 }
 
+int SortList(int type, int order,
+             const anime::Item& item1, const anime::Item& item2) {
+  switch (type) {
+    case kListSortDateStart:
+      return SortListByDateStart(item1, item2);
+    case kListSortEpisodeCount:
+      return SortListByEpisodeCount(item1, item2);
+    case kListSortLastUpdated:
+      return SortListByLastUpdated(item1, item2);
+    case kListSortPopularity:
+      return SortListByPopularity(item1, item2);
+    case kListSortProgress:
+      return SortListByProgress(item1, item2);
+    case kListSortMyScore:
+      return SortListByMyScore(item1, item2);
+    case kListSortScore:
+      return SortListByScore(item1, item2);
+    case kListSortSeason:
+      return SortListBySeason(item1, item2, order);
+    case kListSortStatus:
+      return SortListByAiringStatus(item1, item2);
+    case kListSortTitle:
+      return SortListByTitle(item1, item2);
+    case kListSortType:
+      return SortListByType(item1, item2);
+  }
+
+  return base::kEqualTo;
+}
+
 int SortList(int type, int order, int id1, int id2) {
   auto item1 = AnimeDatabase.FindItem(id1);
   auto item2 = AnimeDatabase.FindItem(id2);
 
-  if (item1 && item2) {
-    switch (type) {
-      case kListSortDateStart:
-        return SortListByDateStart(*item1, *item2);
-      case kListSortEpisodeCount:
-        return SortListByEpisodeCount(*item1, *item2);
-      case kListSortLastUpdated:
-        return SortListByLastUpdated(*item1, *item2);
-      case kListSortPopularity:
-        return SortListByPopularity(*item1, *item2);
-      case kListSortProgress:
-        return SortListByProgress(*item1, *item2);
-      case kListSortMyScore:
-        return SortListByMyScore(*item1, *item2);
-      case kListSortScore:
-        return SortListByScore(*item1, *item2);
-      case kListSortSeason:
-        return SortListBySeason(*item1, *item2, order);
-      case kListSortStatus:
-        return SortListByAiringStatus(*item1, *item2);
-      case kListSortTitle:
-        return SortListByTitle(*item1, *item2);
+  if (item1 && item2)
+    return CompareSortKeys(type, order, SortKeys.Get(type, *item1),
+                           SortKeys.Get(type, *item2));
+
+  return base::kEqualTo;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static std::wstring GetTitleSortKey(const anime::Item& item) {
+  if (Settings.GetBool(taiga::kApp_List_DisplayEnglishTitles)) {
+    return ToLower_Copy(item.GetEnglishTitle(true));
+  } else {
+    return ToLower_Copy(item.GetTitle());
+  }
+}
+
+SortKey GetSortKey(int type, const anime::Item& item) {
+  SortKey key;
+
+  switch (type) {
+    case kListSortDateStart: {
+      // Unknown parts are assumed to be as late as possible
+      const Date& date = item.GetDateStart();
+      const int64_t year = date.year() ? date.year() : 0xFFFF;
+      const int64_t month = date.month() ? date.month() : 12;
+      const int64_t day = date.day() ? date.day() : 31;
+      key.integer = (year << 16) | (month << 8) | day;
+      break;
+    }
+    case kListSortEpisodeCount:
+      key.integer = item.GetEpisodeCount();
+      break;
+    case kListSortLastUpdated:
+      key.integer = ToTime(item.GetMyLastUpdated());
+      break;
+    case kListSortPopularity:
+      // Items without a rank come last
+      key.integer = item.GetPopularity() ? item.GetPopularity() : INT64_MAX;
+      break;
+    case kListSortProgress: {
+      float ratio_aired, ratio_watched;
+      anime::GetProgressRatios(item, ratio_aired, ratio_watched);
+      key.number = ratio_watched;
+      key.integer = anime::EstimateEpisodeCount(item);
+      break;
     }
+    case kListSortMyScore:
+      key.number = item.GetMyScore();
+      break;
+    case kListSortScore:
+      key.number = item.GetScore();
+      break;
+    case kListSortSeason: {
+      // Unknown years and seasons come last
+      anime::Season season(item.GetDateStart());
+      const int64_t year = season.year ? season.year : 0x10000;
+      const int64_t name = season.name != anime::Season::kUnknown ?
+          season.name : anime::Season::kFall + 1;
+      key.integer = (year << 16) | (name << 8) | item.GetAiringStatus();
+      key.text = GetTitleSortKey(item);
+      break;
+    }
+    case kListSortStatus:
+      key.integer = item.GetAiringStatus();
+      break;
+    case kListSortTitle:
+      key.text = GetTitleSortKey(item);
+      break;
+    case kListSortType:
+      key.text = ToLower_Copy(anime::TranslateType(item.GetType()));
+      break;
   }
 
-  return base::kEqualTo;
+  return key;
+}
+
+int CompareSortKeys(int type, int order,
+                    const SortKey& key1, const SortKey& key2) {
+  int return_value = CompareValues<double>(key1.number, key2.number);
+  if (return_value != base::kEqualTo)
+    return return_value;
+
+  return_value = CompareValues<int64_t>(key1.integer, key2.integer);
+  if (return_value != base::kEqualTo)
+    return return_value;
+
+  return_value = key1.text.compare(key2.text);
+  if (return_value != base::kEqualTo)
+    return_value = return_value < 0 ? base::kLessThan : base::kGreaterThan;
+
+  // Titles within the same season are always in ascending order
+  if (type == kListSortSeason)
+    return_value *= order;
+
+  return return_value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const SortKey& SortKeyCache::Get(int type, const anime::Item& item) {
+  auto& entry = entries_[item.GetId()];
+
+  if (entry.type != type) {
+    entry.key = GetSortKey(type, item);
+    entry.type = type;
+  }
+
+  return entry.key;
+}
+
+void SortKeyCache::Invalidate(int anime_id) {
+  entries_.erase(anime_id);
+}
+
+void SortKeyCache::Clear() {
+  entries_.clear();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -309,7 +437,8 @@ int CALLBACK ListViewCompareProc(LPARAM lParam1, LPARAM lParam2,
     case kListSortScore:
     case kListSortSeason:
     case kListSortStatus:
-    case kListSortTitle: {
+    case kListSortTitle:
+    case kListSortType: {
       return_value = SortList(list->GetSortType(), list->GetSortOrder(),
                               static_cast<int>(list->GetItemParam(lParam1)),
                               static_cast<int>(list->GetItemParam(lParam2)));
@@ -323,20 +452,36 @@ int CALLBACK ListViewCompareProc(LPARAM lParam1, LPARAM lParam2,
 
 int CALLBACK AnimeListCompareProc(LPARAM lParam1, LPARAM lParam2,
                                   LPARAM lParamSort) {
+  if (!lParamSort)
+    return base::kEqualTo;
+
+  win::ListView* list = reinterpret_cast<win::ListView*>(lParamSort);
+  auto item1 = AnimeDatabase.FindItem(list->GetItemParam(lParam1));
+  auto item2 = AnimeDatabase.FindItem(list->GetItemParam(lParam2));
+
+  if (!item1 || !item2)
+    return base::kEqualTo;
+
+  return CompareAnimeListItems(*item1, *item2, list->GetSortType(),
+                               list->GetSortOrder());
+}
+
+int CompareAnimeListItems(const anime::Item& item1, const anime::Item& item2,
+                          int sort_type, int order) {
   if (Settings.GetBool(taiga::kApp_List_HighlightNewEpisodes) &&
       Settings.GetBool(taiga::kApp_List_DisplayHighlightedOnTop)) {
-    win::ListView* list = reinterpret_cast<win::ListView*>(lParamSort);
-    auto item1 = AnimeDatabase.FindItem(list->GetItemParam(lParam1));
-    auto item2 = AnimeDatabase.FindItem(list->GetItemParam(lParam2));
-    if (item1 && item2) {
-      bool available1 = item1->IsNextEpisodeAvailable();
-      bool available2 = item2->IsNextEpisodeAvailable();
-      if (available1 != available2)
-        return CompareValues<bool>(!available1, !available2);
-    }
+    bool available1 = item1.IsNextEpisodeAvailable();
+    bool available2 = item2.IsNextEpisodeAvailable();
+    if (available1 != available2)
+      return CompareValues<bool>(!available1, !available2);
   }
 
-  return ListViewCompareProc(lParam1, lParam2, lParamSort);
+  const int return_value = order * CompareSortKeys(sort_type, order,
+      SortKeys.Get(sort_type, item1), SortKeys.Get(sort_type, item2));
+  if (return_value != base::kEqualTo)
+    return return_value;
+
+  return CompareValues<int>(item1.GetId(), item2.GetId());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
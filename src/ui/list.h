@@ -18,9 +18,15 @@
 
 #pragma once
 
+#include <cstdint>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <windows.h>
 
+namespace anime {
+class Item;
+}
 namespace win {
 class ListView;
 }
@@ -42,7 +48,8 @@ enum ListSortType {
   kListSortScore,
   kListSortSeason,
   kListSortStatus,
-  kListSortTitle
+  kListSortTitle,
+  kListSortType
 };
 
 int CALLBACK ListViewCompareProc(LPARAM lParam1, LPARAM lParam2,
@@ -51,6 +58,44 @@ int CALLBACK ListViewCompareProc(LPARAM lParam1, LPARAM lParam2,
 int CALLBACK AnimeListCompareProc(LPARAM lParam1, LPARAM lParam2,
                                   LPARAM lParamSort);
 
+// Used both for sorting the anime list and for placing items in its model, so
+// that the two always agree. Items never compare equal.
+int CompareAnimeListItems(const anime::Item& item1, const anime::Item& item2,
+                          int sort_type, int order);
+
+// Values that an item is sorted by for a sort type, normalized so that they can
+// be compared without going through the item again. Keys are compared by
+// number first, then by integer, then by text.
+struct SortKey {
+  double number = 0.0;
+  int64_t integer = 0;
+  std::wstring text;
+};
+
+// Compares the items directly, which is slower than comparing their keys
+int SortList(int type, int order,
+             const anime::Item& item1, const anime::Item& item2);
+
+SortKey GetSortKey(int type, const anime::Item& item);
+int CompareSortKeys(int type, int order,
+                    const SortKey& key1, const SortKey& key2);
+
+// Remembers the key of each item for the sort type it was last sorted by. Keys
+// must be invalidated whenever an item changes.
+class SortKeyCache {
+public:
+  const SortKey& Get(int type, const anime::Item& item);
+  void Invalidate(int anime_id);
+  void Clear();
+
+private:
+  struct Entry {
+    int type = -1;
+    SortKey key;
+  };
+  std::unordered_map<int, Entry> entries_;
+};
+
 int GetAnimeIdFromSelectedListItem(win::ListView& listview);
 std::vector<int> GetAnimeIdsFromSelectedListItems(win::ListView& listview);
 LPARAM GetParamFromSelectedListItem(win::ListView& listview);
@@ -59,4 +104,6 @@ std::vector<LPARAM> GetParamsFromSelectedListItems(win::ListView& listview);
 void GetPopupMenuPositionForSelectedListItem(win::ListView& listview, POINT& pt);
 bool HitTestListHeader(win::ListView& listview, POINT pt);
 
+extern SortKeyCache SortKeys;
+
 }  // namespace ui
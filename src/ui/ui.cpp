@@ -54,6 +54,7 @@
 #include "ui/dlg/dlg_update.h"
 #include "ui/dlg/dlg_update_new.h"
 #include "ui/dialog.h"
+#include "ui/list.h"
 #include "ui/menu.h"
 #include "ui/theme.h"
 #include "ui/ui.h"
@@ -248,6 +249,8 @@ void OnHttpReadComplete(const taiga::HttpClient& http_client) {
 void OnLibraryChange() {
   ClearStatusText();
 
+  SortKeys.Clear();
+
   DlgAnimeList.RefreshList();
   DlgAnimeList.RefreshTabs();
   DlgHistory.RefreshList();
@@ -261,11 +264,12 @@ void OnLibraryChangeFailure() {
 }
 
 void OnLibraryEntryAdd(int id) {
+  SortKeys.Invalidate(id);
+
   if (DlgAnime.GetCurrentId() == id)
     DlgAnime.Refresh(false, false, true, false);
 
-  DlgAnimeList.RefreshList();
-  DlgAnimeList.RefreshTabs();
+  DlgAnimeList.UpdateListItem(id);
 
   if (DlgNowPlaying.GetCurrentId() == id)
     DlgNowPlaying.Refresh();
@@ -274,11 +278,12 @@ void OnLibraryEntryAdd(int id) {
 }
 
 void OnLibraryEntryChange(int id) {
+  SortKeys.Invalidate(id);
+
   if (DlgAnime.GetCurrentId() == id)
     DlgAnime.Refresh(false, true, false, false);
 
-  if (DlgAnimeList.IsWindow())
-    DlgAnimeList.RefreshListItem(id);
+  DlgAnimeList.UpdateListItem(id);
 
   if (DlgNowPlaying.GetCurrentId() == id)
     DlgNowPlaying.Refresh(false, true, false, false);
@@ -288,11 +293,12 @@ void OnLibraryEntryChange(int id) {
 }
 
 void OnLibraryEntryDelete(int id) {
+  SortKeys.Invalidate(id);
+
   if (DlgAnime.GetCurrentId() == id)
     DlgAnime.Refresh(false, false, true, false);
 
-  DlgAnimeList.RefreshList();
-  DlgAnimeList.RefreshTabs();
+  DlgAnimeList.UpdateListItem(id);
 
   DlgNowPlaying.Refresh(false, false, false, false);
 
@@ -317,6 +323,8 @@ void OnLibraryEntryImageChange(int id) {
 }
 
 void OnLibraryGetSeason() {
+  SortKeys.Clear();
+
   DlgSeason.RefreshList();
   DlgSeason.EnableInput();
 }
@@ -445,39 +453,15 @@ bool OnLibraryEntriesEditTags(const std::vector<int> ids, std::wstring& tags) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-static bool AnimeListNeedsRefresh(const HistoryItem& history_item) {
-  return history_item.mode == taiga::kHttpServiceAddLibraryEntry ||
-         history_item.mode == taiga::kHttpServiceDeleteLibraryEntry ||
-         history_item.status ||
-         history_item.enable_rewatching;
-}
-
-static bool AnimeListNeedsResort() {
-  auto sort_column = DlgAnimeList.listview.TranslateColumnName(
-      Settings[taiga::kApp_List_SortColumn]);
-  switch (sort_column) {
-    case kColumnUserLastUpdated:
-    case kColumnUserProgress:
-    case kColumnUserRating:
-      return true;
-  }
-  return false;
-}
-
 void OnHistoryAddItem(const HistoryItem& history_item) {
+  SortKeys.Invalidate(history_item.anime_id);
+
   DlgHistory.RefreshList();
   DlgSearch.RefreshList();
   DlgMain.treeview.RefreshHistoryCounter();
   DlgNowPlaying.Refresh(false, false, false);
 
-  if (AnimeListNeedsRefresh(history_item)) {
-    DlgAnimeList.RefreshList();
-    DlgAnimeList.RefreshTabs();
-  } else {
-    DlgAnimeList.RefreshListItem(history_item.anime_id);
-    if (AnimeListNeedsResort())
-      DlgAnimeList.listview.SortFromSettings();
-  }
+  DlgAnimeList.UpdateListItem(history_item.anime_id);
 
   if (!sync::UserAuthenticated()) {
     auto anime_item = AnimeDatabase.FindItem(history_item.anime_id);
@@ -489,18 +473,22 @@ void OnHistoryAddItem(const HistoryItem& history_item) {
 }
 
 void OnHistoryChange(const HistoryItem* history_item) {
+  if (history_item) {
+    SortKeys.Invalidate(history_item->anime_id);
+  } else {
+    SortKeys.Clear();
+  }
+
   DlgHistory.RefreshList();
   DlgSearch.RefreshList();
   DlgMain.treeview.RefreshHistoryCounter();
   DlgNowPlaying.Refresh(false, false, false);
 
-  if (!history_item || AnimeListNeedsRefresh(*history_item)) {
+  if (!history_item) {
     DlgAnimeList.RefreshList();
     DlgAnimeList.RefreshTabs();
   } else {
-    DlgAnimeList.RefreshListItem(history_item->anime_id);
-    if (AnimeListNeedsResort())
-      DlgAnimeList.listview.SortFromSettings();
+    DlgAnimeList.UpdateListItem(history_item->anime_id);
   }
 }
 
@@ -566,6 +554,8 @@ int OnHistoryProcessConfirmationQueue(anime::Episode& episode) {
 void OnAnimeDelete(int id, const string_t& title) {
   ChangeStatusText(L"Anime is removed from the database: " + title);
 
+  SortKeys.Invalidate(id);
+
   if (DlgAnime.GetCurrentId() == id) {
     // We're posting a message rather than directly terminating the dialog,
     // because this function can be called from another thread, and it is not
@@ -681,10 +671,10 @@ bool OnRecognitionCancelConfirm() {
   return dlg.GetSelectedButtonID() == IDYES;
 }
 
-void OnRecognitionFail() {
+void OnRecognitionFail(const track::recognition::sorted_scores_t& scores) {
   if (!CurrentEpisode.anime_title().empty()) {
     MediaPlayers.set_title_changed(false);
-    DlgNowPlaying.SetScores(Meow.GetScores());
+    DlgNowPlaying.SetScores(scores);
     DlgNowPlaying.SetCurrentId(anime::ID_NOTINLIST);
     ChangeStatusText(L"Watching: " + CurrentEpisode.anime_title() +
                      PushString(L" #", anime::GetEpisodeRange(CurrentEpisode)) +
@@ -787,6 +777,7 @@ bool OnSettingsEditAdvanced(const std::wstring& description,
 }
 
 void OnSettingsChange() {
+  SortKeys.Clear();
   DlgAnimeList.RefreshList();
 }
 
@@ -853,6 +844,8 @@ void OnSettingsThemeChange() {
 }
 
 void OnSettingsUserChange() {
+  SortKeys.Clear();
+
   DlgMain.treeview.RefreshHistoryCounter();
   DlgMain.UpdateTitle();
   DlgAnimeList.RefreshList(anime::kWatching);
@@ -868,8 +861,16 @@ void OnSettingsUserChange() {
 ////////////////////////////////////////////////////////////////////////////////
 
 void OnEpisodeAvailabilityChange(int id) {
-  if (DlgAnimeList.IsWindow())
+  SortKeys.Invalidate(id);
+
+  // Highlighted items can be displayed on top, in which case the item may have
+  // to be moved
+  if (Settings.GetBool(taiga::kApp_List_HighlightNewEpisodes) &&
+      Settings.GetBool(taiga::kApp_List_DisplayHighlightedOnTop)) {
+    DlgAnimeList.UpdateListItem(id);
+  } else if (DlgAnimeList.IsWindow()) {
     DlgAnimeList.RefreshListItem(id);
+  }
 
   if (DlgNowPlaying.GetCurrentId() == anime::ID_UNKNOWN)
     DlgNowPlaying.Refresh(false, false, false, false);
@@ -21,6 +21,7 @@
 #include <windows/win/taskbar.h>
 
 #include "base/types.h"
+#include "track/recognition.h"
 
 namespace anime {
 class Episode;
@@ -93,7 +94,7 @@ void OnAnimeWatchingStart(const anime::Item& anime_item, const anime::Episode& e
 void OnAnimeWatchingEnd(const anime::Item& anime_item, const anime::Episode& episode);
 
 bool OnRecognitionCancelConfirm();
-void OnRecognitionFail();
+void OnRecognitionFail(const track::recognition::sorted_scores_t& scores);
 
 void OnAnimeListHeaderRatingWarning();
 